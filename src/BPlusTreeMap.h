@@ -0,0 +1,1044 @@
+#ifndef AISDI_MAPS_BPLUSTREEMAP_H
+#define AISDI_MAPS_BPLUSTREEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "PoolAllocator.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace aisdi
+{
+
+//Position of a key among the sorted keys of a B+tree node
+template <typename K, typename = void>
+struct KeySearch
+{
+    const static std::size_t GROUP = 1;
+
+    //Number of the first *n* sorted *keys* that are smaller than *key*
+    static std::size_t countLess(const K* keys, std::size_t n, const K& key)
+    {
+        return std::lower_bound(keys, keys + n, key) - keys;
+    }
+};
+
+//4 and 8 byte integers: all keys of a node are compared with *key* at once and the smaller ones
+// counted, 8 (or 4) per instruction with AVX2, 4 int32 with SSE2, otherwise in a branchless loop.
+//*keys* must stay readable up to the next multiple of KeySearch::GROUP entries.
+template <typename K>
+struct KeySearch<K, typename std::enable_if<std::is_integral<K>::value && (sizeof(K) == 4 || sizeof(K) == 8)>::type>
+{
+    const static std::size_t GROUP = 8;
+
+    static std::size_t countLess(const K* keys, std::size_t n, K key)
+    {
+        return count(keys, n, key, std::integral_constant<std::size_t, sizeof(K)>());
+    }
+
+private:
+    //Added to unsigned keys (flipping their top bit), so signed comparisons order them correctly
+    static constexpr long long bias()
+    {
+        return std::is_signed<K>::value ? 0 : static_cast<long long>(1ull << (sizeof(K) * 8 - 1));
+    }
+
+    static std::size_t scalar(const K* keys, std::size_t n, K key)
+    {
+        std::size_t result = 0;
+        for(std::size_t i = 0; i < n; ++i)
+            result += keys[i] < key;
+        return result;
+    }
+
+#if defined(__AVX2__)
+    static std::size_t count(const K* keys, std::size_t n, K key, std::integral_constant<std::size_t, 8>)
+    {
+        const __m256i flip = _mm256_set1_epi64x(bias());
+        const __m256i needle = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), flip);
+        std::size_t result = 0;
+        for(std::size_t i = 0; i < n; i += 4)
+        {
+            __m256i group = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+            unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, group)));
+            if(n - i < 4) mask &= (1u << (n - i)) - 1;
+            result += __builtin_popcount(mask);
+        }
+        return result;
+    }
+
+    static std::size_t count(const K* keys, std::size_t n, K key, std::integral_constant<std::size_t, 4>)
+    {
+        const __m256i flip = _mm256_set1_epi32(static_cast<int>(bias()));
+        const __m256i needle = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), flip);
+        std::size_t result = 0;
+        for(std::size_t i = 0; i < n; i += 8)
+        {
+            __m256i group = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+            unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, group)));
+            if(n - i < 8) mask &= (1u << (n - i)) - 1;
+            result += __builtin_popcount(mask);
+        }
+        return result;
+    }
+#elif defined(__SSE2__)
+    static std::size_t count(const K* keys, std::size_t n, K key, std::integral_constant<std::size_t, 8>)
+    {
+        return scalar(keys, n, key);
+    }
+
+    static std::size_t count(const K* keys, std::size_t n, K key, std::integral_constant<std::size_t, 4>)
+    {
+        const __m128i flip = _mm_set1_epi32(static_cast<int>(bias()));
+        const __m128i needle = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), flip);
+        std::size_t result = 0;
+        for(std::size_t i = 0; i < n; i += 4)
+        {
+            __m128i group = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flip);
+            unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, group)));
+            if(n - i < 4) mask &= (1u << (n - i)) - 1;
+            result += __builtin_popcount(mask);
+        }
+        return result;
+    }
+#else
+    template <std::size_t Size>
+    static std::size_t count(const K* keys, std::size_t n, K key, std::integral_constant<std::size_t, Size>)
+    {
+        return scalar(keys, n, key);
+    }
+#endif
+};
+
+//Ordered map with the interface of TreeMap, kept in a B+tree.
+//Inner nodes hold only keys and child pointers and fill a few cache lines, so a lookup touches
+// about log_16(n) of them instead of log_2(n) single-key nodes. All elements live in the leaves,
+// which are linked in key order, so iteration is a walk over arrays.
+//Unlike TreeMap, inserting or removing moves elements inside their leaves: it invalidates all
+// iterators and references to elements.
+template <typename KeyType, typename ValueType,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class BPlusTreeMap
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+    using allocator_type = Allocator;
+
+    class ConstIterator;
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = ConstIterator;
+
+private:
+    using Search = KeySearch<key_type>;
+    using Slot = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+
+    struct NodeBase
+    {
+        size_type count; //keys in an inner node, elements in a leaf
+        bool leaf;
+
+        explicit NodeBase(bool isLeaf): count(0), leaf(isLeaf)
+        {}
+    };
+
+    //Node sizes: four cache lines for inner nodes, and leaves as big as the largest size class of
+    // PoolAllocator, so that its arena holds them
+    const static size_type INNER_BYTES = 256;
+    const static size_type LEAF_BYTES = 512;
+    const static size_type MIN_CAPACITY = 4;
+    const static size_type MAX_DEPTH = 64;
+    const static size_type KEY_PADDING = Search::GROUP; //keys arrays are readable in whole groups, see KeySearch
+
+    static constexpr size_type padded(size_type n)
+    {
+        return (n + KEY_PADDING - 1) / KEY_PADDING * KEY_PADDING;
+    }
+
+    static constexpr size_type alignedUp(size_type bytes, size_type alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    static constexpr size_type maxOf(size_type a, size_type b)
+    {
+        return a < b ? b : a;
+    }
+
+    //sizeof(Inner) and sizeof(Leaf) for a given capacity, member by member
+    static constexpr size_type innerBytes(size_type capacity)
+    {
+        return alignedUp(alignedUp(alignedUp(sizeof(NodeBase), alignof(key_type)) + padded(capacity) * sizeof(key_type),
+            alignof(NodeBase*)) + (capacity + 1) * sizeof(NodeBase*), maxOf(alignof(NodeBase), alignof(key_type)));
+    }
+
+    static constexpr size_type leafBytes(size_type capacity)
+    {
+        return alignedUp(alignedUp(alignedUp(sizeof(NodeBase) + 2 * sizeof(void*), alignof(key_type)) + padded(capacity) * sizeof(key_type),
+            alignof(value_type)) + capacity * sizeof(value_type), maxOf(maxOf(alignof(NodeBase), alignof(key_type)), alignof(value_type)));
+    }
+
+    //Largest capacity not above *capacity* whose node fits in *bytes*, but at least MIN_CAPACITY
+    static constexpr size_type innerFit(size_type capacity)
+    {
+        return capacity <= MIN_CAPACITY ? MIN_CAPACITY : innerBytes(capacity) <= INNER_BYTES ? capacity : innerFit(capacity - 1);
+    }
+
+    static constexpr size_type leafFit(size_type capacity)
+    {
+        return capacity <= MIN_CAPACITY ? MIN_CAPACITY : leafBytes(capacity) <= LEAF_BYTES ? capacity : leafFit(capacity - 1);
+    }
+
+    const static size_type INNER_CAPACITY = innerFit(INNER_BYTES / (sizeof(key_type) + sizeof(void*))); //keys, one child more
+    const static size_type LEAF_CAPACITY = leafFit(LEAF_BYTES / (sizeof(key_type) + sizeof(value_type)));
+    const static size_type MIN_INNER = INNER_CAPACITY / 2;
+    const static size_type MIN_LEAF = LEAF_CAPACITY / 2;
+
+    //keys[i] is the smallest key of children[i + 1]'s subtree (or smaller, after removals)
+    struct Inner : NodeBase
+    {
+        key_type keys[padded(INNER_CAPACITY)];
+        NodeBase* children[INNER_CAPACITY + 1];
+
+        Inner(): NodeBase(false), keys()
+        {}
+    };
+
+    //keys[i] duplicates slots[i]'s key, so searching a leaf reads one compact array. The copy costs
+    // a key's size per element: the slots have to hold whole value_types for iterators to point at.
+    struct Leaf : NodeBase
+    {
+        Leaf *prev, *next;
+        key_type keys[padded(LEAF_CAPACITY)];
+        Slot slots[LEAF_CAPACITY];
+
+        Leaf(): NodeBase(true), prev(nullptr), next(nullptr), keys()
+        {}
+
+        value_type& val(size_type index)
+        {
+            return *reinterpret_cast<value_type*>(&slots[index]);
+        }
+    };
+
+    //Only keys or values too big for MIN_CAPACITY of them to fit make nodes bigger
+    static_assert((sizeof(Inner) <= INNER_BYTES || INNER_CAPACITY == MIN_CAPACITY) &&
+                  (sizeof(Leaf) <= LEAF_BYTES || LEAF_CAPACITY == MIN_CAPACITY), "Node outgrows its size");
+
+    using LeafAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Leaf>;
+    using LeafTraits = std::allocator_traits<LeafAllocator>;
+    using InnerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Inner>;
+    using InnerTraits = std::allocator_traits<InnerAllocator>;
+
+    //Inner nodes on the way from the root to a leaf, with the index of the child taken in each
+    struct Path
+    {
+        Inner* nodes[MAX_DEPTH];
+        size_type indices[MAX_DEPTH];
+        size_type depth;
+    };
+
+    LeafAllocator leafAllocator; //inner nodes come from copies of it, so that one arena holds all nodes
+    NodeBase* root; //nullptr while empty
+    Leaf *first, *last;
+    size_type count;
+
+public:
+    BPlusTreeMap(): BPlusTreeMap(Allocator())
+    {}
+
+    explicit BPlusTreeMap(const Allocator& alloc): leafAllocator(alloc), root(nullptr),
+        first(nullptr), last(nullptr), count(0)
+    {}
+
+    BPlusTreeMap(std::initializer_list<value_type> list): BPlusTreeMap()
+    {
+        for(const value_type& val : list)
+            (*this)[val.first] = val.second;
+    }
+
+    BPlusTreeMap(const BPlusTreeMap& other):
+        BPlusTreeMap(Allocator(LeafTraits::select_on_container_copy_construction(other.leafAllocator)))
+    {
+        copyFrom(other);
+    }
+
+    BPlusTreeMap(BPlusTreeMap&& other) noexcept: BPlusTreeMap(Allocator(other.leafAllocator))
+    {
+        swap(other);
+    }
+
+    ~BPlusTreeMap()
+    {
+        clear();
+    }
+
+    BPlusTreeMap& operator=(const BPlusTreeMap& other)
+    {
+        if(&other != this)
+        {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    BPlusTreeMap& operator=(BPlusTreeMap&& other) noexcept
+    {
+        BPlusTreeMap temp(std::move(other));
+        swap(temp);
+        return *this;
+    }
+
+    void swap(BPlusTreeMap& other) noexcept
+    {
+        std::swap(leafAllocator, other.leafAllocator);
+        std::swap(root, other.root);
+        std::swap(first, other.first);
+        std::swap(last, other.last);
+        std::swap(count, other.count);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(leafAllocator);
+    }
+
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
+
+    size_type getSize() const
+    {
+        return count;
+    }
+
+    //Number of levels, leaves included (0 when empty)
+    size_type getHeight() const
+    {
+        size_type height = 0;
+        for(const NodeBase* nd = root; nd != nullptr; nd = nd->leaf ? nullptr : static_cast<const Inner*>(nd)->children[0])
+            ++height;
+        return height;
+    }
+
+    //Remove all elements
+    void clear()
+    {
+        //The elements go first, then the nodes: with an arena all of them at once if they need no
+        // destructor, otherwise the inner nodes, while the leaves below can still tell they are
+        // leaves, and the leaves through their list
+        if(!std::is_trivially_destructible<value_type>::value)
+        {
+            for(Leaf* leaf = first; leaf != nullptr; leaf = leaf->next)
+                for(size_type i = 0; i < leaf->count; ++i)
+                    leaf->val(i).~value_type();
+        }
+        if(!(std::is_trivially_destructible<Inner>::value && std::is_trivially_destructible<Leaf>::value &&
+             releaseArena(leafAllocator)))
+        {
+            if(root != nullptr && !root->leaf) destroyInnerNodes(static_cast<Inner*>(root));
+            while(first != nullptr)
+            {
+                Leaf* leaf = first;
+                first = first->next;
+                destroyLeaf(leaf);
+            }
+        }
+        root = nullptr;
+        first = last = nullptr;
+        count = 0;
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        if(root == nullptr)
+        {
+            first = last = createLeaf();
+            root = first;
+        }
+
+        Path path;
+        Leaf* leaf = descend(key, &path);
+        size_type index = Search::countLess(leaf->keys, leaf->count, key);
+        if(index < leaf->count && leaf->keys[index] == key) return leaf->val(index).second;
+
+        return insertAt(leaf, index, key, path).second;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const
+    {
+        const_iterator it = find(key);
+        if(it == end()) throw std::out_of_range("Node with given key doesn't exist");
+        return it->second;
+    }
+
+    mapped_type& valueOf(const key_type& key)
+    {
+        iterator it = find(key);
+        if(it == end()) throw std::out_of_range("Node with given key doesn't exist");
+        return it->second;
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        if(root == nullptr) return cend();
+        Leaf* leaf = descend(key, nullptr);
+        size_type index = Search::countLess(leaf->keys, leaf->count, key);
+        if(index < leaf->count && leaf->keys[index] == key) return const_iterator(this, leaf, index);
+        return cend();
+    }
+
+    iterator find(const key_type& key)
+    {
+        return iterator(static_cast<const BPlusTreeMap*>(this)->find(key));
+    }
+
+    void remove(const key_type& key)
+    {
+        if(!erase(key)) throw std::out_of_range("Node with given key doesn't exist or iterator is in end position");
+    }
+
+    void remove(const const_iterator& it)
+    {
+        if(it == end()) throw std::out_of_range("Node with given key doesn't exist or iterator is in end position");
+        erase(it.leaf->keys[it.index]);
+    }
+
+    bool operator==(const BPlusTreeMap& other) const
+    {
+        if(getSize() != other.getSize()) return false;
+
+        for(auto it1 = begin(), it2 = other.begin(); it1 != end(); ++it1, ++it2)
+            if(*it1 != *it2) return false;
+        return true;
+    }
+
+    bool operator!=(const BPlusTreeMap& other) const
+    {
+        return !(*this == other);
+    }
+
+    iterator begin()
+    {
+        return iterator(cbegin());
+    }
+
+    iterator end()
+    {
+        return iterator(cend());
+    }
+
+    const_iterator cbegin() const
+    {
+        return const_iterator(this, first, 0);
+    }
+
+    const_iterator cend() const
+    {
+        return const_iterator(this, nullptr, 0);
+    }
+
+    const_iterator begin() const
+    {
+        return cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return cend();
+    }
+
+private:
+    Leaf* createLeaf()
+    {
+        Leaf* leaf = LeafTraits::allocate(leafAllocator, 1);
+        LeafTraits::construct(leafAllocator, leaf);
+        return leaf;
+    }
+
+    Inner* createInner()
+    {
+        InnerAllocator innerAllocator(leafAllocator);
+        Inner* inner = InnerTraits::allocate(innerAllocator, 1);
+        InnerTraits::construct(innerAllocator, inner);
+        return inner;
+    }
+
+    void destroyLeaf(Leaf* leaf)
+    {
+        LeafTraits::destroy(leafAllocator, leaf);
+        LeafTraits::deallocate(leafAllocator, leaf, 1);
+    }
+
+    void destroyInner(Inner* inner)
+    {
+        InnerAllocator innerAllocator(leafAllocator);
+        InnerTraits::destroy(innerAllocator, inner);
+        InnerTraits::deallocate(innerAllocator, inner, 1);
+    }
+
+    //Destroy the inner nodes of the given subtree, leaving the leaves
+    //Recursion goes only as deep as the tree, a few levels
+    void destroyInnerNodes(Inner* inner)
+    {
+        if(!inner->children[0]->leaf)
+        {
+            for(size_type i = 0; i <= inner->count; ++i)
+                destroyInnerNodes(static_cast<Inner*>(inner->children[i]));
+        }
+        destroyInner(inner);
+    }
+
+    //Elements come in key order, so every insertion appends to the last leaf
+    void copyFrom(const BPlusTreeMap& other)
+    {
+        for(const value_type& val : other)
+            (*this)[val.first] = val.second;
+    }
+
+    //Leaf that may hold *key*, recording the way down in *path* (if given)
+    Leaf* descend(const key_type& key, Path* path) const
+    {
+        NodeBase* nd = root;
+        if(path != nullptr) path->depth = 0;
+        while(!nd->leaf)
+        {
+            Inner* inner = static_cast<Inner*>(nd);
+            size_type index = Search::countLess(inner->keys, inner->count, key);
+            if(index < inner->count && inner->keys[index] == key) ++index; //equal keys go right
+            if(path != nullptr)
+            {
+                path->nodes[path->depth] = inner;
+                path->indices[path->depth++] = index;
+            }
+            nd = inner->children[index];
+            prefetch(nd);
+        }
+        return static_cast<Leaf*>(nd);
+    }
+
+    //Start loading all cache lines of an inner node (or the keys of a leaf) at once, rather than
+    // one after another as the search reaches them
+    static void prefetch(const NodeBase* nd)
+    {
+        const char* bytes = reinterpret_cast<const char*>(nd);
+        for(size_type offset = 0; offset < sizeof(Inner); offset += 64)
+            __builtin_prefetch(bytes + offset);
+    }
+
+    //Make room at *index* in *leaf* by moving the elements behind it one slot right
+    static void shiftRight(Leaf* leaf, size_type index)
+    {
+        for(size_type i = leaf->count; i > index; --i)
+        {
+            try
+            {
+                new (&leaf->slots[i]) value_type(std::move(leaf->val(i - 1)));
+            }
+            catch(...)
+            {
+                //Move the shifted elements back
+                ++leaf->count;
+                shiftLeft(leaf, i);
+                --leaf->count;
+                throw;
+            }
+            leaf->val(i - 1).~value_type();
+            leaf->keys[i] = leaf->keys[i - 1];
+        }
+    }
+
+    //Close the gap at *index* in *leaf* (its element already destroyed)
+    static void shiftLeft(Leaf* leaf, size_type index)
+    {
+        for(size_type i = index + 1; i < leaf->count; ++i)
+        {
+            new (&leaf->slots[i - 1]) value_type(std::move(leaf->val(i)));
+            leaf->val(i).~value_type();
+            leaf->keys[i - 1] = leaf->keys[i];
+        }
+    }
+
+    //Move *n* elements starting at *fromIndex* in *from* to empty slots starting at *toIndex* in *to*
+    static void moveElements(Leaf* from, size_type fromIndex, Leaf* to, size_type toIndex, size_type n)
+    {
+        for(size_type i = 0; i < n; ++i)
+        {
+            try
+            {
+                new (&to->slots[toIndex + i]) value_type(std::move(from->val(fromIndex + i)));
+            }
+            catch(...)
+            {
+                //Move the elements already moved back
+                for(size_type j = 0; j < i; ++j)
+                {
+                    new (&from->slots[fromIndex + j]) value_type(std::move(to->val(toIndex + j)));
+                    to->val(toIndex + j).~value_type();
+                }
+                throw;
+            }
+            from->val(fromIndex + i).~value_type();
+            to->keys[toIndex + i] = from->keys[fromIndex + i];
+        }
+    }
+
+    //A value constructor throwing, for the new element or one moved to make room for it, leaves the map
+    // as it was, as long as moving the others back does not throw too
+    value_type& insertAt(Leaf* leaf, size_type index, const key_type& key, Path& path)
+    {
+        value_type item(key, mapped_type());
+        if(leaf->count == LEAF_CAPACITY)
+        {
+            //Appending to the last leaf (or prepending to the first) leaves the full leaf as it is,
+            // so sorted loads fill the leaves completely instead of halfway
+            size_type split = LEAF_CAPACITY / 2;
+            if(index == LEAF_CAPACITY && leaf->next == nullptr) split = LEAF_CAPACITY;
+            else if(index == 0 && leaf->prev == nullptr) split = 0;
+
+            Leaf* right = createLeaf();
+            try
+            {
+                moveElements(leaf, split, right, 0, LEAF_CAPACITY - split);
+            }
+            catch(...)
+            {
+                destroyLeaf(right);
+                throw;
+            }
+            right->count = LEAF_CAPACITY - split;
+            leaf->count = split;
+
+            right->prev = leaf;
+            right->next = leaf->next;
+            if(leaf->next != nullptr) leaf->next->prev = right;
+            else last = right;
+            leaf->next = right;
+
+            if(index > split || (index == split && split == LEAF_CAPACITY))
+            {
+                index -= split;
+                leaf = right;
+            }
+
+            if(right->count == 0)
+            {
+                //Only the new key goes right, so it is also the separator
+                try
+                {
+                    new (&right->slots[0]) value_type(std::move(item));
+                }
+                catch(...)
+                {
+                    leaf->next = right->next;
+                    if(right->next != nullptr) right->next->prev = leaf;
+                    else last = leaf;
+                    destroyLeaf(right);
+                    throw;
+                }
+                right->keys[0] = key;
+                right->count = 1;
+                ++count;
+                insertIntoParent(path, key, right);
+                return right->val(0);
+            }
+            insertIntoParent(path, right->keys[0], right);
+        }
+
+        shiftRight(leaf, index);
+        try
+        {
+            new (&leaf->slots[index]) value_type(std::move(item));
+        }
+        catch(...)
+        {
+            //Close the gap again
+            ++leaf->count;
+            shiftLeft(leaf, index);
+            --leaf->count;
+            throw;
+        }
+        leaf->keys[index] = key;
+        ++leaf->count;
+        ++count;
+        return leaf->val(index);
+    }
+
+    //Add *child* (holding keys from *separator* up) right of the node reached at the end of *path*,
+    // splitting inner nodes up to the root as needed
+    void insertIntoParent(Path& path, key_type separator, NodeBase* child)
+    {
+        while(path.depth > 0)
+        {
+            --path.depth;
+            Inner* inner = path.nodes[path.depth];
+            size_type index = path.indices[path.depth]; //the key goes at *index*, the child at *index* + 1
+
+            if(inner->count < INNER_CAPACITY)
+            {
+                insertIntoInner(inner, index, separator, child);
+                return;
+            }
+
+            //Split: the middle key moves up, the new one goes to the half it belongs to
+            size_type middle = INNER_CAPACITY / 2;
+            Inner* right = createInner();
+            right->count = INNER_CAPACITY - middle - 1;
+            for(size_type i = 0; i < right->count; ++i)
+                right->keys[i] = inner->keys[middle + 1 + i];
+            for(size_type i = 0; i <= right->count; ++i)
+                right->children[i] = inner->children[middle + 1 + i];
+            key_type up = inner->keys[middle];
+            inner->count = middle;
+
+            if(index <= middle) insertIntoInner(inner, index, separator, child);
+            else insertIntoInner(right, index - middle - 1, separator, child);
+
+            separator = up;
+            child = right;
+        }
+
+        //The root was split
+        Inner* newRoot = createInner();
+        newRoot->count = 1;
+        newRoot->keys[0] = separator;
+        newRoot->children[0] = root;
+        newRoot->children[1] = child;
+        root = newRoot;
+    }
+
+    static void insertIntoInner(Inner* inner, size_type index, const key_type& separator, NodeBase* child)
+    {
+        for(size_type i = inner->count; i > index; --i)
+        {
+            inner->keys[i] = inner->keys[i - 1];
+            inner->children[i + 1] = inner->children[i];
+        }
+        inner->keys[index] = separator;
+        inner->children[index + 1] = child;
+        ++inner->count;
+    }
+
+    //Drop key number *index* and the child right of it
+    static void removeFromInner(Inner* inner, size_type index)
+    {
+        for(size_type i = index + 1; i < inner->count; ++i)
+        {
+            inner->keys[i - 1] = inner->keys[i];
+            inner->children[i] = inner->children[i + 1];
+        }
+        --inner->count;
+    }
+
+    //Remove *key* (returns false if it doesn't exist)
+    bool erase(const key_type& key)
+    {
+        if(root == nullptr) return false;
+        Path path;
+        Leaf* leaf = descend(key, &path);
+        size_type index = Search::countLess(leaf->keys, leaf->count, key);
+        if(index == leaf->count || !(leaf->keys[index] == key)) return false;
+
+        leaf->val(index).~value_type();
+        shiftLeft(leaf, index);
+        --leaf->count;
+        --count;
+
+        if(leaf == root)
+        {
+            if(leaf->count == 0) clear();
+        }
+        else if(leaf->count < MIN_LEAF) fixLeaf(leaf, path);
+        return true;
+    }
+
+    //Refill *leaf* from a sibling under the same parent, or merge the two
+    //Separators left behind by removed keys still route correctly, so only these need updates
+    void fixLeaf(Leaf* leaf, Path& path)
+    {
+        Inner* parent = path.nodes[path.depth - 1];
+        size_type index = path.indices[path.depth - 1];
+        Leaf* left = index > 0 ? static_cast<Leaf*>(parent->children[index - 1]) : nullptr;
+        Leaf* right = index < parent->count ? static_cast<Leaf*>(parent->children[index + 1]) : nullptr;
+
+        if(left != nullptr && left->count > MIN_LEAF)
+        {
+            shiftRight(leaf, 0);
+            moveElements(left, left->count - 1, leaf, 0, 1);
+            --left->count;
+            ++leaf->count;
+            parent->keys[index - 1] = leaf->keys[0];
+            return;
+        }
+        if(right != nullptr && right->count > MIN_LEAF)
+        {
+            moveElements(right, 0, leaf, leaf->count, 1);
+            shiftLeft(right, 0);
+            --right->count;
+            ++leaf->count;
+            parent->keys[index] = right->keys[0];
+            return;
+        }
+
+        if(left != nullptr)
+        {
+            mergeLeaves(left, leaf);
+            removeFromInner(parent, index - 1);
+        }
+        else
+        {
+            mergeLeaves(leaf, right);
+            removeFromInner(parent, index);
+        }
+        --path.depth;
+        fixInner(path);
+    }
+
+    //Move all elements of *right* to the end of *left* and drop *right*
+    void mergeLeaves(Leaf* left, Leaf* right)
+    {
+        moveElements(right, 0, left, left->count, right->count);
+        left->count += right->count;
+        left->next = right->next;
+        if(right->next != nullptr) right->next->prev = left;
+        else last = left;
+        destroyLeaf(right);
+    }
+
+    //Restore the minimum fill of the inner node at the end of *path*, going up as merges propagate
+    void fixInner(Path& path)
+    {
+        for(;;)
+        {
+            Inner* inner = path.nodes[path.depth];
+            if(path.depth == 0)
+            {
+                if(inner->count == 0) //the root has a single child left
+                {
+                    root = inner->children[0];
+                    destroyInner(inner);
+                }
+                return;
+            }
+            if(inner->count >= MIN_INNER) return;
+
+            Inner* parent = path.nodes[path.depth - 1];
+            size_type index = path.indices[path.depth - 1];
+            Inner* left = index > 0 ? static_cast<Inner*>(parent->children[index - 1]) : nullptr;
+            Inner* right = index < parent->count ? static_cast<Inner*>(parent->children[index + 1]) : nullptr;
+
+            if(left != nullptr && left->count > MIN_INNER)
+            {
+                //Rotate through the parent: its separator comes down, left's last key goes up
+                for(size_type i = inner->count; i > 0; --i)
+                    inner->keys[i] = inner->keys[i - 1];
+                for(size_type i = inner->count + 1; i > 0; --i)
+                    inner->children[i] = inner->children[i - 1];
+                inner->keys[0] = parent->keys[index - 1];
+                inner->children[0] = left->children[left->count];
+                ++inner->count;
+                parent->keys[index - 1] = left->keys[left->count - 1];
+                --left->count;
+                return;
+            }
+            if(right != nullptr && right->count > MIN_INNER)
+            {
+                inner->keys[inner->count] = parent->keys[index];
+                inner->children[inner->count + 1] = right->children[0];
+                ++inner->count;
+                parent->keys[index] = right->keys[0];
+                for(size_type i = 1; i < right->count; ++i)
+                    right->keys[i - 1] = right->keys[i];
+                for(size_type i = 1; i <= right->count; ++i)
+                    right->children[i - 1] = right->children[i];
+                --right->count;
+                return;
+            }
+
+            if(left != nullptr)
+            {
+                mergeInner(left, parent->keys[index - 1], inner);
+                removeFromInner(parent, index - 1);
+            }
+            else
+            {
+                mergeInner(inner, parent->keys[index], right);
+                removeFromInner(parent, index);
+            }
+            --path.depth;
+        }
+    }
+
+    //Append *separator* and all of *right* to *left* and drop *right*
+    void mergeInner(Inner* left, const key_type& separator, Inner* right)
+    {
+        left->keys[left->count] = separator;
+        for(size_type i = 0; i < right->count; ++i)
+            left->keys[left->count + 1 + i] = right->keys[i];
+        for(size_type i = 0; i <= right->count; ++i)
+            left->children[left->count + 1 + i] = right->children[i];
+        left->count += right->count + 1;
+        destroyInner(right);
+    }
+};
+
+template <typename KeyType, typename ValueType, typename Allocator>
+class BPlusTreeMap<KeyType, ValueType, Allocator>::ConstIterator
+{
+public:
+    friend class BPlusTreeMap<KeyType, ValueType, Allocator>;
+    using reference = typename BPlusTreeMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename BPlusTreeMap::value_type;
+    using pointer = const typename BPlusTreeMap::value_type*;
+    using tree_map = BPlusTreeMap<KeyType, ValueType, Allocator>;
+
+private:
+    using Leaf = typename BPlusTreeMap::Leaf;
+
+    const tree_map* parent_tree;
+    Leaf* leaf; //nullptr at the end
+    size_type index;
+
+public:
+    explicit ConstIterator(const tree_map* parent = nullptr, Leaf* l = nullptr, size_type i = 0):
+        parent_tree(parent), leaf(l), index(i)
+    {}
+
+    ConstIterator& operator++()
+    {
+        if(leaf == nullptr) throw std::out_of_range("Cannot increment iterator");
+        if(++index == leaf->count)
+        {
+            leaf = leaf->next;
+            index = 0;
+        }
+        return *this;
+    }
+
+    ConstIterator operator++(int)
+    {
+        ConstIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    ConstIterator& operator--()
+    {
+        if(*this == parent_tree->begin()) throw std::out_of_range("Cannot decrement iterator");
+        if(leaf == nullptr)
+        {
+            leaf = parent_tree->last;
+            index = leaf->count - 1;
+        }
+        else if(index == 0)
+        {
+            leaf = leaf->prev;
+            index = leaf->count - 1;
+        }
+        else --index;
+        return *this;
+    }
+
+    ConstIterator operator--(int)
+    {
+        ConstIterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
+    reference operator*() const
+    {
+        if(leaf == nullptr) throw std::out_of_range("Iterator points at empty space after the last element");
+        return leaf->val(index);
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const
+    {
+        return leaf == other.leaf && index == other.index;
+    }
+
+    bool operator!=(const ConstIterator& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+template <typename KeyType, typename ValueType, typename Allocator>
+class BPlusTreeMap<KeyType, ValueType, Allocator>::Iterator : public BPlusTreeMap<KeyType, ValueType, Allocator>::ConstIterator
+{
+public:
+    using reference = typename BPlusTreeMap::reference;
+    using pointer = typename BPlusTreeMap::value_type*;
+
+    explicit Iterator()
+    {}
+
+    Iterator(const ConstIterator& other): ConstIterator(other)
+    {}
+
+    Iterator& operator++()
+    {
+        ConstIterator::operator++();
+        return *this;
+    }
+
+    Iterator operator++(int)
+    {
+        auto result = *this;
+        ConstIterator::operator++();
+        return result;
+    }
+
+    Iterator& operator--()
+    {
+        ConstIterator::operator--();
+        return *this;
+    }
+
+    Iterator operator--(int)
+    {
+        auto result = *this;
+        ConstIterator::operator--();
+        return result;
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    reference operator*() const
+    {
+        return const_cast<reference>(ConstIterator::operator*());
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_BPLUSTREEMAP_H */
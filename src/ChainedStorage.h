@@ -0,0 +1,712 @@
+#ifndef AISDI_MAPS_CHAINEDSTORAGE_H
+#define AISDI_MAPS_CHAINEDSTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Hash.h"
+#include "PoolAllocator.h"
+
+namespace aisdi
+{
+
+//HashMap storage engine: bucket array of singly linked node chains.
+//The bucket array lives on the heap and is allocated by the first insertion, so an empty table
+// is a handful of words and moving or swapping one only exchanges pointers.
+//Nodes come from *Allocator* (rebound to Node); with an arena allocator such as PoolAllocator
+// clear() and the destructor give all nodes back at once when the values need no destructor.
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class ChainedTable
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using allocator_type = Allocator;
+
+    class Node;
+    using node = Node;
+    struct Position;
+
+private:
+    const static size_type MIN_BUCKETS = 16;
+    const static size_type END_INDEX = static_cast<size_type>(-1); //index of the end position
+    const static size_type REHASH_STEP = 4; //old buckets migrated per operation during incremental rehash
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    //Bucket array together with a bitmap and the range of its non-empty buckets.
+    //The bitmap is stored right after the buckets, one bit per bucket, so looking for the next
+    // non-empty bucket skips 64 empty ones per word instead of loading every bucket pointer.
+    struct BucketTable
+    {
+        node** buckets;
+        size_type size; //always a power of two, 0 until allocated
+        size_type first, last; //for faster iteration
+
+        BucketTable(): buckets(nullptr), size(0), first(END_INDEX), last(END_INDEX)
+        {}
+
+        bool isEmpty() const
+        {
+            return first == END_INDEX;
+        }
+
+        static size_type wordsFor(size_type n)
+        {
+            return (n + 63) >> 6;
+        }
+
+        //Bitmap words follow the buckets; *size* is a power of two no smaller than MIN_BUCKETS,
+        // so they are always suitably aligned
+        std::uint64_t* occupancy() const
+        {
+            return reinterpret_cast<std::uint64_t*>(buckets + size);
+        }
+
+        void allocate(size_type n)
+        {
+            //calloc lets large tables come zeroed from fresh pages instead of paying for an upfront clear
+            buckets = static_cast<node**>(std::calloc(1, n * sizeof(node*) + wordsFor(n) * sizeof(std::uint64_t)));
+            if(buckets == nullptr) throw std::bad_alloc();
+            size = n;
+            first = last = END_INDEX;
+        }
+
+        void release()
+        {
+            std::free(buckets);
+            buckets = nullptr;
+            size = 0;
+            first = last = END_INDEX;
+        }
+
+        //Index of the first non-empty bucket at or after *from* (returns END_INDEX if there is none)
+        size_type nextOccupied(size_type from) const
+        {
+            if(from >= size) return END_INDEX;
+            const std::uint64_t* words = occupancy();
+            size_type word = from >> 6;
+            std::uint64_t bits = words[word] & (~std::uint64_t(0) << (from & 63));
+            while(bits == 0)
+            {
+                if(++word == wordsFor(size)) return END_INDEX;
+                bits = words[word];
+            }
+            return (word << 6) + __builtin_ctzll(bits);
+        }
+
+        //Index of the last non-empty bucket at or before *from* (returns END_INDEX if there is none)
+        size_type prevOccupied(size_type from) const
+        {
+            if(from == END_INDEX || size == 0) return END_INDEX;
+            if(from >= size) from = size - 1;
+            const std::uint64_t* words = occupancy();
+            size_type word = from >> 6;
+            std::uint64_t bits = words[word] & (~std::uint64_t(0) >> (63 - (from & 63)));
+            while(bits == 0)
+            {
+                if(word-- == 0) return END_INDEX;
+                bits = words[word];
+            }
+            return (word << 6) + 63 - __builtin_clzll(bits);
+        }
+
+        //Empty all buckets without touching the nodes they pointed to
+        void reset()
+        {
+            if(buckets != nullptr)
+                std::memset(buckets, 0, size * sizeof(node*) + wordsFor(size) * sizeof(std::uint64_t));
+            first = last = END_INDEX;
+        }
+
+        void markOccupied(size_type index)
+        {
+            occupancy()[index >> 6] |= std::uint64_t(1) << (index & 63);
+            if(first == END_INDEX || index < first) first = index;
+            if(last == END_INDEX || index > last) last = index;
+        }
+
+        //Bucket number *index* has just become empty, move *first*/*last* if they pointed at it
+        void markEmptied(size_type index)
+        {
+            occupancy()[index >> 6] &= ~(std::uint64_t(1) << (index & 63));
+            if(index == first) first = nextOccupied(index + 1);
+            if(first == END_INDEX) last = END_INDEX; //It was the only non-empty bucket
+            else if(index == last) last = prevOccupied(index - 1);
+        }
+
+        //Unlink *nd* from bucket number *index* (the node is not deleted)
+        void unlink(size_type index, node* nd)
+        {
+            if(buckets[index] == nd) //It's the first element in the bucket
+            {
+                buckets[index] = nd->next;
+                if(buckets[index] == nullptr) markEmptied(index);
+            }
+            else
+            {
+                node* temp = buckets[index];
+                while(temp->next != nd)
+                    temp = temp->next;
+                temp->next = nd->next;
+            }
+            nd->next = nullptr;
+        }
+    };
+
+    BucketTable table; //current table, all insertions go here
+    BucketTable* oldTable; //table being migrated from, exists only during incremental rehash
+    size_type count;
+    size_type minBucketCount; //lower bound for shrinking, raised by reserve() and rehash()
+    float maxLoadFactor;
+    bool incrementalRehash;
+    Hash hasher;
+    KeyEqual keyEqual;
+    NodeAllocator nodeAllocator;
+
+public:
+    ChainedTable(): ChainedTable(Allocator())
+    {}
+
+    explicit ChainedTable(const Allocator& alloc) noexcept: oldTable(nullptr), count(0), minBucketCount(MIN_BUCKETS),
+        maxLoadFactor(1.0f), incrementalRehash(false), nodeAllocator(alloc)
+    {}
+
+    ChainedTable(const ChainedTable& other):
+        ChainedTable(Allocator(NodeTraits::select_on_container_copy_construction(other.nodeAllocator)))
+    {
+        copyTable(other);
+    }
+
+    ChainedTable(ChainedTable&& other) noexcept: ChainedTable(Allocator(other.nodeAllocator))
+    {
+        swap(other);
+    }
+
+    ~ChainedTable()
+    {
+        if(count != 0 && releaseNodesInBulk()) releaseOldTable();
+        else clear();
+        table.release();
+    }
+
+    ChainedTable& operator=(const ChainedTable& other)
+    {
+        if(&other != this)
+        {
+            clear();
+            copyTable(other);
+        }
+        return *this;
+    }
+
+    ChainedTable& operator=(ChainedTable&& other) noexcept
+    {
+        if(&other != this)
+        {
+            ChainedTable tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+private:
+    node* createNode(const key_type& key, std::size_t hash, node* next)
+    {
+        node* nd = NodeTraits::allocate(nodeAllocator, 1);
+        try
+        {
+            NodeTraits::construct(nodeAllocator, nd, key, hash, next);
+        }
+        catch(...)
+        {
+            NodeTraits::deallocate(nodeAllocator, nd, 1);
+            throw;
+        }
+        return nd;
+    }
+
+    void destroyNode(node* nd)
+    {
+        NodeTraits::destroy(nodeAllocator, nd);
+        NodeTraits::deallocate(nodeAllocator, nd, 1);
+    }
+
+    //Drop all nodes at once by releasing the arena they came from, if that is allowed
+    // and skipping the value destructors changes nothing
+    bool releaseNodesInBulk()
+    {
+        return std::is_trivially_destructible<value_type>::value && releaseArena(nodeAllocator);
+    }
+
+    void deleteNodes(BucketTable& t)
+    {
+        if(t.isEmpty()) return;
+        node *it, *temp;
+        for(size_type i = t.first; i != END_INDEX; i = t.nextOccupied(i + 1))
+        {
+            it = t.buckets[i];
+            while(it!=nullptr)
+            {
+                temp = it;
+                it = it->next;
+                destroyNode(temp);
+            }
+            t.buckets[i] = nullptr;
+        }
+        std::memset(t.occupancy(), 0, BucketTable::wordsFor(t.size) * sizeof(std::uint64_t));
+        t.first = t.last = END_INDEX;
+    }
+
+    //Fill this (empty) table with copies of *other*'s elements
+    void copyTable(const ChainedTable& other)
+    {
+        maxLoadFactor = other.maxLoadFactor;
+        incrementalRehash = other.incrementalRehash;
+        hasher = other.hasher;
+        keyEqual = other.keyEqual;
+        if(other.count == 0) return;
+        reserve(other.count);
+        for(Position pos = other.first(); pos != other.end(); other.next(pos))
+        {
+            node* nd = pos.current;
+            insertNode(bucketOf(nd->hash, table), nd->val.first, nd->hash)->val.second = nd->val.second;
+            ++count;
+        }
+    }
+
+    void releaseOldTable()
+    {
+        if(oldTable == nullptr) return;
+        oldTable->release();
+        delete oldTable;
+        oldTable = nullptr;
+    }
+
+public:
+    //Exchange contents with *other*, only pointers and counters are swapped
+    void swap(ChainedTable& other) noexcept
+    {
+        std::swap(table, other.table);
+        std::swap(oldTable, other.oldTable);
+        std::swap(count, other.count);
+        std::swap(minBucketCount, other.minBucketCount);
+        std::swap(maxLoadFactor, other.maxLoadFactor);
+        std::swap(incrementalRehash, other.incrementalRehash);
+        std::swap(hasher, other.hasher);
+        std::swap(keyEqual, other.keyEqual);
+        std::swap(nodeAllocator, other.nodeAllocator);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(nodeAllocator);
+    }
+
+    void clear()
+    {
+        if(count != 0 && releaseNodesInBulk())
+            table.reset();
+        else
+        {
+            deleteNodes(table);
+            if(oldTable != nullptr) deleteNodes(*oldTable);
+        }
+        releaseOldTable();
+        count = 0;
+    }
+
+    size_type size() const
+    {
+        return count;
+    }
+
+    size_type bucket_count() const
+    {
+        return table.size;
+    }
+
+    float load_factor() const
+    {
+        return table.size == 0 ? 0.0f : static_cast<float>(count) / table.size;
+    }
+
+    float max_load_factor() const
+    {
+        return maxLoadFactor;
+    }
+
+    //Set the load factor above which the table grows; shrinking starts below a quarter of it
+    void max_load_factor(float ml)
+    {
+        if(!(ml > 0.0f)) throw std::invalid_argument("Max load factor must be positive");
+        maxLoadFactor = ml;
+        if(count > table.size * maxLoadFactor) rehash(0);
+    }
+
+    //Resize the table to at least *n* buckets (and at least enough for the current size),
+    // the table won't shrink below that until the next call
+    void rehash(size_type n)
+    {
+        size_type needed = bucketsFor(count);
+        if(n < needed) n = needed;
+        minBucketCount = roundUpBuckets(n);
+        if(minBucketCount != table.size) rehashTo(minBucketCount);
+    }
+
+    //Make room for *n* elements without further growth
+    void reserve(size_type n)
+    {
+        rehash(bucketsFor(n));
+    }
+
+    //In incremental mode a resize only allocates the new table; the nodes are then migrated
+    // a few buckets at a time by insert and erase, so no single call pays for the whole rehash
+    //Lookups never migrate, so iterators stay valid across them as they do without a migration
+    void setIncrementalRehash(bool enabled)
+    {
+        incrementalRehash = enabled;
+        if(!enabled) finishRehash();
+    }
+
+    bool isIncrementalRehash() const
+    {
+        return incrementalRehash;
+    }
+
+    //Check whether an incremental migration is in progress
+    bool isRehashing() const
+    {
+        return oldTable != nullptr;
+    }
+
+private:
+    //Smallest bucket count keeping *n* elements within the max load factor
+    size_type bucketsFor(size_type n) const
+    {
+        return static_cast<size_type>(n / maxLoadFactor) + (n != 0);
+    }
+
+    //Bucket counts are powers of two, no smaller than MIN_BUCKETS
+    static size_type roundUpBuckets(size_type n)
+    {
+        size_type buckets = MIN_BUCKETS;
+        while(buckets < n) buckets <<= 1;
+        return buckets;
+    }
+
+    //Switch to a freshly allocated table with *newCount* buckets, the nodes are moved
+    // right away or, in incremental mode, by subsequent operations
+    void rehashTo(size_type newCount)
+    {
+        finishRehash();
+        BucketTable previous; //allocated before the swap, so a failed allocation leaves the table intact
+        previous.allocate(newCount);
+        std::swap(table, previous);
+        if(!previous.isEmpty() && incrementalRehash)
+        {
+            oldTable = new BucketTable(previous);
+            return;
+        }
+        while(!previous.isEmpty())
+            migrateBucket(previous);
+        previous.release();
+    }
+
+    //Move all nodes of the first non-empty bucket of *from* to the current table
+    void migrateBucket(BucketTable& from)
+    {
+        size_type index = from.first;
+        node* it = from.buckets[index];
+        from.buckets[index] = nullptr;
+        from.markEmptied(index);
+        while(it != nullptr)
+        {
+            node* temp = it;
+            it = it->next;
+            size_type newIndex = bucketOf(temp->hash, table);
+            temp->next = table.buckets[newIndex];
+            table.buckets[newIndex] = temp;
+            table.markOccupied(newIndex);
+        }
+    }
+
+    //Migrate at most *buckets* old buckets, release the old table once it's drained
+    void rehashStep(size_type buckets)
+    {
+        if(!isRehashing()) return;
+        while(buckets-- > 0 && !oldTable->isEmpty())
+            migrateBucket(*oldTable);
+        if(oldTable->isEmpty()) releaseOldTable();
+    }
+
+    void finishRehash()
+    {
+        rehashStep(END_INDEX);
+    }
+
+    void growIfNeeded()
+    {
+        if(count + 1 > table.size * maxLoadFactor)
+            rehashTo(std::max(minBucketCount, table.size << 1));
+    }
+
+    void shrinkIfNeeded()
+    {
+        size_type half = table.size >> 1;
+        if(half >= minBucketCount && count < half * maxLoadFactor / 2)
+            rehashTo(half);
+    }
+
+    //Bucket of *t* for the given hash, see reduceHash()
+    size_type bucketOf(std::uint64_t hash, const BucketTable& t) const
+    {
+        return reduceHash<Hash>(hash, static_cast<unsigned>(__builtin_ctzll(t.size)));
+    }
+
+    //Get pointer to a node with given *key* and *hash* in bucket number *index* of *t*
+    // (returns nullptr if the node doesn't exist); keys are compared only when the cached hashes match
+    node* getNode(const BucketTable& t, const size_type &index, const key_type& key, std::size_t hash) const
+    {
+        node* temp = t.buckets[index];
+        while(temp != nullptr)
+        {
+           if(temp->hash == hash && keyEqual(temp->val.first, key)) break;
+           temp = temp->next;
+        }
+        return temp;
+    }
+
+    //Insert a node with given *key* and *hash* at the head of bucket number *index* of the current table
+    // (returns pointer to the new node)
+    node* insertNode(const size_type &index, const key_type& key, std::size_t hash)
+    {
+        node* nd = createNode(key, hash, table.buckets[index]);
+        table.buckets[index] = nd;
+        table.markOccupied(index);
+        return nd;
+    }
+
+    //Iteration walks the current table's buckets first and then the old table's,
+    // so slots [0, table.size) are current buckets and the rest are old ones
+    node* bucketAt(size_type slot) const
+    {
+        return slot < table.size ? table.buckets[slot] : oldTable->buckets[slot - table.size];
+    }
+
+    size_type firstSlot() const
+    {
+        if(!table.isEmpty()) return table.first;
+        if(isRehashing() && !oldTable->isEmpty()) return table.size + oldTable->first;
+        return END_INDEX;
+    }
+
+    size_type lastSlot() const
+    {
+        if(isRehashing() && !oldTable->isEmpty()) return table.size + oldTable->last;
+        return table.last;
+    }
+
+    //First non-empty slot at or after *slot* (returns END_INDEX if there is none)
+    size_type nextSlotFrom(size_type slot) const
+    {
+        if(slot < table.size)
+        {
+            size_type index = table.nextOccupied(slot);
+            if(index != END_INDEX) return index;
+            slot = table.size;
+        }
+        if(!isRehashing()) return END_INDEX;
+        size_type index = oldTable->nextOccupied(slot - table.size);
+        return index == END_INDEX ? END_INDEX : table.size + index;
+    }
+
+    //Last non-empty slot at or before *slot* (returns END_INDEX if there is none)
+    size_type prevSlotFrom(size_type slot) const
+    {
+        if(slot == END_INDEX) return END_INDEX;
+        if(slot >= table.size)
+        {
+            size_type index = isRehashing() ? oldTable->prevOccupied(slot - table.size) : END_INDEX;
+            if(index != END_INDEX) return table.size + index;
+            slot = table.size - 1;
+        }
+        return table.prevOccupied(slot);
+    }
+
+    //Find the element with given *key* and *hash* in either table (returns end() if it doesn't exist)
+    Position find(const key_type& key, std::size_t hash) const
+    {
+        if(count == 0) return end();
+        size_type slot = bucketOf(hash, table);
+        node* temp = getNode(table, slot, key, hash);
+        if(temp == nullptr && isRehashing() && !oldTable->isEmpty())
+        {
+            size_type index = bucketOf(hash, *oldTable);
+            temp = getNode(*oldTable, index, key, hash);
+            slot = table.size + index;
+        }
+        return temp == nullptr ? end() : Position(temp, slot);
+    }
+
+public:
+    //Find the element with given *key* in either table (returns end() if it doesn't exist)
+    Position find(const key_type& key) const
+    {
+        return find(key, hasher(key));
+    }
+
+    //Return the element with given *key*, default-constructing its value if it doesn't exist
+    value_type& insert(const key_type& key)
+    {
+        rehashStep(REHASH_STEP);
+        std::size_t hash = hasher(key);
+        Position pos = find(key, hash);
+        if(pos != end()) return pos.current->val;
+
+        growIfNeeded();
+        node* temp = insertNode(bucketOf(hash, table), key, hash);
+        ++count;
+        return temp->val;
+    }
+
+    void erase(const Position& pos)
+    {
+        if(pos.index < table.size) table.unlink(pos.index, pos.current);
+        else oldTable->unlink(pos.index - table.size, pos.current);
+
+        destroyNode(pos.current);
+        --count;
+        if(isRehashing()) rehashStep(REHASH_STEP);
+        else shrinkIfNeeded();
+    }
+
+    value_type& at(const Position& pos) const
+    {
+        return pos.current->val;
+    }
+
+    Position first() const
+    {
+        if(count == 0) return end();
+        size_type slot = firstSlot();
+        return Position(bucketAt(slot), slot);
+    }
+
+    Position end() const
+    {
+        return Position(nullptr, END_INDEX);
+    }
+
+    //Move *pos* to the next element or to the end position
+    void next(Position& pos) const
+    {
+        if(pos.current->next != nullptr)
+        {
+            pos.current = pos.current->next;
+            return;
+        }
+        pos.index = nextSlotFrom(pos.index + 1);
+        pos.current = pos.index == END_INDEX ? nullptr : bucketAt(pos.index);
+    }
+
+    //Move *pos* to the previous element, it must not be the first one
+    void prev(Position& pos) const
+    {
+        node* temp;
+        if(pos.index == END_INDEX)
+        {
+            pos.index = lastSlot();
+            temp = bucketAt(pos.index);
+            while(temp->next != nullptr)
+                temp = temp->next;
+            pos.current = temp;
+            return;
+        }
+        if(bucketAt(pos.index) != pos.current)
+        {
+            temp = bucketAt(pos.index);
+            while(temp->next != pos.current)
+                temp = temp->next;
+            pos.current = temp;
+            return;
+        }
+        pos.index = prevSlotFrom(pos.index - 1);
+        temp = bucketAt(pos.index);
+        while(temp->next != nullptr)
+            temp = temp->next;
+        pos.current = temp;
+    }
+};
+
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+class ChainedTable<KeyType, ValueType, Hash, KeyEqual, Allocator>::Node
+{
+public:
+    friend class ChainedTable<KeyType, ValueType, Hash, KeyEqual, Allocator>;
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using node = Node;
+
+private:
+    node *next;
+    size_type hash; //full hash of the key, so chain walks and rehashing don't recompute it
+    value_type val;
+
+public:
+    Node(key_type key, size_type h, node* n = nullptr): next(n), hash(h), val(value_type(key, mapped_type()))
+    {}
+
+    ~Node()
+    {
+        next = nullptr;
+    }
+};
+
+//Element position: its node and the iteration slot of its bucket
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+struct ChainedTable<KeyType, ValueType, Hash, KeyEqual, Allocator>::Position
+{
+    node* current;
+    size_type index;
+
+    Position(node* n, size_type in): current(n), index(in)
+    {}
+
+    bool operator==(const Position& other) const
+    {
+        return current == other.current && index == other.index;
+    }
+
+    bool operator!=(const Position& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+//HashMap storage policy selecting ChainedTable
+struct ChainedStorage
+{
+    template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+    using Engine = ChainedTable<KeyType, ValueType, Hash, KeyEqual, Allocator>;
+};
+
+}
+
+#endif /* AISDI_MAPS_CHAINEDSTORAGE_H */
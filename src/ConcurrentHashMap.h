@@ -0,0 +1,332 @@
+#ifndef AISDI_MAPS_CONCURRENTHASHMAP_H
+#define AISDI_MAPS_CONCURRENTHASHMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "Epoch.h"
+#include "Hash.h"
+
+namespace aisdi
+{
+
+//Thread-safe chained hash map for read-mostly workloads.
+//Readers take no lock and write nothing the writers or other readers touch: they pin the epoch
+// (see Epoch.h) and walk the chains through atomic pointers. Published nodes are immutable, so
+// a writer changing a value links in a new node in place of the old one, and unlinked nodes are
+// retired and freed by epoch-based reclamation once no reader can see them.
+//Writers lock one of *LockCount* stripes (a bucket's lock is its index modulo *LockCount*).
+//Growing locks all stripes, builds a copy of the table and publishes it with a single store;
+// a reader that finds the table replaced under it looks the key up again in the new one.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+    std::size_t LockCount = 64>
+class ConcurrentHashMap
+{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using hasher_type = Hash;
+    using key_equal = KeyEqual;
+
+    static_assert(LockCount > 0 && (LockCount & (LockCount - 1)) == 0, "LockCount must be a power of two");
+
+private:
+    const static size_type INITIAL_BUCKET_COUNT = 16;
+    const static size_type CACHE_LINE = 64;
+
+    struct Node
+    {
+        const value_type val;
+        const std::uint64_t hash;
+        std::atomic<Node*> next;
+
+        Node(const key_type& key, const mapped_type& value, std::uint64_t h, Node* n):
+            val(key, value), hash(h), next(n)
+        {}
+    };
+
+    //Bucket array; the chains hanging from it belong to the table, see destroyTable()
+    struct Table
+    {
+        const size_type size;
+        const unsigned bits;
+        std::atomic<Node*>* const buckets;
+
+        explicit Table(unsigned b): size(size_type(1) << b), bits(b), buckets(new std::atomic<Node*>[size])
+        {
+            for(size_type i = 0; i < size; ++i)
+                buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        Table(const Table&) = delete;
+        Table& operator=(const Table&) = delete;
+
+        ~Table()
+        {
+            delete[] buckets;
+        }
+    };
+
+    struct Stripe
+    {
+        std::mutex mutex;
+        char padding[CACHE_LINE]; //keeps neighbouring locks off each other's cache line
+    };
+
+    std::atomic<Table*> table;
+    std::atomic<size_type> count;
+    Stripe stripes[LockCount];
+    Hash hasher;
+    KeyEqual keyEqual;
+
+    //Lock on all stripes, taken in order
+    class AllStripesLock
+    {
+        Stripe* stripes;
+
+    public:
+        explicit AllStripesLock(Stripe* s): stripes(s)
+        {
+            for(size_type i = 0; i < LockCount; ++i)
+                stripes[i].mutex.lock();
+        }
+
+        ~AllStripesLock()
+        {
+            for(size_type i = LockCount; i > 0; --i)
+                stripes[i - 1].mutex.unlock();
+        }
+    };
+
+public:
+    ConcurrentHashMap(): table(new Table(__builtin_ctzll(INITIAL_BUCKET_COUNT))), count(0)
+    {}
+
+    ConcurrentHashMap(std::initializer_list<value_type> list): ConcurrentHashMap()
+    {
+        for(const value_type& item : list)
+            insert(item.first, item.second);
+    }
+
+    ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+    ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+    //No other thread may use the map anymore; nodes retired earlier are left to the epoch manager
+    ~ConcurrentHashMap()
+    {
+        destroyTable(table.load(std::memory_order_relaxed));
+    }
+
+    //Copy the value of *key* to *value* (returns false if the key doesn't exist)
+    bool find(const key_type& key, mapped_type& value) const
+    {
+        EpochGuard guard;
+        const Node* nd = lookup(key);
+        if(nd == nullptr) return false;
+        value = nd->val.second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const
+    {
+        EpochGuard guard;
+        return lookup(key) != nullptr;
+    }
+
+    mapped_type valueOf(const key_type& key) const
+    {
+        EpochGuard guard;
+        const Node* nd = lookup(key);
+        if(nd == nullptr) throw std::out_of_range("Node with given key doesn't exist");
+        return nd->val.second;
+    }
+
+    //Set the value of *key*, adding it if it doesn't exist
+    void insert(const key_type& key, const mapped_type& value)
+    {
+        update(key, [&value](mapped_type& v) { v = value; });
+    }
+
+    //Call *f* on a copy of the value of *key* (default-constructed if it doesn't exist) and publish
+    // the result, all under the bucket's lock, so read-modify-write updates are atomic
+    template <typename Function>
+    void update(const key_type& key, Function f)
+    {
+        std::uint64_t hash = hasher(key);
+        bool added;
+        {
+            EpochGuard guard;
+            Table* t = lockBucket(hash);
+            std::atomic<Node*>& head = t->buckets[reduceHash<Hash>(hash, t->bits)];
+            std::lock_guard<std::mutex> lock(stripeOf(hash, t).mutex, std::adopt_lock);
+
+            std::atomic<Node*>* link = findLink(head, key, hash);
+            Node* old = link->load(std::memory_order_relaxed);
+            added = old == nullptr;
+
+            mapped_type value = added ? mapped_type() : old->val.second;
+            f(value);
+            if(added)
+            {
+                head.store(new Node(key, value, hash, head.load(std::memory_order_relaxed)), std::memory_order_release);
+                count.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                link->store(new Node(key, value, hash, old->next.load(std::memory_order_relaxed)), std::memory_order_release);
+                EpochManager::instance().retire(old);
+            }
+        }
+        if(added) growIfNeeded();
+    }
+
+    //Remove *key* (returns false if it didn't exist)
+    bool remove(const key_type& key)
+    {
+        std::uint64_t hash = hasher(key);
+        EpochGuard guard;
+        Table* t = lockBucket(hash);
+        std::lock_guard<std::mutex> lock(stripeOf(hash, t).mutex, std::adopt_lock);
+
+        std::atomic<Node*>* link = findLink(t->buckets[reduceHash<Hash>(hash, t->bits)], key, hash);
+        Node* nd = link->load(std::memory_order_relaxed);
+        if(nd == nullptr) return false;
+        //Readers standing on *nd* still see the rest of the chain through its next pointer
+        link->store(nd->next.load(std::memory_order_relaxed), std::memory_order_release);
+        count.fetch_sub(1, std::memory_order_relaxed);
+        EpochManager::instance().retire(nd);
+        return true;
+    }
+
+    size_type getSize() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool isEmpty() const
+    {
+        return getSize() == 0;
+    }
+
+    size_type bucket_count() const
+    {
+        EpochGuard guard;
+        return table.load(std::memory_order_acquire)->size;
+    }
+
+    //Call *f* on every element without locking: elements added or removed during the walk may
+    // or may not be seen, each one that stays in the map the whole time is seen exactly once
+    template <typename Function>
+    void forEach(Function f) const
+    {
+        EpochGuard guard;
+        const Table* t = table.load(std::memory_order_acquire);
+        for(size_type i = 0; i < t->size; ++i)
+            for(const Node* nd = t->buckets[i].load(std::memory_order_acquire); nd != nullptr;
+                nd = nd->next.load(std::memory_order_acquire))
+                f(nd->val);
+    }
+
+private:
+    //Node of *key* in the current table, the caller has to be pinned
+    const Node* lookup(const key_type& key) const
+    {
+        std::uint64_t hash = hasher(key);
+        for(;;)
+        {
+            const Table* t = table.load(std::memory_order_acquire);
+            const Node* nd = t->buckets[reduceHash<Hash>(hash, t->bits)].load(std::memory_order_acquire);
+            while(nd != nullptr && (nd->hash != hash || !keyEqual(nd->val.first, key)))
+                nd = nd->next.load(std::memory_order_acquire);
+            //Writers go to a new table as soon as it is published, so an answer from the old one could be stale
+            if(table.load(std::memory_order_acquire) == t) return nd;
+        }
+    }
+
+    Stripe& stripeOf(std::uint64_t hash, const Table* t)
+    {
+        return stripes[reduceHash<Hash>(hash, t->bits) & (LockCount - 1)];
+    }
+
+    //Lock the stripe of *hash*'s bucket in the current table and return that table
+    Table* lockBucket(std::uint64_t hash)
+    {
+        for(;;)
+        {
+            Table* t = table.load(std::memory_order_acquire);
+            Stripe& stripe = stripeOf(hash, t);
+            stripe.mutex.lock();
+            if(table.load(std::memory_order_relaxed) == t) return t;
+            stripe.mutex.unlock(); //grown in the meantime
+        }
+    }
+
+    //Link pointing at the node of *key* in the chain starting at *head*, or at the chain's end
+    //Called under the bucket's lock, so the chain doesn't change meanwhile
+    std::atomic<Node*>* findLink(std::atomic<Node*>& head, const key_type& key, std::uint64_t hash)
+    {
+        std::atomic<Node*>* link = &head;
+        for(Node* nd = link->load(std::memory_order_relaxed); nd != nullptr; nd = link->load(std::memory_order_relaxed))
+        {
+            if(nd->hash == hash && keyEqual(nd->val.first, key)) break;
+            link = &nd->next;
+        }
+        return link;
+    }
+
+    //Double the table once the load factor goes above 1
+    void growIfNeeded()
+    {
+        Table* t = table.load(std::memory_order_acquire);
+        if(count.load(std::memory_order_relaxed) <= t->size) return;
+
+        EpochGuard guard;
+        AllStripesLock lock(stripes);
+        Table* current = table.load(std::memory_order_relaxed);
+        if(current != t) return; //someone else grew it
+
+        //Readers may still be walking the old chains, so they are copied rather than relinked
+        Table* bigger = new Table(t->bits + 1);
+        for(size_type i = 0; i < t->size; ++i)
+        {
+            for(Node* nd = t->buckets[i].load(std::memory_order_relaxed); nd != nullptr;
+                nd = nd->next.load(std::memory_order_relaxed))
+            {
+                std::atomic<Node*>& head = bigger->buckets[reduceHash<Hash>(nd->hash, bigger->bits)];
+                head.store(new Node(nd->val.first, nd->val.second, nd->hash, head.load(std::memory_order_relaxed)),
+                    std::memory_order_relaxed);
+            }
+        }
+        table.store(bigger, std::memory_order_release);
+        EpochManager::instance().retire(t, destroyTable);
+    }
+
+    //Free *p* (a Table) together with all nodes still linked in it
+    static void destroyTable(void* p)
+    {
+        Table* t = static_cast<Table*>(p);
+        for(size_type i = 0; i < t->size; ++i)
+        {
+            Node* nd = t->buckets[i].load(std::memory_order_relaxed);
+            while(nd != nullptr)
+            {
+                Node* temp = nd;
+                nd = nd->next.load(std::memory_order_relaxed);
+                delete temp;
+            }
+        }
+        delete t;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTHASHMAP_H */
@@ -0,0 +1,502 @@
+#ifndef AISDI_MAPS_CONCURRENTSKIPLISTMAP_H
+#define AISDI_MAPS_CONCURRENTSKIPLISTMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "Epoch.h"
+
+namespace aisdi
+{
+
+//Thread-safe ordered map without locks: a skip list whose links are changed by compare-and-swap.
+//Every node is linked at the bottom level and, with probability 1/2 per level, at the levels above
+// it, so a search skips over most nodes. An element lives in an immutable item the node points to;
+// changing a value swaps in a new item, removing a key swaps in nullptr, and the node is then
+// marked (the low bit of each of its links) and unlinked level by level by whichever thread
+// passes it first. A node is freed by epoch-based reclamation (see Epoch.h) once it is unlinked
+// from every level and its inserter is done with it.
+//Lookups and iteration write nothing shared. Iteration is weakly consistent: it sees every element
+// that stays in the map the whole time, in key order, and may or may not see the others. An
+// iterator keeps its thread pinned to the epoch while it lives, so it has to be used and destroyed
+// on the thread that created it and shouldn't be kept long.
+template <typename KeyType, typename ValueType>
+class ConcurrentSkipListMap
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+    using iterator = ConstIterator;
+
+private:
+    const static int MAX_LEVEL = 32;
+
+    //Pointer to the next node, with the low bit set once the node holding it is being removed
+    using Link = std::atomic<std::uintptr_t>;
+
+    struct Node
+    {
+        const key_type key;
+        std::atomic<value_type*> item; //nullptr once removed
+        //Levels it is linked at, plus one while its inserter is still linking it
+        std::atomic<int> references;
+        const int height;
+        Link* const next; //*height* links, allocated right behind the node
+
+        Node(const key_type& k, value_type* i, int h):
+            key(k), item(i), references(2), height(h), next(reinterpret_cast<Link*>(this + 1))
+        {
+            for(int level = 0; level < height; ++level)
+                new(&next[level]) Link(0);
+        }
+    };
+
+    Link head[MAX_LEVEL];
+    std::atomic<size_type> count;
+
+public:
+    ConcurrentSkipListMap(): count(0)
+    {
+        for(Link& link : head)
+            link.store(0, std::memory_order_relaxed);
+    }
+
+    ConcurrentSkipListMap(std::initializer_list<value_type> list): ConcurrentSkipListMap()
+    {
+        for(const value_type& item : list)
+            insert(item.first, item.second);
+    }
+
+    ConcurrentSkipListMap(const ConcurrentSkipListMap&) = delete;
+    ConcurrentSkipListMap& operator=(const ConcurrentSkipListMap&) = delete;
+
+    //No other thread may use the map anymore; nodes retired earlier are left to the epoch manager
+    ~ConcurrentSkipListMap()
+    {
+        Node* nd = nodeOf(head[0].load(std::memory_order_relaxed));
+        while(nd != nullptr)
+        {
+            Node* temp = nd;
+            nd = nodeOf(nd->next[0].load(std::memory_order_relaxed));
+            delete temp->item.load(std::memory_order_relaxed);
+            destroyNode(temp);
+        }
+    }
+
+    //Copy the value of *key* to *value* (returns false if the key doesn't exist)
+    bool find(const key_type& key, mapped_type& value) const
+    {
+        EpochGuard guard;
+        const value_type* item = lookup(key);
+        if(item == nullptr) return false;
+        value = item->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const
+    {
+        EpochGuard guard;
+        return lookup(key) != nullptr;
+    }
+
+    mapped_type valueOf(const key_type& key) const
+    {
+        EpochGuard guard;
+        const value_type* item = lookup(key);
+        if(item == nullptr) throw std::out_of_range("Node with given key doesn't exist");
+        return item->second;
+    }
+
+    //Set the value of *key*, adding it if it doesn't exist
+    void insert(const key_type& key, const mapped_type& value)
+    {
+        EpochGuard guard;
+        std::unique_ptr<value_type> item(new value_type(key, value));
+        Link* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        for(;;)
+        {
+            if(search(key, preds, succs))
+            {
+                Node* nd = succs[0];
+                value_type* old = nd->item.load(std::memory_order_acquire);
+                while(old != nullptr && !nd->item.compare_exchange_weak(old, item.get(), std::memory_order_acq_rel,
+                    std::memory_order_acquire))
+                {}
+                if(old != nullptr)
+                {
+                    item.release();
+                    EpochManager::instance().retire(old);
+                    return;
+                }
+                //Removed in the meantime: help unlink it, then add the key anew
+                markLinks(nd);
+                continue;
+            }
+
+            Node* nd = createNode(key, item.get(), randomHeight());
+            for(int level = 0; level < nd->height; ++level)
+                nd->next[level].store(linkTo(succs[level]), std::memory_order_relaxed);
+            std::uintptr_t expected = linkTo(succs[0]);
+            if(!preds[0]->compare_exchange_strong(expected, linkTo(nd), std::memory_order_release, std::memory_order_relaxed))
+            {
+                destroyNode(nd); //never published
+                continue;
+            }
+            item.release();
+            count.fetch_add(1, std::memory_order_relaxed);
+            linkUpperLevels(nd, preds, succs);
+            return;
+        }
+    }
+
+    //Remove *key* (returns false if it didn't exist)
+    bool remove(const key_type& key)
+    {
+        EpochGuard guard;
+        Link* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        if(!search(key, preds, succs)) return false;
+
+        Node* nd = succs[0];
+        value_type* old = nd->item.load(std::memory_order_acquire);
+        while(old != nullptr && !nd->item.compare_exchange_weak(old, nullptr, std::memory_order_acq_rel,
+            std::memory_order_acquire))
+        {}
+        if(old == nullptr) return false; //another thread removed it first
+        count.fetch_sub(1, std::memory_order_relaxed);
+        EpochManager::instance().retire(old);
+        markLinks(nd);
+        search(key, preds, succs); //unlinks it from every level
+        return true;
+    }
+
+    size_type getSize() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool isEmpty() const
+    {
+        return getSize() == 0;
+    }
+
+    //First element whose key is not less than *key* (end() if there is none)
+    const_iterator lowerBound(const key_type& key) const
+    {
+        EpochGuard guard;
+        const Link* links = head;
+        Node* nd = nullptr;
+        for(int level = MAX_LEVEL - 1; level >= 0; --level)
+        {
+            nd = nodeOf(links[level].load(std::memory_order_acquire));
+            while(nd != nullptr && nd->key < key)
+            {
+                links = nd->next;
+                nd = nodeOf(links[level].load(std::memory_order_acquire));
+            }
+        }
+        return const_iterator(nd);
+    }
+
+    //First element whose key is greater than *key* (end() if there is none)
+    const_iterator upperBound(const key_type& key) const
+    {
+        const_iterator it = lowerBound(key);
+        if(it != end() && !(key < it->first)) ++it;
+        return it;
+    }
+
+    const_iterator cbegin() const
+    {
+        EpochGuard guard;
+        return const_iterator(nodeOf(head[0].load(std::memory_order_acquire)));
+    }
+
+    const_iterator cend() const
+    {
+        return const_iterator();
+    }
+
+    const_iterator begin() const
+    {
+        return cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return cend();
+    }
+
+private:
+    static Node* nodeOf(std::uintptr_t link)
+    {
+        return reinterpret_cast<Node*>(link & ~std::uintptr_t(1));
+    }
+
+    static bool isMarked(std::uintptr_t link)
+    {
+        return (link & 1) != 0;
+    }
+
+    static std::uintptr_t linkTo(const Node* nd)
+    {
+        return reinterpret_cast<std::uintptr_t>(nd);
+    }
+
+    static Node* createNode(const key_type& key, value_type* item, int height)
+    {
+        void* memory = ::operator new(sizeof(Node) + height * sizeof(Link));
+        try
+        {
+            return new(memory) Node(key, item, height);
+        }
+        catch(...)
+        {
+            ::operator delete(memory);
+            throw;
+        }
+    }
+
+    //Free *p* (a Node), leaving its item alone
+    static void destroyNode(void* p)
+    {
+        Node* nd = static_cast<Node*>(p);
+        for(int level = 0; level < nd->height; ++level)
+            nd->next[level].~Link();
+        nd->~Node();
+        ::operator delete(p);
+    }
+
+    //Drop a reference to *nd*, retiring it once it is linked nowhere and its inserter is done
+    static void release(Node* nd)
+    {
+        if(nd->references.fetch_sub(1, std::memory_order_acq_rel) == 1) EpochManager::instance().retire(nd, destroyNode);
+    }
+
+    //Number of levels for a new node: 1 + the trailing zero bits of a random number, so each level
+    // has about half the nodes of the one below
+    static int randomHeight()
+    {
+        static thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull ^ reinterpret_cast<std::uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return 1 + __builtin_ctzll(state | (std::uint64_t(1) << (MAX_LEVEL - 1)));
+    }
+
+    //Element with *key*, the caller has to be pinned
+    //Walks past removed nodes without unlinking them, so it doesn't write anything
+    const value_type* lookup(const key_type& key) const
+    {
+        const Link* links = head;
+        Node* nd = nullptr;
+        for(int level = MAX_LEVEL - 1; level >= 0; --level)
+        {
+            nd = nodeOf(links[level].load(std::memory_order_acquire));
+            while(nd != nullptr && nd->key < key)
+            {
+                links = nd->next;
+                nd = nodeOf(links[level].load(std::memory_order_acquire));
+            }
+        }
+        if(nd == nullptr || key < nd->key) return nullptr;
+        return nd->item.load(std::memory_order_acquire);
+    }
+
+    //Find, on every level, the link to the first node whose key is not less than *key* (*preds*) and
+    // that node (*succs*), unlinking marked nodes on the way (returns true if succs[0] has *key*)
+    //The caller has to be pinned. A failed unlink means the list changed under it, so it starts over.
+    bool search(const key_type& key, Link** preds, Node** succs)
+    {
+    retry:
+        Link* links = head;
+        for(int level = MAX_LEVEL - 1; level >= 0; --level)
+        {
+            std::uintptr_t current = links[level].load(std::memory_order_acquire);
+            if(isMarked(current)) goto retry; //the node holding *links* is being removed
+            Node* nd = nodeOf(current);
+            while(nd != nullptr)
+            {
+                std::uintptr_t next = nd->next[level].load(std::memory_order_acquire);
+                if(isMarked(next))
+                {
+                    if(!links[level].compare_exchange_strong(current, next & ~std::uintptr_t(1), std::memory_order_acq_rel,
+                        std::memory_order_relaxed))
+                        goto retry;
+                    release(nd);
+                    current = next & ~std::uintptr_t(1);
+                    nd = nodeOf(current);
+                    continue;
+                }
+                if(!(nd->key < key)) break;
+                links = nd->next;
+                current = next;
+                nd = nodeOf(next);
+            }
+            preds[level] = &links[level];
+            succs[level] = nd;
+        }
+        return succs[0] != nullptr && !(key < succs[0]->key);
+    }
+
+    //Mark all links of *nd*, top down, so that no node can be linked behind it anymore and every
+    // thread passing it unlinks it
+    static void markLinks(Node* nd)
+    {
+        for(int level = nd->height - 1; level >= 0; --level)
+        {
+            std::uintptr_t next = nd->next[level].load(std::memory_order_relaxed);
+            while(!isMarked(next) && !nd->next[level].compare_exchange_weak(next, next | 1, std::memory_order_acq_rel,
+                std::memory_order_relaxed))
+            {}
+        }
+    }
+
+    //Link *nd*, already in the bottom level, into its upper levels, giving up when it gets removed
+    void linkUpperLevels(Node* nd, Link** preds, Node** succs)
+    {
+        for(int level = 1; level < nd->height; ++level)
+        {
+            for(;;)
+            {
+                //Point the node at its successor first; this fails only once the node is marked
+                std::uintptr_t next = nd->next[level].load(std::memory_order_acquire);
+                if(isMarked(next)) goto done;
+                if(next != linkTo(succs[level]) && !nd->next[level].compare_exchange_strong(next, linkTo(succs[level]),
+                    std::memory_order_acq_rel, std::memory_order_acquire))
+                    goto done;
+
+                nd->references.fetch_add(1, std::memory_order_relaxed);
+                std::uintptr_t expected = linkTo(succs[level]);
+                if(preds[level]->compare_exchange_strong(expected, linkTo(nd), std::memory_order_release,
+                    std::memory_order_relaxed))
+                    break;
+                nd->references.fetch_sub(1, std::memory_order_relaxed);
+                if(!search(nd->key, preds, succs) || succs[0] != nd) goto done;
+            }
+        }
+    done:
+        //A removal that finished before a level was linked has left the node there; unlink it again
+        if(nd->item.load(std::memory_order_acquire) == nullptr)
+        {
+            Link* others[MAX_LEVEL];
+            Node* found[MAX_LEVEL];
+            search(nd->key, others, found);
+        }
+        release(nd);
+    }
+};
+
+template <typename KeyType, typename ValueType>
+class ConcurrentSkipListMap<KeyType, ValueType>::ConstIterator
+{
+public:
+    friend class ConcurrentSkipListMap<KeyType, ValueType>;
+    using reference = typename ConcurrentSkipListMap::const_reference;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename ConcurrentSkipListMap::value_type;
+    using pointer = const typename ConcurrentSkipListMap::value_type*;
+
+private:
+    Node* current; //nullptr at the end
+    const value_type* item; //*current*'s element when the iterator got there
+    bool pinned;
+
+    //Iterator at the first element still in the map from *nd* on
+    explicit ConstIterator(Node* nd): current(nullptr), item(nullptr), pinned(true)
+    {
+        EpochManager::instance().pin();
+        moveTo(nd);
+    }
+
+public:
+    ConstIterator(): current(nullptr), item(nullptr), pinned(false)
+    {}
+
+    ConstIterator(const ConstIterator& other): current(other.current), item(other.item), pinned(other.pinned)
+    {
+        if(pinned) EpochManager::instance().pin();
+    }
+
+    ConstIterator& operator=(const ConstIterator& other)
+    {
+        if(other.pinned) EpochManager::instance().pin();
+        if(pinned) EpochManager::instance().unpin();
+        current = other.current;
+        item = other.item;
+        pinned = other.pinned;
+        return *this;
+    }
+
+    ~ConstIterator()
+    {
+        if(pinned) EpochManager::instance().unpin();
+    }
+
+    ConstIterator& operator++()
+    {
+        if(current == nullptr) throw std::out_of_range("Cannot increment iterator");
+        moveTo(nodeOf(current->next[0].load(std::memory_order_acquire)));
+        return *this;
+    }
+
+    ConstIterator operator++(int)
+    {
+        ConstIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    reference operator*() const
+    {
+        if(current == nullptr) throw std::out_of_range("Iterator points at empty space after the last element");
+        return *item;
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const
+    {
+        return current == other.current;
+    }
+
+    bool operator!=(const ConstIterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Skip removed nodes; even a removed node still links to the rest of the list
+    void moveTo(Node* nd)
+    {
+        for(; nd != nullptr; nd = nodeOf(nd->next[0].load(std::memory_order_acquire)))
+        {
+            item = nd->item.load(std::memory_order_acquire);
+            if(item != nullptr) break;
+        }
+        current = nd;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTSKIPLISTMAP_H */
@@ -0,0 +1,534 @@
+#ifndef AISDI_MAPS_CONCURRENTTREEMAP_H
+#define AISDI_MAPS_CONCURRENTTREEMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "Epoch.h"
+
+namespace aisdi
+{
+
+//AVL tree for many readers and a few writers. Writers take turns on a mutex; readers take no lock
+// and never make a writer wait. They search optimistically instead (Bronson et al., "A Practical
+// Concurrent Binary Search Tree"): each node has a version that changes when a rotation moves the
+// node down, so that its subtree covers fewer keys, or when the node leaves the tree. A reader
+// checks that the version of the node it stands on is unchanged after reading a child pointer,
+// and starts over from the root otherwise.
+//As in TreeMap, nodes are also linked in key order, which is what iterators follow. An element
+// lives in an immutable item the node points to; changing a value swaps in a new item and
+// removing a key swaps in nullptr. A removed node with two children stays in the tree, routing
+// searches, until its key is added again or a removal or rotation leaves it with at most one
+// child. Replaced items and unlinked nodes are freed by epoch-based reclamation (see Epoch.h).
+//Iteration is weakly consistent, as in ConcurrentSkipListMap, and an iterator keeps its thread
+// pinned to the epoch while it lives.
+template <typename KeyType, typename ValueType>
+class ConcurrentTreeMap
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+    using iterator = ConstIterator;
+
+private:
+    //Version bits: CHANGING while a rotation moves the node down, UNLINKED once it has left the tree
+    const static std::uint64_t CHANGING = 1, UNLINKED = 2, STEP = 4;
+
+    struct Node
+    {
+        const key_type key;
+        std::atomic<value_type*> item; //nullptr once removed
+        std::atomic<Node*> left, right;
+        std::atomic<Node*> next; //neighbour in key order, nullptr after the last node
+        std::atomic<std::uint64_t> version;
+        //Read and written by the writer holding the mutex only
+        Node *parent, *prev;
+        int height; //of the subtree rooted here
+
+        Node(const key_type& k, value_type* i, Node* p): key(k), item(i), left(nullptr), right(nullptr),
+            next(nullptr), version(0), parent(p), prev(nullptr), height(1)
+        {}
+    };
+
+    std::atomic<Node*> root;
+    std::atomic<Node*> first;
+    std::atomic<size_type> count;
+    std::mutex writeMutex;
+
+public:
+    ConcurrentTreeMap(): root(nullptr), first(nullptr), count(0)
+    {}
+
+    ConcurrentTreeMap(std::initializer_list<value_type> list): ConcurrentTreeMap()
+    {
+        for(const value_type& item : list)
+            insert(item.first, item.second);
+    }
+
+    ConcurrentTreeMap(const ConcurrentTreeMap&) = delete;
+    ConcurrentTreeMap& operator=(const ConcurrentTreeMap&) = delete;
+
+    //No other thread may use the map anymore; nodes retired earlier are left to the epoch manager
+    ~ConcurrentTreeMap()
+    {
+        Node* nd = first.load(std::memory_order_relaxed);
+        while(nd != nullptr)
+        {
+            Node* temp = nd;
+            nd = nd->next.load(std::memory_order_relaxed);
+            delete temp->item.load(std::memory_order_relaxed);
+            delete temp;
+        }
+    }
+
+    //Copy the value of *key* to *value* (returns false if the key doesn't exist)
+    bool find(const key_type& key, mapped_type& value) const
+    {
+        EpochGuard guard;
+        const value_type* item = lookup(key);
+        if(item == nullptr) return false;
+        value = item->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const
+    {
+        EpochGuard guard;
+        return lookup(key) != nullptr;
+    }
+
+    mapped_type valueOf(const key_type& key) const
+    {
+        EpochGuard guard;
+        const value_type* item = lookup(key);
+        if(item == nullptr) throw std::out_of_range("Node with given key doesn't exist");
+        return item->second;
+    }
+
+    //Set the value of *key*, adding it if it doesn't exist
+    void insert(const key_type& key, const mapped_type& value)
+    {
+        std::unique_ptr<value_type> item(new value_type(key, value));
+        std::lock_guard<std::mutex> guard(writeMutex);
+        Node* parent = nullptr;
+        Node* nd = root.load(std::memory_order_relaxed);
+        while(nd != nullptr && (key < nd->key || nd->key < key))
+        {
+            parent = nd;
+            nd = (key < nd->key ? nd->left : nd->right).load(std::memory_order_relaxed);
+        }
+        if(nd != nullptr)
+        {
+            value_type* old = nd->item.exchange(item.release(), std::memory_order_acq_rel);
+            if(old != nullptr) EpochManager::instance().retire(old);
+            else count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        nd = new Node(key, item.get(), parent);
+        item.release();
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        if(parent != nullptr && key < parent->key)
+        {
+            prev = parent->prev;
+            next = parent;
+        }
+        else if(parent != nullptr)
+        {
+            prev = parent;
+            next = parent->next.load(std::memory_order_relaxed);
+        }
+        nd->prev = prev;
+        nd->next.store(next, std::memory_order_relaxed);
+        if(next != nullptr) next->prev = nd;
+
+        //Publishing the node; everything readers can see of it is set by now
+        if(parent == nullptr) root.store(nd, std::memory_order_release);
+        else (key < parent->key ? parent->left : parent->right).store(nd, std::memory_order_release);
+        (prev != nullptr ? prev->next : first).store(nd, std::memory_order_release);
+        count.fetch_add(1, std::memory_order_relaxed);
+        rebalanceUpwards(parent);
+    }
+
+    //Remove *key* (returns false if it didn't exist)
+    bool remove(const key_type& key)
+    {
+        std::lock_guard<std::mutex> guard(writeMutex);
+        Node* nd = root.load(std::memory_order_relaxed);
+        while(nd != nullptr && (key < nd->key || nd->key < key))
+            nd = (key < nd->key ? nd->left : nd->right).load(std::memory_order_relaxed);
+        if(nd == nullptr) return false;
+        value_type* old = nd->item.exchange(nullptr, std::memory_order_acq_rel);
+        if(old == nullptr) return false;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        EpochManager::instance().retire(old);
+
+        if(childCount(nd) < 2) rebalanceUpwards(nd);
+        return true;
+    }
+
+    size_type getSize() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    bool isEmpty() const
+    {
+        return getSize() == 0;
+    }
+
+    //First element whose key is not less than *key* (end() if there is none)
+    const_iterator lowerBound(const key_type& key) const
+    {
+        EpochGuard guard;
+        std::uint64_t version;
+        Node* nd = descend(key, version);
+        //A search for a missing key ends at its predecessor or its successor
+        if(nd != nullptr && nd->key < key) nd = nd->next.load(std::memory_order_acquire);
+        return const_iterator(nd);
+    }
+
+    //First element whose key is greater than *key* (end() if there is none)
+    const_iterator upperBound(const key_type& key) const
+    {
+        const_iterator it = lowerBound(key);
+        if(it != end() && !(key < it->first)) ++it;
+        return it;
+    }
+
+    const_iterator cbegin() const
+    {
+        EpochGuard guard;
+        return const_iterator(first.load(std::memory_order_acquire));
+    }
+
+    const_iterator cend() const
+    {
+        return const_iterator();
+    }
+
+    const_iterator begin() const
+    {
+        return cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return cend();
+    }
+
+private:
+    //Element with *key*, the caller has to be pinned
+    const value_type* lookup(const key_type& key) const
+    {
+        for(;;)
+        {
+            std::uint64_t version;
+            Node* nd = descend(key, version);
+            if(nd == nullptr || key < nd->key || nd->key < key) return nullptr;
+            const value_type* item = nd->item.load(std::memory_order_acquire);
+            //Once the node is unlinked the key may have been added again in another node
+            if(nd->version.load(std::memory_order_acquire) == version) return item;
+        }
+    }
+
+    //Node with *key*, or the node a new node with *key* would hang from (nullptr if the tree is
+    // empty), together with the *version* it had when the search validated it there
+    //The caller has to be pinned.
+    Node* descend(const key_type& key, std::uint64_t& version) const
+    {
+    retry:
+        Node* nd = root.load(std::memory_order_acquire);
+        if(nd == nullptr) return nullptr;
+        version = stableVersion(nd);
+        if((version & UNLINKED) != 0 || root.load(std::memory_order_acquire) != nd) goto retry;
+        for(;;)
+        {
+            if(!(key < nd->key) && !(nd->key < key)) return nd;
+            const std::atomic<Node*>& link = key < nd->key ? nd->left : nd->right;
+            Node* child = link.load(std::memory_order_acquire);
+            if(nd->version.load(std::memory_order_acquire) != version) goto retry;
+            if(child == nullptr) return nd;
+            std::uint64_t childVersion = stableVersion(child);
+            //While *child* is still there and *nd* still covers *key*, so does *child*, until its
+            // own version changes
+            if((childVersion & UNLINKED) != 0 || link.load(std::memory_order_acquire) != child ||
+                nd->version.load(std::memory_order_acquire) != version)
+                goto retry;
+            nd = child;
+            version = childVersion;
+        }
+    }
+
+    //Version of *nd* once no rotation is moving it
+    static std::uint64_t stableVersion(const Node* nd)
+    {
+        std::uint64_t version = nd->version.load(std::memory_order_acquire);
+        while((version & CHANGING) != 0)
+        {
+            std::this_thread::yield();
+            version = nd->version.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+
+    static void destroyNode(void* p)
+    {
+        delete static_cast<Node*>(p);
+    }
+
+    static Node* leftOf(const Node* nd)
+    {
+        return nd->left.load(std::memory_order_relaxed);
+    }
+
+    static Node* rightOf(const Node* nd)
+    {
+        return nd->right.load(std::memory_order_relaxed);
+    }
+
+    static int heightOf(const Node* nd)
+    {
+        return nd == nullptr ? 0 : nd->height;
+    }
+
+    static int childCount(const Node* nd)
+    {
+        return (leftOf(nd) != nullptr) + (rightOf(nd) != nullptr);
+    }
+
+    //Removed node that no longer routes searches between two subtrees
+    static bool isSpare(const Node* nd)
+    {
+        return nd != nullptr && nd->item.load(std::memory_order_relaxed) == nullptr && childCount(nd) < 2;
+    }
+
+    //Put *replacement* (can be nullptr) in place of *nd* in *nd*'s parent
+    void replaceChild(Node* nd, Node* replacement)
+    {
+        if(nd->parent == nullptr) root.store(replacement, std::memory_order_release);
+        else if(leftOf(nd->parent) == nd) nd->parent->left.store(replacement, std::memory_order_release);
+        else nd->parent->right.store(replacement, std::memory_order_release);
+        if(replacement != nullptr) replacement->parent = nd->parent;
+    }
+
+    //Take *nd*, removed and with at most one child, out of the tree and the key order and retire it
+    void unlink(Node* nd)
+    {
+        Node* child = leftOf(nd) != nullptr ? leftOf(nd) : rightOf(nd);
+        nd->version.store(nd->version.load(std::memory_order_relaxed) | UNLINKED, std::memory_order_relaxed);
+        replaceChild(nd, child);
+
+        //Iterators standing on *nd* still go on through its next link
+        Node* next = nd->next.load(std::memory_order_relaxed);
+        (nd->prev != nullptr ? nd->prev->next : first).store(next, std::memory_order_release);
+        if(next != nullptr) next->prev = nd->prev;
+        EpochManager::instance().retire(nd, destroyNode);
+    }
+
+    void updateHeight(Node* nd)
+    {
+        nd->height = 1 + std::max(heightOf(leftOf(nd)), heightOf(rightOf(nd)));
+    }
+
+    //The links change in an order that keeps every key reachable from each node that doesn't have
+    // CHANGING set: *nd* gives up *pivot*'s inner subtree, *pivot* takes over *nd*, and only then
+    // replaces it in the parent
+    Node* rotateLeft(Node* nd)
+    {
+        Node* pivot = rightOf(nd);
+        Node* inner = leftOf(pivot);
+        std::uint64_t version = nd->version.load(std::memory_order_relaxed);
+        nd->version.store(version | CHANGING, std::memory_order_relaxed);
+        nd->right.store(inner, std::memory_order_release);
+        if(inner != nullptr) inner->parent = nd;
+        pivot->left.store(nd, std::memory_order_release);
+        replaceChild(nd, pivot);
+        nd->parent = pivot;
+        nd->version.store(version + STEP, std::memory_order_release);
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
+
+    Node* rotateRight(Node* nd)
+    {
+        Node* pivot = leftOf(nd);
+        Node* inner = rightOf(pivot);
+        std::uint64_t version = nd->version.load(std::memory_order_relaxed);
+        nd->version.store(version | CHANGING, std::memory_order_relaxed);
+        nd->left.store(inner, std::memory_order_release);
+        if(inner != nullptr) inner->parent = nd;
+        pivot->right.store(nd, std::memory_order_release);
+        replaceChild(nd, pivot);
+        nd->parent = pivot;
+        nd->version.store(version + STEP, std::memory_order_release);
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
+
+    //Restore the AVL property at *nd*, whose children are already balanced (returns the new root
+    // of the subtree)
+    Node* rebalance(Node* nd)
+    {
+        updateHeight(nd);
+        int balance = heightOf(leftOf(nd)) - heightOf(rightOf(nd));
+        if(balance > 1)
+        {
+            if(heightOf(leftOf(leftOf(nd))) < heightOf(rightOf(leftOf(nd)))) rotateLeft(leftOf(nd));
+            return rotateRight(nd);
+        }
+        if(balance < -1)
+        {
+            if(heightOf(rightOf(rightOf(nd))) < heightOf(leftOf(rightOf(nd)))) rotateRight(rightOf(nd));
+            return rotateLeft(nd);
+        }
+        return nd;
+    }
+
+    //Rebalance from *nd* up to the root, stopping as soon as a subtree keeps its old height.
+    //Removed nodes on the way that were left with fewer than two children, by a removal below or
+    // by a rotation moving them down, are unlinked, so none is kept that doesn't route searches.
+    void rebalanceUpwards(Node* nd)
+    {
+        while(nd != nullptr)
+        {
+            if(isSpare(nd))
+            {
+                Node* parent = nd->parent;
+                unlink(nd);
+                nd = parent;
+                continue;
+            }
+            int oldHeight = nd->height;
+            for(;;)
+            {
+                nd = rebalance(nd);
+                //Rotations move nodes down only to the children of the new subtree root
+                Node* spare = isSpare(leftOf(nd)) ? leftOf(nd) : isSpare(rightOf(nd)) ? rightOf(nd) : nullptr;
+                if(spare == nullptr) break;
+                unlink(spare);
+            }
+            if(isSpare(nd)) continue;
+            if(nd->height == oldHeight) return;
+            nd = nd->parent;
+        }
+    }
+};
+
+template <typename KeyType, typename ValueType>
+class ConcurrentTreeMap<KeyType, ValueType>::ConstIterator
+{
+public:
+    friend class ConcurrentTreeMap<KeyType, ValueType>;
+    using reference = typename ConcurrentTreeMap::const_reference;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename ConcurrentTreeMap::value_type;
+    using pointer = const typename ConcurrentTreeMap::value_type*;
+
+private:
+    Node* current; //nullptr at the end
+    const value_type* item; //*current*'s element when the iterator got there
+    bool pinned;
+
+    //Iterator at the first element still in the map from *nd* on
+    explicit ConstIterator(Node* nd): current(nullptr), item(nullptr), pinned(true)
+    {
+        EpochManager::instance().pin();
+        moveTo(nd);
+    }
+
+public:
+    ConstIterator(): current(nullptr), item(nullptr), pinned(false)
+    {}
+
+    ConstIterator(const ConstIterator& other): current(other.current), item(other.item), pinned(other.pinned)
+    {
+        if(pinned) EpochManager::instance().pin();
+    }
+
+    ConstIterator& operator=(const ConstIterator& other)
+    {
+        if(other.pinned) EpochManager::instance().pin();
+        if(pinned) EpochManager::instance().unpin();
+        current = other.current;
+        item = other.item;
+        pinned = other.pinned;
+        return *this;
+    }
+
+    ~ConstIterator()
+    {
+        if(pinned) EpochManager::instance().unpin();
+    }
+
+    ConstIterator& operator++()
+    {
+        if(current == nullptr) throw std::out_of_range("Cannot increment iterator");
+        moveTo(current->next.load(std::memory_order_acquire));
+        return *this;
+    }
+
+    ConstIterator operator++(int)
+    {
+        ConstIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    reference operator*() const
+    {
+        if(current == nullptr) throw std::out_of_range("Iterator points at empty space after the last element");
+        return *item;
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const
+    {
+        return current == other.current;
+    }
+
+    bool operator!=(const ConstIterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Skip removed nodes; an unlinked node still links to the nodes after it
+    void moveTo(Node* nd)
+    {
+        for(; nd != nullptr; nd = nd->next.load(std::memory_order_acquire))
+        {
+            item = nd->item.load(std::memory_order_acquire);
+            if(item != nullptr) break;
+        }
+        current = nd;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_CONCURRENTTREEMAP_H */
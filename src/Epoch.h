@@ -0,0 +1,261 @@
+#ifndef AISDI_MAPS_EPOCH_H
+#define AISDI_MAPS_EPOCH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) && !defined(__SANITIZE_THREAD__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define AISDI_MAPS_MEMBARRIER 1
+#endif
+
+namespace aisdi
+{
+
+//Epoch-based reclamation for lock-free readers.
+//A reader pins the current global epoch for the duration of its access (EpochGuard). Memory
+// unlinked by a writer is retired instead of freed and is actually deleted only once the global
+// epoch has moved two steps past the epoch of its retirement; the epoch can only move when no
+// thread is pinned at an older epoch, so by then no reader can still hold a pointer to it.
+//Pinning writes only the calling thread's own record (on its own cache line), never data
+// shared with other readers. Where the kernel offers membarrier(), pinning doesn't even need a
+// memory barrier: the rare epoch advance makes every running thread execute one instead.
+class EpochManager
+{
+public:
+    using Deleter = void (*)(void*);
+
+private:
+    const static std::uint64_t QUIESCENT = 0; //epoch of a thread that is not pinned
+    const static std::size_t COLLECT_THRESHOLD = 64; //retired objects that trigger a collection
+    const static std::size_t CACHE_LINE = 64;
+
+    struct Retired
+    {
+        void* object;
+        Deleter deleter;
+        std::uint64_t epoch;
+    };
+
+    //Per-thread state; records are never freed, a record of a finished thread is reused by a new one
+    struct Record
+    {
+        std::atomic<std::uint64_t> epoch;
+        std::atomic<bool> claimed;
+        Record* next;
+        unsigned depth; //nesting of guards, touched only by the owner
+        std::vector<Retired> limbo; //retired by the owner and not deleted yet
+        char padding[CACHE_LINE]; //keeps the records of different threads off each other's cache line
+
+        Record(): epoch(QUIESCENT), claimed(true), next(nullptr), depth(0)
+        {}
+    };
+
+    //Returns the thread's record to the pool when the thread finishes
+    struct ThreadHandle
+    {
+        Record* record;
+
+        ThreadHandle(): record(nullptr)
+        {}
+
+        ~ThreadHandle()
+        {
+            if(record != nullptr) instance().releaseRecord(record);
+        }
+    };
+
+    std::atomic<std::uint64_t> globalEpoch;
+    std::atomic<Record*> records;
+    std::mutex orphanMutex;
+    std::vector<Retired> orphans; //left behind by finished threads
+    bool asymmetricFences; //pin() relies on heavyFence() in tryAdvance()
+
+    EpochManager(): globalEpoch(1), records(nullptr), asymmetricFences(registerHeavyFence())
+    {}
+
+public:
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    //The process-wide manager shared by all lock-free structures; it is never destroyed,
+    // so threads finishing during shutdown can still return their records
+    static EpochManager& instance()
+    {
+        static EpochManager* manager = new EpochManager();
+        return *manager;
+    }
+
+    void pin()
+    {
+        Record* r = threadRecord();
+        if(r->depth++ != 0) return;
+        //The announcement has to be visible before any shared pointer is read, either through
+        // a full barrier here or through the one heavyFence() forces on this thread
+        if(asymmetricFences)
+        {
+            r->epoch.store(globalEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+        else r->epoch.exchange(globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+
+    void unpin()
+    {
+        Record* r = threadRecord();
+        if(--r->depth != 0) return;
+        r->epoch.store(QUIESCENT, std::memory_order_release);
+        if(r->limbo.size() >= COLLECT_THRESHOLD) collect();
+    }
+
+    //Delete *object* with *deleter* once no pinned thread can reach it anymore
+    void retire(void* object, Deleter deleter)
+    {
+        Record* r = threadRecord();
+        r->limbo.push_back(Retired{ object, deleter, globalEpoch.load(std::memory_order_acquire) });
+        if(r->depth == 0 && r->limbo.size() >= COLLECT_THRESHOLD) collect();
+    }
+
+    template <typename T>
+    void retire(T* object)
+    {
+        retire(object, [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    //Try to advance the epoch and delete whatever this thread (or finished threads) retired
+    // long enough ago (returns number of deleted objects)
+    std::size_t collect()
+    {
+        tryAdvance();
+        std::uint64_t safe = globalEpoch.load(std::memory_order_acquire);
+        std::size_t deleted = reclaim(threadRecord()->limbo, safe);
+
+        std::vector<Retired> ready;
+        {
+            std::lock_guard<std::mutex> guard(orphanMutex);
+            if(orphans.empty()) return deleted;
+            std::vector<Retired> kept;
+            for(const Retired& item : orphans)
+                (item.epoch + 2 <= safe ? ready : kept).push_back(item);
+            orphans.swap(kept);
+        }
+        for(const Retired& item : ready)
+            item.deleter(item.object);
+        return deleted + ready.size();
+    }
+
+    //Number of objects retired by this thread and not deleted yet
+    std::size_t pending()
+    {
+        return threadRecord()->limbo.size();
+    }
+
+private:
+    Record* threadRecord()
+    {
+        static thread_local ThreadHandle handle;
+        if(handle.record == nullptr) handle.record = acquireRecord();
+        return handle.record;
+    }
+
+    Record* acquireRecord()
+    {
+        for(Record* r = records.load(std::memory_order_acquire); r != nullptr; r = r->next)
+        {
+            bool expected = false;
+            if(r->claimed.load(std::memory_order_relaxed) == false &&
+               r->claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                return r;
+        }
+
+        Record* r = new Record();
+        Record* head = records.load(std::memory_order_relaxed);
+        do r->next = head;
+        while(!records.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+        return r;
+    }
+
+    void releaseRecord(Record* r)
+    {
+        r->epoch.store(QUIESCENT, std::memory_order_release);
+        r->depth = 0;
+        if(!r->limbo.empty())
+        {
+            std::lock_guard<std::mutex> guard(orphanMutex);
+            orphans.insert(orphans.end(), r->limbo.begin(), r->limbo.end());
+            r->limbo.clear();
+        }
+        r->claimed.store(false, std::memory_order_release);
+    }
+
+    //Move the global epoch one step if every pinned thread has seen the current one
+    void tryAdvance()
+    {
+        std::uint64_t current = globalEpoch.load(std::memory_order_seq_cst);
+        if(asymmetricFences) heavyFence();
+        for(Record* r = records.load(std::memory_order_acquire); r != nullptr; r = r->next)
+        {
+            std::uint64_t e = r->epoch.load(std::memory_order_seq_cst);
+            if(e != QUIESCENT && e != current) return;
+        }
+        globalEpoch.compare_exchange_strong(current, current + 1, std::memory_order_acq_rel);
+    }
+
+    static bool registerHeavyFence()
+    {
+#if defined(AISDI_MAPS_MEMBARRIER)
+        return syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    //Full memory barrier executed by every running thread of the process
+    static void heavyFence()
+    {
+#if defined(AISDI_MAPS_MEMBARRIER)
+        syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+#endif
+    }
+
+    static std::size_t reclaim(std::vector<Retired>& limbo, std::uint64_t safe)
+    {
+        std::size_t kept = 0;
+        for(std::size_t i = 0; i < limbo.size(); ++i)
+        {
+            if(limbo[i].epoch + 2 <= safe) limbo[i].deleter(limbo[i].object);
+            else limbo[kept++] = limbo[i];
+        }
+        std::size_t deleted = limbo.size() - kept;
+        limbo.resize(kept);
+        return deleted;
+    }
+};
+
+//Keeps the calling thread pinned to the current epoch for its lifetime
+class EpochGuard
+{
+public:
+    EpochGuard()
+    {
+        EpochManager::instance().pin();
+    }
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    ~EpochGuard()
+    {
+        EpochManager::instance().unpin();
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_EPOCH_H */
@@ -0,0 +1,352 @@
+#ifndef AISDI_MAPS_FROZENTREEMAP_H
+#define AISDI_MAPS_FROZENTREEMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "TreeMap.h"
+
+namespace aisdi
+{
+
+//Allocator of arrays starting at a cache line boundary
+//The block is over-allocated by a line and the address returned by operator new is kept right
+// before the aligned start, for deallocate()
+template <typename T>
+struct CacheAlignedAllocator
+{
+    using value_type = T;
+    const static std::size_t CACHE_LINE = 64;
+
+    CacheAlignedAllocator()
+    {}
+
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        void* raw = ::operator new(n * sizeof(T) + CACHE_LINE + sizeof(void*));
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+        std::uintptr_t aligned = (start + CACHE_LINE - 1) & ~static_cast<std::uintptr_t>(CACHE_LINE - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const
+    {
+        return false;
+    }
+};
+
+//Read-only ordered map for maps that are built once and then only searched.
+//The elements form an implicit, perfectly balanced search tree stored breadth-first (the Eytzinger
+// layout): the children of position k are 2k and 2k+1, so there are no pointers to chase and the
+// top levels, visited by every lookup, share a few cache lines.
+//Keys also sit in an array of their own, which a lookup descends without branching on the
+// comparisons, prefetching the keys a few levels ahead. Iterators step between positions in key
+// order by index arithmetic alone.
+template <typename KeyType, typename ValueType>
+class FrozenTreeMap
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+    using iterator = ConstIterator;
+
+private:
+    const static size_type CACHE_LINE = 64;
+    //Descendants of position k a few levels down, k * PREFETCH_STRIDE onwards, fill two cache lines
+    // (of small keys), which are prefetched when the lookup passes k
+    const static size_type PREFETCH_STRIDE = sizeof(key_type) < CACHE_LINE ? 2 * CACHE_LINE / sizeof(key_type) : 1;
+
+    //Both indexed by position from 1, position 0 is unused; the keys start at a cache line
+    // boundary, so the descendants prefetched together are aligned the same way
+    std::vector<key_type, CacheAlignedAllocator<key_type>> keys;
+    std::vector<value_type> items;
+    size_type count;
+    unsigned fullLevels; //levels of the tree with no position missing
+
+public:
+    FrozenTreeMap(): keys(1), items(1), count(0), fullLevels(0)
+    {}
+
+    //Freeze [*first*, *last*), which has to be sorted by key; of equal keys the last one wins,
+    // throws std::invalid_argument if the keys are not sorted
+    template <typename InputIt>
+    FrozenTreeMap(InputIt first, InputIt last): FrozenTreeMap()
+    {
+        std::vector<std::pair<key_type, mapped_type>> sorted;
+        for(; first != last; ++first)
+        {
+            if(!sorted.empty() && !(sorted.back().first < first->first))
+            {
+                if(first->first < sorted.back().first) throw std::invalid_argument("Keys are not sorted");
+                sorted.back().second = first->second;
+            }
+            else sorted.emplace_back(first->first, first->second);
+        }
+        count = sorted.size();
+        while((size_type(2) << fullLevels) - 1 <= count)
+            ++fullLevels;
+
+        //Positions visited in key order get the sorted elements one by one
+        std::vector<size_type> order(count + 1);
+        size_type index = 0;
+        for(size_type position = firstPosition(); position != 0; position = nextPosition(position))
+            order[position] = index++;
+
+        keys.reserve(count + 1);
+        items.reserve(count + 1);
+        for(size_type position = 1; position <= count; ++position)
+        {
+            keys.push_back(sorted[order[position]].first);
+            items.emplace_back(sorted[order[position]].first, sorted[order[position]].second);
+        }
+    }
+
+    template <typename Allocator, typename BalancePolicy>
+    explicit FrozenTreeMap(const TreeMap<key_type, mapped_type, Allocator, BalancePolicy>& map): FrozenTreeMap(map.begin(), map.end())
+    {}
+
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
+
+    size_type getSize() const
+    {
+        return count;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const
+    {
+        size_type position = lowerBoundPosition(key);
+        if(position == 0 || key < keys[position]) throw std::out_of_range("Node with given key doesn't exist");
+        return items[position].second;
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        size_type position = lowerBoundPosition(key);
+        if(position == 0 || key < keys[position]) return cend();
+        return const_iterator(this, position);
+    }
+
+    //First element whose key is not less than *key* (end() if there is none)
+    const_iterator lowerBound(const key_type& key) const
+    {
+        return const_iterator(this, lowerBoundPosition(key));
+    }
+
+    //First element whose key is greater than *key* (end() if there is none)
+    const_iterator upperBound(const key_type& key) const
+    {
+        size_type position = lowerBoundPosition(key);
+        if(position != 0 && !(key < keys[position])) position = nextPosition(position);
+        return const_iterator(this, position);
+    }
+
+    bool operator==(const FrozenTreeMap& other) const
+    {
+        if(getSize() != other.getSize()) return false;
+        for(auto it1 = begin(), it2 = other.begin(); it1 != end(); ++it1, ++it2)
+            if(*it1 != *it2) return false;
+        return true;
+    }
+
+    bool operator!=(const FrozenTreeMap& other) const
+    {
+        return !(*this == other);
+    }
+
+    const_iterator cbegin() const
+    {
+        return const_iterator(this, firstPosition());
+    }
+
+    const_iterator cend() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator begin() const
+    {
+        return cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return cend();
+    }
+
+private:
+    //Position of the first key not less than *key*, 0 if there is none
+    //Every step goes down one level, left or right by the result of the comparison rather than by
+    // a branch. The full levels take the same number of steps for every key, so the loop's branch
+    // is always predicted and the processor can start on the next lookup early; the one step into
+    // the partly filled last level is made for every key too, going right where it runs off.
+    //After falling off the tree, the last position where the walk went left is the answer: the
+    // trailing 1 bits of the final position are the steps taken right after it, and shifting them
+    // out (and that left step) climbs back to it.
+    size_type lowerBoundPosition(const key_type& key) const
+    {
+        const key_type* k = keys.data();
+        size_type position = 1;
+        for(unsigned level = 0; level < fullLevels; ++level)
+        {
+            const char* descendants = reinterpret_cast<const char*>(k + std::min(position * PREFETCH_STRIDE, count));
+            __builtin_prefetch(descendants);
+            __builtin_prefetch(descendants + CACHE_LINE);
+            position = 2 * position + (k[position] < key);
+        }
+        bool inside = position <= count;
+        position = 2 * position + ((k[inside ? position : 0] < key) | !inside);
+        return position >> __builtin_ffsll(~static_cast<unsigned long long>(position));
+    }
+
+    //Leftmost position, 0 for an empty map
+    size_type firstPosition() const
+    {
+        size_type position = count == 0 ? 0 : 1;
+        while(position != 0 && 2 * position <= count)
+            position *= 2;
+        return position;
+    }
+
+    size_type lastPosition() const
+    {
+        size_type position = count == 0 ? 0 : 1;
+        while(position != 0 && 2 * position + 1 <= count)
+            position = 2 * position + 1;
+        return position;
+    }
+
+    //Next position in key order, 0 after the last one
+    size_type nextPosition(size_type position) const
+    {
+        if(2 * position + 1 <= count)
+        {
+            position = 2 * position + 1;
+            while(2 * position <= count)
+                position *= 2;
+            return position;
+        }
+        //Climb while coming from a right child, then once more
+        return position >> __builtin_ffsll(~static_cast<unsigned long long>(position));
+    }
+
+    //Previous position in key order, 0 before the first one
+    size_type previousPosition(size_type position) const
+    {
+        if(2 * position <= count)
+        {
+            position = 2 * position;
+            while(2 * position + 1 <= count)
+                position = 2 * position + 1;
+            return position;
+        }
+        //Climb while coming from a left child, then once more
+        return position >> __builtin_ffsll(static_cast<unsigned long long>(position));
+    }
+};
+
+template <typename KeyType, typename ValueType>
+class FrozenTreeMap<KeyType, ValueType>::ConstIterator
+{
+public:
+    friend class FrozenTreeMap<KeyType, ValueType>;
+    using reference = typename FrozenTreeMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename FrozenTreeMap::value_type;
+    using pointer = const typename FrozenTreeMap::value_type*;
+    using tree_map = FrozenTreeMap<KeyType, ValueType>;
+
+private:
+    const tree_map* parent_tree;
+    size_type position; //0 at the end
+
+public:
+    explicit ConstIterator(const tree_map* parent = nullptr, size_type p = 0): parent_tree(parent), position(p)
+    {}
+
+    ConstIterator& operator++()
+    {
+        if(position == 0) throw std::out_of_range("Cannot increment iterator");
+        position = parent_tree->nextPosition(position);
+        return *this;
+    }
+
+    ConstIterator operator++(int)
+    {
+        ConstIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    ConstIterator& operator--()
+    {
+        if(*this == parent_tree->begin()) throw std::out_of_range("Cannot decrement iterator");
+        position = position == 0 ? parent_tree->lastPosition() : parent_tree->previousPosition(position);
+        return *this;
+    }
+
+    ConstIterator operator--(int)
+    {
+        ConstIterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
+    reference operator*() const
+    {
+        if(position == 0) throw std::out_of_range("Iterator points at empty space after the last element");
+        return parent_tree->items[position];
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const
+    {
+        return position == other.position;
+    }
+
+    bool operator!=(const ConstIterator& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_FROZENTREEMAP_H */
@@ -0,0 +1,140 @@
+#ifndef AISDI_MAPS_HASH_H
+#define AISDI_MAPS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+namespace aisdi
+{
+
+//64x64 -> 128 bit multiplication folded back to 64 bits
+inline std::uint64_t mum(std::uint64_t a, std::uint64_t b)
+{
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 r = static_cast<uint128>(a) * b;
+    return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+}
+
+//Scramble all bits of *x*, every output bit depends on every input bit
+inline std::uint64_t mix64(std::uint64_t x)
+{
+    return mum(x ^ 0x2D358DCCAA6C78A5ull, 0x8BB84B93962EACC9ull);
+}
+
+//Hash of a byte string, reading it 8 bytes at a time
+inline std::uint64_t hashBytes(const void* data, std::size_t len, std::uint64_t seed = 0)
+{
+    const static std::uint64_t P0 = 0xA0761D6478BD642Full, P1 = 0xE7037ED1A0B428DBull, P2 = 0x8EBC6AF09C88C6E3ull;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::uint64_t h = seed ^ P0;
+    std::uint64_t a, b;
+    std::size_t left = len;
+
+    while(left > 16)
+    {
+        std::memcpy(&a, p, 8);
+        std::memcpy(&b, p + 8, 8);
+        h = mum(a ^ P1, b ^ h);
+        p += 16;
+        left -= 16;
+    }
+
+    if(left > 8)
+    {
+        std::memcpy(&a, p, 8);
+        std::memcpy(&b, p + left - 8, 8);
+    }
+    else if(left >= 4)
+    {
+        std::uint32_t lo, hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + left - 4, 4);
+        a = lo;
+        b = hi;
+    }
+    else if(left > 0)
+    {
+        a = (static_cast<std::uint64_t>(p[0]) << 16) | (static_cast<std::uint64_t>(p[left >> 1]) << 8) | p[left - 1];
+        b = 0;
+    }
+    else a = b = 0;
+
+    return mum(P1 ^ len, mum(a ^ P2, b ^ h));
+}
+
+//Fast, well distributed hasher for integers and strings; other types go through std::hash
+// and get their bits mixed.
+//It declares *is_avalanching*, so the maps can take the low bits of its result as they are.
+template <typename KeyType, typename = void>
+struct FastHash
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(const KeyType& key) const
+    {
+        return static_cast<std::size_t>(mix64(std::hash<KeyType>()(key)));
+    }
+};
+
+template <typename KeyType>
+struct FastHash<KeyType, typename std::enable_if<std::is_integral<KeyType>::value || std::is_enum<KeyType>::value>::type>
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(KeyType key) const
+    {
+        return static_cast<std::size_t>(mix64(static_cast<std::uint64_t>(key)));
+    }
+};
+
+template <typename CharType, typename Traits, typename Alloc>
+struct FastHash<std::basic_string<CharType, Traits, Alloc>>
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(const std::basic_string<CharType, Traits, Alloc>& key) const
+    {
+        return static_cast<std::size_t>(hashBytes(key.data(), key.size() * sizeof(CharType)));
+    }
+};
+
+template <typename>
+struct VoidType
+{
+    using type = void;
+};
+
+//True for hashers declaring *is_avalanching*, whose results are already evenly distributed over all bits
+template <typename Hash, typename = void>
+struct IsAvalanching : std::false_type
+{};
+
+template <typename Hash>
+struct IsAvalanching<Hash, typename VoidType<typename Hash::is_avalanching>::type> : std::true_type
+{};
+
+//Map a hash to [0, 2^bits) without division: an avalanching hash is simply masked, anything
+// else (like the identity std::hash for integers) goes through Fibonacci multiply-shift first,
+// which uses the well-mixed high bits of the product
+template <typename Hash>
+inline std::size_t reduceHash(std::uint64_t hash, unsigned bits)
+{
+    if(IsAvalanching<Hash>::value) return static_cast<std::size_t>(hash & ((std::uint64_t(1) << bits) - 1));
+    return static_cast<std::size_t>((hash * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+//Hash of *key* with all bits usable, for engines that slice it into several parts
+template <typename Hash, typename KeyType>
+inline std::uint64_t fullHash(const Hash& hasher, const KeyType& key)
+{
+    std::uint64_t h = hasher(key);
+    return IsAvalanching<Hash>::value ? h : mix64(h);
+}
+
+}
+
+#endif /* AISDI_MAPS_HASH_H */
@@ -2,15 +2,28 @@
 #define AISDI_MAPS_HASHMAP_H
 
 #include <cstddef>
+#include <functional>
 #include <initializer_list>
+#include <memory>
 #include <stdexcept>
-#include <functional>
 #include <utility>
 
+#include "Hash.h"
+#include "ChainedStorage.h"
+#include "RobinHoodStorage.h"
+#include "SwissStorage.h"
+#include "PoolAllocator.h"
+
 namespace aisdi
 {
 
-template <typename KeyType, typename ValueType>
+//Hash map interface over a storage engine chosen by *StoragePolicy*
+// (ChainedStorage by default, RobinHoodStorage or SwissStorage).
+//*Hash* may be FastHash, or any hasher declaring *is_avalanching* if its low bits are well mixed.
+//*Allocator* supplies the nodes or slot arrays of the engine, PoolAllocator keeps nodes together in an arena.
+template <typename KeyType, typename ValueType, typename StoragePolicy = ChainedStorage,
+          typename Hash = std::hash<KeyType>, typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
 class HashMap
 {
 public:
@@ -25,178 +38,141 @@ public:
     class Iterator;
     using iterator = Iterator;
     using const_iterator = ConstIterator;
-    class Node;
-    using node = Node;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using allocator_type = Allocator;
+    using storage_type = typename StoragePolicy::template Engine<KeyType, ValueType, Hash, KeyEqual, Allocator>;
 
 private:
-    const static size_type HASH_SIZE = 16000;
-    node* table[HASH_SIZE] = { nullptr };
-    size_type firstIndex, lastIndex; //for faster iteration
+    using position = typename storage_type::Position;
+
+    storage_type storage;
+
 public:
-    HashMap(): firstIndex(HASH_SIZE), lastIndex(HASH_SIZE)
+    HashMap()
+    {}
+
+    explicit HashMap(const Allocator& alloc): storage(alloc)
     {}
 
     HashMap(std::initializer_list<value_type> list): HashMap()
     {
+        storage.reserve(list.size());
         for(value_type v : list)
             (*this)[v.first] = v.second;
     }
 
-    HashMap(const HashMap& other): HashMap()
+    HashMap(const HashMap& other): storage(other.storage)
+    {}
+
+    HashMap(HashMap&& other) noexcept: storage(std::move(other.storage))
+    {}
+
+    HashMap& operator=(const HashMap& other)
     {
-        for(value_type v : other)
-            (*this)[v.first] = v.second;
+        storage = other.storage;
+        return *this;
     }
 
-    HashMap(HashMap&& other)
+    HashMap& operator=(HashMap&& other) noexcept
     {
-        moveMap(other);
+        storage = std::move(other.storage);
+        return *this;
     }
 
-    ~HashMap()
+    //Exchange contents with *other* in constant time (invalidates iterators of both maps)
+    void swap(HashMap& other) noexcept
     {
-        emptyMap();
+        storage.swap(other.storage);
     }
 
-private:
-    void emptyMap()
+    allocator_type get_allocator() const
     {
-        if(isEmpty()) return;
-        node *it, *temp;
-        for(size_type i=firstIndex; i<=lastIndex; ++i)
-        {
-            if(table[i] == nullptr) continue;
-            it = table[i];
-            while(it!=nullptr)
-            {
-                temp = it;
-                it = it->next;
-                delete temp;
-            }
-        }
-        firstIndex = lastIndex = HASH_SIZE;
+        return storage.get_allocator();
     }
 
-    void moveMap(HashMap& other)
+    size_type bucket_count() const
     {
-        firstIndex = other.firstIndex;
-        lastIndex = other.lastIndex;
-        for(size_type i = firstIndex; i<=lastIndex; ++i)
-        {
-            table[i] = other.table[i];
-            if(i < HASH_SIZE) other.table[i] = nullptr;
-        }
-        other.firstIndex = other.lastIndex = HASH_SIZE;
+        return storage.bucket_count();
     }
 
-public:
-    HashMap& operator=(const HashMap& other)
+    float load_factor() const
     {
-        if(&other != this)
-        {
-            emptyMap();
-            for(value_type v : other)
-                (*this)[v.first] = v.second;
-        }
-        return *this;
+        return storage.load_factor();
     }
 
-    HashMap& operator=(HashMap&& other)
+    float max_load_factor() const
     {
-        if(&other != this)
-        {
-            emptyMap();
-            moveMap(other);
-        }
-        return *this;
+        return storage.max_load_factor();
     }
 
-private:
-    //Hash function
-    size_type getIndex(const key_type& key) const
+    //Set the load factor above which the table grows; shrinking starts below a quarter of it
+    void max_load_factor(float ml)
     {
-        std::hash<key_type> temp;
-        return temp(key) % HASH_SIZE;
+        storage.max_load_factor(ml);
     }
 
-    //Get pointer to a node with given *key* in bucket number *index*
-    // (returns nullptr if the node doesn't exist)
-    node* getNode(const size_type &index, const key_type& key) const
+    //Resize the table to at least *n* buckets (and at least enough for the current size),
+    // the table won't shrink below that until the next call
+    void rehash(size_type n)
     {
-        node* temp = table[index];
-        while(temp != nullptr)
-        {
-           if(temp->val.first == key) break;
-           temp = temp->next;
-        }
-        return temp;
+        storage.rehash(n);
     }
 
-    //Insert a node with given *key* in bucket number *index*
-    // (returns pointer to the new node)
-    node* insertNode(const size_type &index, const key_type& key)
+    //Make room for *n* elements without further growth
+    void reserve(size_type n)
     {
-        node* nd = new node(key);
-        if(table[index] == nullptr) table[index] = nd;
-        else
-        {
-            node* temp = table[index];
-            while(temp->next != nullptr)
-                temp = temp->next;
-            temp->next = nd;
-        }
-        return nd;
+        storage.reserve(n);
     }
 
-public:
-    bool isEmpty() const
+    //Incremental rehashing, available with ChainedStorage only (see ChainedTable)
+    void setIncrementalRehash(bool enabled)
     {
-        return firstIndex == HASH_SIZE;
+        storage.setIncrementalRehash(enabled);
     }
 
-    mapped_type& operator[](const key_type& key)
+    bool isIncrementalRehash() const
     {
-        size_type index = getIndex(key);
-        node* temp = getNode(index, key);
+        return storage.isIncrementalRehash();
+    }
 
-        if(temp != nullptr) return temp->val.second;
+    bool isRehashing() const
+    {
+        return storage.isRehashing();
+    }
 
-        temp = insertNode(index, key);
-        if(index < firstIndex) firstIndex = index;
-        if(index > lastIndex || lastIndex == HASH_SIZE) lastIndex = index;
-        return temp->val.second;
+    bool isEmpty() const
+    {
+        return storage.size() == 0;
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        return storage.insert(key).second;
     }
 
     const mapped_type& valueOf(const key_type& key) const
     {
-        node* temp = getNode(getIndex(key), key);
-        if(temp == nullptr) throw std::out_of_range("Node with given key doesn't exist");
-        return temp->val.second;
+        position pos = storage.find(key);
+        if(pos == storage.end()) throw std::out_of_range("Node with given key doesn't exist");
+        return storage.at(pos).second;
     }
 
     mapped_type& valueOf(const key_type& key)
     {
-        node* temp = getNode(getIndex(key), key);
-        if(temp == nullptr) throw std::out_of_range("Node with given key doesn't exist");
-        return temp->val.second;
+        position pos = storage.find(key);
+        if(pos == storage.end()) throw std::out_of_range("Node with given key doesn't exist");
+        return storage.at(pos).second;
     }
 
     const_iterator find(const key_type& key) const
     {
-        size_type in = getIndex(key);
-        node* temp = table[in];
-        while(temp != nullptr && temp->val.first != key)
-            temp = temp->next;
-        return temp == nullptr ? cend() : const_iterator(this, temp, in);
+        return const_iterator(this, storage.find(key));
     }
 
     iterator find(const key_type& key)
     {
-        size_type in = getIndex(key);
-        node* temp = table[in];
-        while(temp != nullptr && temp->val.first != key)
-            temp = temp->next;
-        return temp == nullptr ? end() : iterator(const_iterator(this, temp, in));
+        return iterator(const_iterator(this, storage.find(key)));
     }
 
     void remove(const key_type& key)
@@ -208,68 +184,12 @@ public:
     void remove(const const_iterator& it)
     {
         if(it == end()) throw std::out_of_range("Node with given key doesn't exist or iterator is in end position");
-        if(table[it.index] == it.current && it.current->next == nullptr) ///Removing the only element in a bucket
-        {
-            if(it.index == firstIndex)
-            {
-                if(it.index == lastIndex) //It's the only element in the map, set the hashmap to empty state
-                    firstIndex = lastIndex = HASH_SIZE;
-                else //It's the first element in the hashmap, set firstIndex to a new position
-                {
-                    for(size_type i = it.index+1; i <= lastIndex; ++i)
-                    {
-                        if(table[i] == nullptr) continue;
-                        firstIndex = i;
-                        break;
-                    }
-                }
-            }
-            else if(it.index == lastIndex) //It's the last element in the hashmap, set lastIndex to a new position
-            {
-                for(size_type i = it.index-1; i >= firstIndex; --i)
-                {
-                    if(table[i] == nullptr) continue;
-                    lastIndex = i;
-                    break;
-                }
-            }
-
-            table[it.index] = nullptr;
-        }
-        else ///Removing one of few elements in a bucket
-        {
-            if(table[it.index] == it.current) //It's the first element in the bucket
-                table[it.index] = it.current->next;
-            else
-            {
-                node* temp = table[it.index];
-                while(temp->next != it.current)
-                    temp = temp->next;
-                if(it.current->next == nullptr) temp->next = nullptr;
-                else temp->next = it.current->next;
-            }
-        }
-
-        delete it.current;
+        storage.erase(it.pos);
     }
 
     size_type getSize() const
     {
-        if(isEmpty()) return 0;
-        size_type count = 0;
-        node* temp;
-        for(size_type i = firstIndex; i<=lastIndex; ++i)
-        {
-            if(table[i] == nullptr) continue;
-            ++count;
-            temp = table[i];
-            while(temp->next != nullptr)
-            {
-                ++count;
-                temp = temp->next;
-            }
-        }
-        return count;
+        return storage.size();
     }
 
     bool operator==(const HashMap& other) const
@@ -279,7 +199,7 @@ public:
         for(value_type v : other)
         {
             temp = find(v.first);
-            if(temp == other.end()) return false;
+            if(temp == end()) return false;
             if(temp->second != v.second) return false;
         }
         return true;
@@ -302,13 +222,12 @@ public:
 
     const_iterator cbegin() const
     {
-        if(isEmpty()) return cend();
-        else return const_iterator(this, table[firstIndex], firstIndex);
+        return const_iterator(this, storage.first());
     }
 
     const_iterator cend() const
     {
-        return const_iterator(this, nullptr, HASH_SIZE);
+        return const_iterator(this, storage.end());
     }
 
     const_iterator begin() const
@@ -322,70 +241,36 @@ public:
     }
 };
 
-template <typename KeyType, typename ValueType>
-class HashMap<KeyType, ValueType>::Node
+template <typename KeyType, typename ValueType, typename StoragePolicy, typename Hash, typename KeyEqual, typename Allocator>
+class HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>::ConstIterator
 {
 public:
-    friend class HashMap<KeyType, ValueType>;
-    using key_type = KeyType;
-    using mapped_type = ValueType;
-    using value_type = std::pair<const key_type, mapped_type>;
-    using size_type = std::size_t;
-    using node = Node;
-
-private:
-    value_type val;
-    node *next;
-
-public:
-    Node(): next(nullptr)
-    {}
-
-    Node(value_type v, node* n = nullptr) : val(v), next(n)
-    {}
-
-    Node(key_type key, node* n = nullptr): val(value_type(key, mapped_type())), next(n)
-    {}
-
-    ~Node()
-    {
-        next = nullptr;
-    }
-};
-
-template <typename KeyType, typename ValueType>
-class HashMap<KeyType, ValueType>::ConstIterator
-{
-public:
-    friend class HashMap<KeyType, ValueType>;
+    friend class HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>;
     using reference = typename HashMap::const_reference;
     using iterator_category = std::bidirectional_iterator_tag;
     using value_type = typename HashMap::value_type;
     using pointer = const typename HashMap::value_type*;
-    using node = HashMap<KeyType, ValueType>::Node;
-    using hash_map = HashMap<KeyType, ValueType>;
+    using hash_map = HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>;
 
 private:
-    node* current;
-    size_type index;
+    position pos;
     const hash_map* parent_map;
 
 public:
-    ConstIterator(const hash_map* p): current(nullptr), index(HASH_SIZE), parent_map(p)
+    ConstIterator(const hash_map* p): pos(p->storage.end()), parent_map(p)
     {}
 
-    explicit ConstIterator(const hash_map* p, node* n, size_type in): current(n), index(in), parent_map(p)
+    explicit ConstIterator(const hash_map* p, const position& ps): pos(ps), parent_map(p)
     {}
 
-    ConstIterator(const ConstIterator& other): current(other.current), index(other.index), parent_map(other.parent_map)
+    ConstIterator(const ConstIterator& other): pos(other.pos), parent_map(other.parent_map)
     {}
 
     ConstIterator& operator=(const ConstIterator &other)
     {
         if(&other != this)
         {
-            current = other.current;
-            index = other.index;
+            pos = other.pos;
             parent_map = other.parent_map;
         }
         return *this;
@@ -393,22 +278,8 @@ public:
 
     ConstIterator& operator++()
     {
-        if(index == HASH_SIZE) throw std::out_of_range("Cannot increment iterator");
-        if(current->next != nullptr)
-        {
-            current = current->next;
-            return *this;
-        }
-        node* temp = nullptr;
-        for(size_type i = index+1; i <= parent_map->lastIndex; ++i)
-        {
-            if(parent_map->table[i] == nullptr) continue;
-            temp = parent_map->table[i];
-            index = i;
-            break;
-        }
-        if(temp == nullptr) index = HASH_SIZE;
-        current = temp;
+        if(pos == parent_map->storage.end()) throw std::out_of_range("Cannot increment iterator");
+        parent_map->storage.next(pos);
         return *this;
     }
 
@@ -422,34 +293,7 @@ public:
     ConstIterator& operator--()
     {
         if(*this == parent_map->begin()) throw std::out_of_range("Cannot decrement iterator");
-        node* temp;
-        if(index == HASH_SIZE)
-        {
-            index = parent_map->lastIndex;
-            temp = parent_map->table[index];
-            while(temp->next != nullptr)
-                temp = temp->next;
-            current = temp;
-            return *this;
-        }
-        if(parent_map->table[index] != current)
-        {
-            temp = parent_map->table[index];
-            while(temp->next != current)
-                temp = temp->next;
-            current = temp;
-            return *this;
-        }
-        for(size_type i = index-1; i >= parent_map->firstIndex; --i)
-        {
-            if(parent_map->table[i] == nullptr) continue;
-            temp = parent_map->table[i];
-            while(temp->next != nullptr)
-                temp = temp->next;
-            current = temp;
-            index = i;
-            break;
-        }
+        parent_map->storage.prev(pos);
         return *this;
     }
 
@@ -462,8 +306,8 @@ public:
 
     reference operator*() const
     {
-        if(index == HASH_SIZE) throw std::out_of_range("Iterator points at empty space after the last element");
-        return current->val;
+        if(pos == parent_map->storage.end()) throw std::out_of_range("Iterator points at empty space after the last element");
+        return parent_map->storage.at(pos);
     }
 
     pointer operator->() const
@@ -473,9 +317,7 @@ public:
 
     bool operator==(const ConstIterator& other) const
     {
-        if(parent_map != other.parent_map) return false;
-        //Check if *current* pointers match and if both iterators are or aren't in the end position simultaneously
-        return current == other.current && (index != HASH_SIZE)^(other.index == HASH_SIZE);
+        return parent_map == other.parent_map && pos == other.pos;
     }
 
     bool operator!=(const ConstIterator& other) const
@@ -484,8 +326,8 @@ public:
     }
 };
 
-template <typename KeyType, typename ValueType>
-class HashMap<KeyType, ValueType>::Iterator : public HashMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename StoragePolicy, typename Hash, typename KeyEqual, typename Allocator>
+class HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>::Iterator : public HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>::ConstIterator
 {
 public:
     using reference = typename HashMap::reference;
@@ -536,6 +378,24 @@ public:
     }
 };
 
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+using RobinHoodHashMap = HashMap<KeyType, ValueType, RobinHoodStorage, Hash, KeyEqual, Allocator>;
+
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+using SwissHashMap = HashMap<KeyType, ValueType, SwissStorage, Hash, KeyEqual, Allocator>;
+
+template <typename KeyType, typename ValueType, typename StoragePolicy, typename Hash, typename KeyEqual,
+          typename Allocator>
+void swap(HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>& a,
+          HashMap<KeyType, ValueType, StoragePolicy, Hash, KeyEqual, Allocator>& b) noexcept
+{
+    a.swap(b);
+}
+
 }
 
 #endif /* AISDI_MAPS_HASHMAP_H */
@@ -0,0 +1,69 @@
+#ifndef AISDI_MAPS_PARALLELSORT_H
+#define AISDI_MAPS_PARALLELSORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace aisdi
+{
+
+//Sort [*first*, *last*) like std::stable_sort, on up to *threads* threads.
+//The range is cut into one part per thread and each part is sorted on its own thread, then
+// neighbouring parts are merged pairwise (the merges of one round in parallel too) until one is left.
+//*comp* must not throw, an exception escaping a worker thread ends the program.
+template <typename RandomIt, typename Compare>
+void parallelStableSort(RandomIt first, RandomIt last, Compare comp,
+    unsigned threads = std::thread::hardware_concurrency())
+{
+    const std::size_t MIN_PART_SIZE = 1 << 14; //smaller parts aren't worth a thread
+    std::size_t size = last - first;
+    std::size_t parts = std::min<std::size_t>(threads, size / MIN_PART_SIZE);
+    if(parts <= 1)
+    {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+
+    std::vector<RandomIt> bounds;
+    for(std::size_t i = 0; i < parts; ++i)
+        bounds.push_back(first + size * i / parts);
+    bounds.push_back(last);
+
+    std::vector<std::thread> workers;
+    for(std::size_t i = 0; i + 1 < bounds.size(); ++i)
+        workers.emplace_back([&bounds, &comp, i]() { std::stable_sort(bounds[i], bounds[i + 1], comp); });
+    for(std::thread& worker : workers)
+        worker.join();
+
+    while(bounds.size() > 2)
+    {
+        workers.clear();
+        std::vector<RandomIt> merged;
+        std::size_t i = 0;
+        for(; i + 2 < bounds.size(); i += 2)
+        {
+            RandomIt begin = bounds[i], middle = bounds[i + 1], end = bounds[i + 2];
+            workers.emplace_back([begin, middle, end, &comp]() { std::inplace_merge(begin, middle, end, comp); });
+            merged.push_back(begin);
+        }
+        for(; i < bounds.size(); ++i) //an odd part out waits for the next round
+            merged.push_back(bounds[i]);
+        for(std::thread& worker : workers)
+            worker.join();
+        bounds.swap(merged);
+    }
+}
+
+template <typename RandomIt>
+void parallelStableSort(RandomIt first, RandomIt last)
+{
+    parallelStableSort(first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+}
+
+}
+
+#endif /* AISDI_MAPS_PARALLELSORT_H */
@@ -0,0 +1,497 @@
+#ifndef AISDI_MAPS_PERSISTENTTREEMAP_H
+#define AISDI_MAPS_PERSISTENTTREEMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace aisdi
+{
+
+//Ordered map whose copies share nodes, so that snapshot() and the copy constructor are O(1).
+//It is an AVL tree whose nodes count the parents (or maps, for a root) pointing at them. A change
+// copies the nodes on its way down that are shared with another map and changes only its own
+// copies (path copying), so every other map keeps seeing the old version: an update after a
+// snapshot allocates O(log n) nodes and the next updates along the same paths none. A node is
+// freed when the last map using it lets go.
+//The nodes have no parent pointers, since a shared node has more than one parent; iterators keep
+// the path from the root instead.
+//The counts are atomic, so maps sharing nodes can be used, and destroyed, on different threads; one
+// map is no more thread-safe than TreeMap. A reference returned by operator[] is valid only until
+// the next snapshot or change of the map.
+template <typename KeyType, typename ValueType>
+class PersistentTreeMap
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+    class ConstIterator;
+    using const_iterator = ConstIterator;
+    using iterator = ConstIterator;
+
+private:
+    struct Node
+    {
+        std::atomic<size_type> references;
+        Node *left, *right;
+        int height; //of the subtree rooted here
+        value_type val;
+
+        //Takes a reference to both children, once *val* has been copied
+        Node(const value_type& v, Node* l, Node* r): references(1), left(l), right(r),
+            height(1 + std::max(heightOf(l), heightOf(r))), val(v)
+        {
+            share(l);
+            share(r);
+        }
+    };
+
+    Node* root;
+    size_type count;
+
+public:
+    PersistentTreeMap(): root(nullptr), count(0)
+    {}
+
+    PersistentTreeMap(std::initializer_list<value_type> list): PersistentTreeMap()
+    {
+        for(const value_type& item : list)
+            (*this)[item.first] = item.second;
+    }
+
+    PersistentTreeMap(const PersistentTreeMap& other): root(share(other.root)), count(other.count)
+    {}
+
+    PersistentTreeMap(PersistentTreeMap&& other): root(other.root), count(other.count)
+    {
+        other.root = nullptr;
+        other.count = 0;
+    }
+
+    ~PersistentTreeMap()
+    {
+        release(root);
+    }
+
+    PersistentTreeMap& operator=(const PersistentTreeMap& other)
+    {
+        Node* old = root;
+        root = share(other.root);
+        count = other.count;
+        release(old);
+        return *this;
+    }
+
+    PersistentTreeMap& operator=(PersistentTreeMap&& other)
+    {
+        if(&other != this)
+        {
+            release(root);
+            root = other.root;
+            count = other.count;
+            other.root = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    //The map as it is now, unaffected by later changes of either map
+    PersistentTreeMap snapshot() const
+    {
+        return *this;
+    }
+
+    bool isEmpty() const
+    {
+        return count == 0;
+    }
+
+    size_type getSize() const
+    {
+        return count;
+    }
+
+    int getHeight() const
+    {
+        return heightOf(root);
+    }
+
+    mapped_type& operator[](const key_type& key)
+    {
+        return insert(root, key)->val.second;
+    }
+
+    const mapped_type& valueOf(const key_type& key) const
+    {
+        const Node* nd = root;
+        while(nd != nullptr && (key < nd->val.first || nd->val.first < key))
+            nd = key < nd->val.first ? nd->left : nd->right;
+        if(nd == nullptr) throw std::out_of_range("Node with given key doesn't exist");
+        return nd->val.second;
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const_iterator it = bound(key, false);
+        if(it != cend() && key < it->first) return cend();
+        return it;
+    }
+
+    //First element whose key is not less than *key* (end() if there is none)
+    const_iterator lowerBound(const key_type& key) const
+    {
+        return bound(key, false);
+    }
+
+    //First element whose key is greater than *key* (end() if there is none)
+    const_iterator upperBound(const key_type& key) const
+    {
+        return bound(key, true);
+    }
+
+    void remove(const key_type& key)
+    {
+        //Checked first, so that removing a missing key copies nothing
+        if(find(key) == cend()) throw std::out_of_range("Node with given key doesn't exist");
+        erase(root, key);
+    }
+
+    void remove(const const_iterator& it)
+    {
+        if(it == cend()) throw std::out_of_range("Node with given key doesn't exist or iterator is in end position");
+        remove(it->first);
+    }
+
+    bool operator==(const PersistentTreeMap& other) const
+    {
+        if(count != other.count) return false;
+        if(root == other.root) return true;
+        for(const_iterator a = cbegin(), b = other.cbegin(); a != cend(); ++a, ++b)
+            if(*a != *b) return false;
+        return true;
+    }
+
+    bool operator!=(const PersistentTreeMap& other) const
+    {
+        return !(*this == other);
+    }
+
+    const_iterator cbegin() const
+    {
+        const_iterator it(root);
+        for(const Node* nd = root; nd != nullptr; nd = nd->left)
+            it.path[it.depth++] = nd;
+        return it;
+    }
+
+    const_iterator cend() const
+    {
+        return const_iterator(root);
+    }
+
+    const_iterator begin() const
+    {
+        return cbegin();
+    }
+
+    const_iterator end() const
+    {
+        return cend();
+    }
+
+private:
+    static int heightOf(const Node* nd)
+    {
+        return nd == nullptr ? 0 : nd->height;
+    }
+
+    static Node* share(Node* nd)
+    {
+        if(nd != nullptr) nd->references.fetch_add(1, std::memory_order_relaxed);
+        return nd;
+    }
+
+    //Drop a reference to *nd*, freeing it, and what only it used, once nobody uses it
+    static void release(Node* nd)
+    {
+        if(nd == nullptr || nd->references.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        release(nd->left);
+        release(nd->right);
+        delete nd;
+    }
+
+    //Make *link*, the only link to it from this map, point to a node no other map uses
+    //Going down from the root, the first shared node is copied, which makes its children shared,
+    // so a count of 1 really means the node is this map's alone.
+    static void own(Node*& link)
+    {
+        if(link->references.load(std::memory_order_acquire) == 1) return;
+        Node* copy = new Node(link->val, link->left, link->right);
+        release(link);
+        link = copy;
+    }
+
+    //Iterator at the first element whose key is not less than (or, if *strict*, greater than) *key*
+    //The path to it is a prefix of the search path for *key*.
+    const_iterator bound(const key_type& key, bool strict) const
+    {
+        const_iterator it(root);
+        int found = 0;
+        for(const Node* nd = root; nd != nullptr; )
+        {
+            it.path[it.depth++] = nd;
+            if(strict ? key < nd->val.first : !(nd->val.first < key))
+            {
+                found = it.depth;
+                nd = nd->left;
+            }
+            else nd = nd->right;
+        }
+        it.depth = found;
+        return it;
+    }
+
+    //Node with *key* in the subtree at *link*, added if it isn't there; the path to it is copied
+    // where shared and rebalanced
+    Node* insert(Node*& link, const key_type& key)
+    {
+        if(link == nullptr)
+        {
+            link = new Node(value_type(key, mapped_type()), nullptr, nullptr);
+            ++count;
+            return link;
+        }
+        own(link);
+        Node* found;
+        if(key < link->val.first) found = insert(link->left, key);
+        else if(link->val.first < key) found = insert(link->right, key);
+        else return link;
+        link = rebalance(link);
+        return found;
+    }
+
+    //Remove *key*, which has to be in the subtree at *link*
+    void erase(Node*& link, const key_type& key)
+    {
+        own(link);
+        Node* nd = link;
+        if(key < nd->val.first) erase(nd->left, key);
+        else if(nd->val.first < key) erase(nd->right, key);
+        else
+        {
+            if(nd->left == nullptr || nd->right == nullptr)
+            {
+                link = nd->left != nullptr ? nd->left : nd->right;
+                nd->left = nd->right = nullptr;
+                release(nd);
+                --count;
+                return;
+            }
+            //Put the in-order successor, unshared on the way, in place of *nd*
+            Node* successor = takeFirst(nd->right);
+            successor->left = nd->left;
+            successor->right = nd->right;
+            nd->left = nd->right = nullptr;
+            release(nd);
+            --count;
+            nd = successor;
+        }
+        link = rebalance(nd);
+    }
+
+    //Unlink the first node of the nonempty subtree at *link* and return it, unshared and childless
+    Node* takeFirst(Node*& link)
+    {
+        own(link);
+        Node* nd = link;
+        if(nd->left != nullptr)
+        {
+            Node* first = takeFirst(nd->left);
+            link = rebalance(nd);
+            return first;
+        }
+        link = nd->right;
+        nd->right = nullptr;
+        return nd;
+    }
+
+    static void updateHeight(Node* nd)
+    {
+        nd->height = 1 + std::max(heightOf(nd->left), heightOf(nd->right));
+    }
+
+    //Rotations take a node of this map's own and copy the pivot if it is shared; the other nodes
+    // only move, so no count changes
+    static Node* rotateLeft(Node* nd)
+    {
+        own(nd->right);
+        Node* pivot = nd->right;
+        nd->right = pivot->left;
+        pivot->left = nd;
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
+
+    static Node* rotateRight(Node* nd)
+    {
+        own(nd->left);
+        Node* pivot = nd->left;
+        nd->left = pivot->right;
+        pivot->right = nd;
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
+
+    //Restore the AVL property at *nd*, this map's own node whose children are already balanced
+    // (returns the new root of the subtree)
+    static Node* rebalance(Node* nd)
+    {
+        updateHeight(nd);
+        int balance = heightOf(nd->left) - heightOf(nd->right);
+        if(balance > 1)
+        {
+            if(heightOf(nd->left->left) < heightOf(nd->left->right))
+            {
+                own(nd->left);
+                nd->left = rotateLeft(nd->left);
+            }
+            return rotateRight(nd);
+        }
+        if(balance < -1)
+        {
+            if(heightOf(nd->right->right) < heightOf(nd->right->left))
+            {
+                own(nd->right);
+                nd->right = rotateRight(nd->right);
+            }
+            return rotateLeft(nd);
+        }
+        return nd;
+    }
+};
+
+template <typename KeyType, typename ValueType>
+class PersistentTreeMap<KeyType, ValueType>::ConstIterator
+{
+public:
+    friend class PersistentTreeMap<KeyType, ValueType>;
+    using reference = typename PersistentTreeMap::const_reference;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename PersistentTreeMap::value_type;
+    using pointer = const typename PersistentTreeMap::value_type*;
+
+private:
+    //An AVL tree this tall would have more than 10^13 nodes
+    const static int MAX_HEIGHT = 64;
+
+    const Node* root;
+    const Node* path[MAX_HEIGHT]; //from the root to the current node, empty at the end
+    int depth;
+
+    explicit ConstIterator(const Node* r): root(r), depth(0)
+    {}
+
+public:
+    ConstIterator(): ConstIterator(nullptr)
+    {}
+
+    ConstIterator(const ConstIterator& other): root(other.root), depth(other.depth)
+    {
+        std::copy(other.path, other.path + depth, path);
+    }
+
+    ConstIterator& operator=(const ConstIterator& other)
+    {
+        root = other.root;
+        depth = other.depth;
+        std::copy(other.path, other.path + depth, path);
+        return *this;
+    }
+
+    ConstIterator& operator++()
+    {
+        if(depth == 0) throw std::out_of_range("Cannot increment iterator");
+        const Node* nd = path[depth - 1];
+        if(nd->right != nullptr)
+        {
+            for(nd = nd->right; nd != nullptr; nd = nd->left)
+                path[depth++] = nd;
+            return *this;
+        }
+        //Up to the first ancestor reached from its left subtree
+        do
+            nd = path[--depth];
+        while(depth > 0 && path[depth - 1]->right == nd);
+        return *this;
+    }
+
+    ConstIterator operator++(int)
+    {
+        ConstIterator temp = *this;
+        ++(*this);
+        return temp;
+    }
+
+    ConstIterator& operator--()
+    {
+        if(depth == 0 && root == nullptr) throw std::out_of_range("Cannot decrement iterator");
+        const Node* nd = depth == 0 ? root : path[depth - 1]->left;
+        if(nd != nullptr)
+        {
+            for(; nd != nullptr; nd = nd->right)
+                path[depth++] = nd;
+            return *this;
+        }
+        int up = depth;
+        do
+            nd = path[--up];
+        while(up > 0 && path[up - 1]->left == nd);
+        if(up == 0) throw std::out_of_range("Cannot decrement iterator");
+        depth = up;
+        return *this;
+    }
+
+    ConstIterator operator--(int)
+    {
+        ConstIterator temp = *this;
+        --(*this);
+        return temp;
+    }
+
+    reference operator*() const
+    {
+        if(depth == 0) throw std::out_of_range("Iterator points at empty space after the last element");
+        return path[depth - 1]->val;
+    }
+
+    pointer operator->() const
+    {
+        return &this->operator*();
+    }
+
+    bool operator==(const ConstIterator& other) const
+    {
+        return (depth == 0 ? nullptr : path[depth - 1]) == (other.depth == 0 ? nullptr : other.path[other.depth - 1]);
+    }
+
+    bool operator!=(const ConstIterator& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_PERSISTENTTREEMAP_H */
@@ -0,0 +1,316 @@
+#ifndef AISDI_MAPS_POOLALLOCATOR_H
+#define AISDI_MAPS_POOLALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace aisdi
+{
+
+//Arena handing out small blocks carved from large slabs.
+//Freed blocks go to a free list of their size class (multiples of ALIGNMENT) and are reused
+// by later allocations of that class; blocks above MAX_CLASS_SIZE get their own slab.
+//releaseAll() gives back every slab at once, whatever is still allocated from them.
+class NodePool
+{
+public:
+    const static std::size_t ALIGNMENT = 16;
+    const static std::size_t MAX_CLASS_SIZE = 512;
+    const static std::size_t MIN_SLAB_SIZE = 4 * 1024;
+    const static std::size_t MAX_SLAB_SIZE = 256 * 1024;
+    const static std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+private:
+    const static std::size_t CLASS_COUNT = MAX_CLASS_SIZE / ALIGNMENT;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    //Header at the start of every slab, padded so the blocks behind it stay aligned
+    struct alignas(ALIGNMENT) Slab
+    {
+        Slab *prev, *next;
+        std::size_t size; //bytes including the header
+        bool mapped; //comes from mapHugePages() rather than malloc
+    };
+
+    FreeBlock* freeLists[CLASS_COUNT];
+    Slab* slabs; //slabs being carved into blocks, the newest first
+    Slab* largeBlocks; //single-block slabs for blocks above MAX_CLASS_SIZE
+    char *cursor, *limit; //unused part of the newest slab
+    std::size_t nextSlabSize;
+    bool hugePages;
+
+public:
+    //With *useHugePages* slabs are 2 MB, aligned to 2 MB and advised to be backed by
+    // transparent huge pages (on Linux; elsewhere it only makes the slabs bigger)
+    explicit NodePool(bool useHugePages = false): slabs(nullptr), largeBlocks(nullptr), cursor(nullptr),
+        limit(nullptr), nextSlabSize(useHugePages ? HUGE_PAGE_SIZE : MIN_SLAB_SIZE), hugePages(useHugePages)
+    {
+        for(FreeBlock*& list : freeLists)
+            list = nullptr;
+    }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    ~NodePool()
+    {
+        releaseAll();
+    }
+
+    void* allocate(std::size_t bytes)
+    {
+        if(bytes > MAX_CLASS_SIZE) return allocateLarge(bytes);
+
+        std::size_t sizeClass = classOf(bytes);
+        FreeBlock* block = freeLists[sizeClass];
+        if(block != nullptr)
+        {
+            freeLists[sizeClass] = block->next;
+            return block;
+        }
+
+        std::size_t rounded = (sizeClass + 1) * ALIGNMENT;
+        if(static_cast<std::size_t>(limit - cursor) < rounded) addSlab();
+        void* result = cursor;
+        cursor += rounded;
+        return result;
+    }
+
+    void deallocate(void* p, std::size_t bytes) noexcept
+    {
+        if(bytes > MAX_CLASS_SIZE)
+        {
+            deallocateLarge(p);
+            return;
+        }
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        std::size_t sizeClass = classOf(bytes);
+        block->next = freeLists[sizeClass];
+        freeLists[sizeClass] = block;
+    }
+
+    //Give back all slabs, invalidating every block allocated so far
+    void releaseAll() noexcept
+    {
+        freeSlabList(slabs);
+        freeSlabList(largeBlocks);
+        for(FreeBlock*& list : freeLists)
+            list = nullptr;
+        cursor = limit = nullptr;
+        nextSlabSize = hugePages ? HUGE_PAGE_SIZE : MIN_SLAB_SIZE;
+    }
+
+private:
+    static std::size_t classOf(std::size_t bytes)
+    {
+        return bytes == 0 ? 0 : (bytes - 1) / ALIGNMENT;
+    }
+
+    //Start carving a new slab, each one twice the size of the previous up to MAX_SLAB_SIZE
+    void addSlab()
+    {
+        Slab* slab = newSlab(nextSlabSize, hugePages);
+        link(slabs, slab);
+        cursor = reinterpret_cast<char*>(slab + 1);
+        limit = reinterpret_cast<char*>(slab) + slab->size;
+        if(!hugePages && nextSlabSize < MAX_SLAB_SIZE) nextSlabSize <<= 1;
+    }
+
+    void* allocateLarge(std::size_t bytes)
+    {
+        //Only blocks of at least a huge page are worth mapping separately
+        Slab* slab = newSlab(sizeof(Slab) + bytes, hugePages && bytes >= HUGE_PAGE_SIZE);
+        link(largeBlocks, slab);
+        return slab + 1;
+    }
+
+    void deallocateLarge(void* p) noexcept
+    {
+        Slab* slab = static_cast<Slab*>(p) - 1;
+        if(slab->prev != nullptr) slab->prev->next = slab->next;
+        else largeBlocks = slab->next;
+        if(slab->next != nullptr) slab->next->prev = slab->prev;
+        freeSlab(slab);
+    }
+
+    static void link(Slab*& list, Slab* slab)
+    {
+        slab->prev = nullptr;
+        slab->next = list;
+        if(list != nullptr) list->prev = slab;
+        list = slab;
+    }
+
+    static void freeSlabList(Slab*& list) noexcept
+    {
+        while(list != nullptr)
+        {
+            Slab* temp = list;
+            list = list->next;
+            freeSlab(temp);
+        }
+    }
+
+    static Slab* newSlab(std::size_t size, bool huge)
+    {
+        void* memory;
+#if defined(__linux__)
+        if(huge) size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        memory = huge ? mapHugePages(size) : std::malloc(size);
+#else
+        huge = false;
+        memory = std::malloc(size);
+#endif
+        if(memory == nullptr) throw std::bad_alloc();
+        Slab* slab = static_cast<Slab*>(memory);
+        slab->size = size;
+        slab->mapped = huge;
+        return slab;
+    }
+
+    static void freeSlab(Slab* slab) noexcept
+    {
+#if defined(__linux__)
+        if(slab->mapped)
+        {
+            munmap(slab, slab->size);
+            return;
+        }
+#endif
+        std::free(slab);
+    }
+
+#if defined(__linux__)
+    //Map *size* bytes aligned to HUGE_PAGE_SIZE (over-map and trim), so the kernel can back
+    // them with whole huge pages (returns nullptr on failure)
+    static void* mapHugePages(std::size_t size)
+    {
+        std::size_t mapped = size + HUGE_PAGE_SIZE;
+        void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw == MAP_FAILED) return nullptr;
+
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+        std::uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~static_cast<std::uintptr_t>(HUGE_PAGE_SIZE - 1);
+        if(aligned != start) munmap(raw, aligned - start);
+        std::size_t tail = start + mapped - (aligned + size);
+        if(tail != 0) munmap(reinterpret_cast<void*>(aligned + size), tail);
+#if defined(MADV_HUGEPAGE)
+        madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE);
+#endif
+        return reinterpret_cast<void*>(aligned);
+    }
+#endif
+};
+
+//Standard allocator drawing from a NodePool.
+//A default-constructed allocator creates its own pool; all copies and rebound copies share it
+// and compare equal, so maps built from one allocator can hand nodes to each other. A map copy
+// gets a fresh pool, while moves and swaps take the pool along with the elements, so a map
+// normally is the only user of its pool and can throw all its nodes away at once with releaseAll().
+//Moving an allocator copies it, so that no allocator is ever left without a pool.
+template <typename T, bool HugePages = false>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U, HugePages>;
+    };
+
+    template <typename, bool>
+    friend class PoolAllocator;
+
+private:
+    std::shared_ptr<NodePool> pool;
+
+public:
+    PoolAllocator(): pool(std::make_shared<NodePool>(HugePages))
+    {}
+
+    PoolAllocator(const PoolAllocator&) = default;
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, HugePages>& other) noexcept: pool(other.pool)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        static_assert(alignof(T) <= NodePool::ALIGNMENT, "Type is over-aligned for NodePool");
+        return static_cast<T*>(pool->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        pool->deallocate(p, n * sizeof(T));
+    }
+
+    //Give back every block of the pool at once, only if no other allocator shares it
+    // (returns false if the blocks have to be deallocated one by one)
+    bool releaseAll() noexcept
+    {
+        if(pool.use_count() != 1) return false;
+        pool->releaseAll();
+        return true;
+    }
+
+    PoolAllocator select_on_container_copy_construction() const
+    {
+        return PoolAllocator();
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, HugePages>& other) const noexcept
+    {
+        return pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, HugePages>& other) const noexcept
+    {
+        return pool != other.pool;
+    }
+};
+
+template <typename Alloc>
+auto releaseArenaImpl(Alloc& alloc, int) -> decltype(alloc.releaseAll())
+{
+    return alloc.releaseAll();
+}
+
+template <typename Alloc>
+bool releaseArenaImpl(Alloc&, long)
+{
+    return false;
+}
+
+//Release every block of *alloc* at once if it is an arena allocator (with a releaseAll() member)
+// that allows it (returns false if the blocks have to be deallocated one by one)
+template <typename Alloc>
+bool releaseArena(Alloc& alloc)
+{
+    return releaseArenaImpl(alloc, 0);
+}
+
+}
+
+#endif /* AISDI_MAPS_POOLALLOCATOR_H */
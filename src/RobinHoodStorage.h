@@ -0,0 +1,473 @@
+#ifndef AISDI_MAPS_ROBINHOODSTORAGE_H
+#define AISDI_MAPS_ROBINHOODSTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Hash.h"
+
+namespace aisdi
+{
+
+//HashMap storage engine: open addressing with Robin Hood linear probing.
+//Elements live directly in one flat slot array (no per-element allocation); each slot keeps
+// its probe distance next to the element, so a successful lookup usually touches one cache line.
+//Removal uses backward shifting, so no tombstones are needed.
+//The slot array is allocated by the first insertion (from *Allocator*), an empty table owns no memory.
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class RobinHoodTable
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using allocator_type = Allocator;
+
+    struct Position;
+
+private:
+    const static size_type MIN_CAPACITY = 16;
+    const static size_type END_INDEX = static_cast<size_type>(-1); //index of the end position
+    const static std::int32_t EMPTY = -1;
+
+    struct Slot
+    {
+        std::int32_t distance; //how far the element is from its home slot, EMPTY if there is none
+        typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type storage;
+
+        value_type& val()
+        {
+            return *reinterpret_cast<value_type*>(&storage);
+        }
+    };
+
+    using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using SlotTraits = std::allocator_traits<SlotAllocator>;
+
+    Slot* slots;
+    size_type capacity; //always a power of two
+    size_type count;
+    size_type minCapacity; //lower bound for shrinking, raised by reserve() and rehash()
+    float maxLoadFactor;
+    unsigned bits; //log2(capacity)
+    Hash hasher;
+    KeyEqual keyEqual;
+    SlotAllocator slotAllocator;
+
+public:
+    RobinHoodTable(): RobinHoodTable(Allocator())
+    {}
+
+    explicit RobinHoodTable(const Allocator& alloc) noexcept: slots(nullptr), capacity(0), count(0),
+        minCapacity(MIN_CAPACITY), maxLoadFactor(0.8f), bits(0), slotAllocator(alloc)
+    {}
+
+    RobinHoodTable(const RobinHoodTable& other):
+        RobinHoodTable(Allocator(SlotTraits::select_on_container_copy_construction(other.slotAllocator)))
+    {
+        copyTable(other);
+    }
+
+    RobinHoodTable(RobinHoodTable&& other) noexcept: RobinHoodTable(Allocator(other.slotAllocator))
+    {
+        swap(other);
+    }
+
+    ~RobinHoodTable()
+    {
+        clear();
+        freeSlots(slots, capacity);
+    }
+
+    RobinHoodTable& operator=(const RobinHoodTable& other)
+    {
+        if(&other != this)
+        {
+            clear();
+            copyTable(other);
+        }
+        return *this;
+    }
+
+    RobinHoodTable& operator=(RobinHoodTable&& other) noexcept
+    {
+        if(&other != this)
+        {
+            RobinHoodTable tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+private:
+    void allocateSlots(size_type n)
+    {
+        slots = SlotTraits::allocate(slotAllocator, n);
+        for(size_type i = 0; i < n; ++i)
+            slots[i].distance = EMPTY;
+        capacity = n;
+        bits = 0;
+        while((size_type(1) << bits) < n) ++bits;
+    }
+
+    void freeSlots(Slot* s, size_type n)
+    {
+        if(s != nullptr) SlotTraits::deallocate(slotAllocator, s, n);
+    }
+
+    //Fill this (empty) table with copies of *other*'s elements
+    void copyTable(const RobinHoodTable& other)
+    {
+        maxLoadFactor = other.maxLoadFactor;
+        hasher = other.hasher;
+        keyEqual = other.keyEqual;
+        if(other.count == 0) return;
+        reserve(other.count);
+        for(size_type i = 0; i < other.capacity; ++i)
+            if(other.slots[i].distance != EMPTY)
+                insert(other.slots[i].val().first).second = other.slots[i].val().second;
+    }
+
+
+    //See reduceHash(), identity hashes still get spread over the whole table
+    size_type homeSlot(const key_type& key) const
+    {
+        return reduceHash<Hash>(hasher(key), bits);
+    }
+
+    size_type nextSlot(size_type index) const
+    {
+        return (index + 1) & (capacity - 1);
+    }
+
+    //Smallest capacity keeping *n* elements within the max load factor
+    size_type capacityFor(size_type n) const
+    {
+        return static_cast<size_type>(n / maxLoadFactor) + (n != 0);
+    }
+
+    //Capacities are powers of two, no smaller than MIN_CAPACITY
+    static size_type roundUpCapacity(size_type n)
+    {
+        size_type c = MIN_CAPACITY;
+        while(c < n) c <<= 1;
+        return c;
+    }
+
+    //Move every element into a freshly allocated slot array of *newCapacity* slots.
+    //All or nothing: if a key copy throws, the old array stays as it was. Values are moved only
+    // when that can't throw, and moved back then.
+    void rehashTo(size_type newCapacity)
+    {
+        const bool moveValues = std::is_nothrow_move_constructible<mapped_type>::value &&
+            std::is_nothrow_move_assignable<mapped_type>::value;
+        Slot* oldSlots = slots;
+        size_type oldCapacity = capacity;
+        unsigned oldBits = bits;
+        allocateSlots(newCapacity);
+        try
+        {
+            for(size_type i = 0; i < oldCapacity; ++i)
+            {
+                if(oldSlots[i].distance == EMPTY) continue;
+                value_type& item = oldSlots[i].val();
+                if(moveValues) place(item.first, std::move(item.second));
+                else place(item.first, item.second);
+            }
+        }
+        catch(...)
+        {
+            Slot* newSlots = slots;
+            size_type newSlotCount = capacity;
+            slots = oldSlots;
+            capacity = oldCapacity;
+            bits = oldBits;
+            for(size_type i = 0; i < newSlotCount; ++i)
+            {
+                if(newSlots[i].distance == EMPTY) continue;
+                if(moveValues) slots[lookup(newSlots[i].val().first)].val().second = std::move(newSlots[i].val().second);
+                newSlots[i].val().~value_type();
+            }
+            freeSlots(newSlots, newSlotCount);
+            throw;
+        }
+
+        for(size_type i = 0; i < oldCapacity; ++i)
+            if(oldSlots[i].distance != EMPTY) oldSlots[i].val().~value_type();
+        freeSlots(oldSlots, oldCapacity);
+    }
+
+    //Put an element of *key* (known to be absent) and *value* into the table, displacing richer
+    // elements (returns index of its slot). If a constructor throws, the table stays as it was.
+    template <typename V>
+    size_type place(const key_type& key, V&& value)
+    {
+        size_type index = homeSlot(key);
+        std::int32_t distance = 0;
+        while(slots[index].distance >= distance)
+        {
+            index = nextSlot(index);
+            ++distance;
+        }
+        if(slots[index].distance != EMPTY) displaceFrom(index);
+        try
+        {
+            new (&slots[index].storage) value_type(key, std::forward<V>(value));
+        }
+        catch(...)
+        {
+            closeGap(index);
+            throw;
+        }
+        slots[index].distance = distance;
+        return index;
+    }
+
+    //Free slot *index* by shifting its element and the ones after it, up to the next empty slot,
+    // one slot further (each stays in probe order, one step farther from home).
+    //If a move throws, the elements already shifted are moved back.
+    void displaceFrom(size_type index)
+    {
+        size_type hole = index;
+        while(slots[hole].distance != EMPTY)
+            hole = nextSlot(hole);
+        while(hole != index)
+        {
+            size_type previous = (hole - 1) & (capacity - 1);
+            try
+            {
+                new (&slots[hole].storage) value_type(std::move(slots[previous].val()));
+            }
+            catch(...)
+            {
+                closeGap(hole);
+                throw;
+            }
+            slots[hole].distance = slots[previous].distance + 1;
+            slots[previous].val().~value_type();
+            slots[previous].distance = EMPTY;
+            hole = previous;
+        }
+    }
+
+    //Fill the empty slot *index* by moving the displaced elements following it one slot back
+    void closeGap(size_type index)
+    {
+        size_type following = nextSlot(index);
+        while(slots[following].distance > 0)
+        {
+            new (&slots[index].storage) value_type(std::move(slots[following].val()));
+            slots[index].distance = slots[following].distance - 1;
+            slots[following].val().~value_type();
+            slots[following].distance = EMPTY;
+            index = following;
+            following = nextSlot(following);
+        }
+    }
+
+    //Index of the slot holding *key* or END_INDEX
+    size_type lookup(const key_type& key) const
+    {
+        if(count == 0) return END_INDEX;
+        size_type index = homeSlot(key);
+        for(std::int32_t distance = 0; slots[index].distance >= distance; ++distance)
+        {
+            if(keyEqual(slots[index].val().first, key)) return index;
+            index = nextSlot(index);
+        }
+        return END_INDEX;
+    }
+
+    void shrinkIfNeeded()
+    {
+        size_type half = capacity >> 1;
+        if(half >= minCapacity && count < half * maxLoadFactor / 2)
+            rehashTo(half);
+    }
+
+public:
+    //Exchange contents with *other*, only pointers and counters are swapped
+    void swap(RobinHoodTable& other) noexcept
+    {
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        std::swap(minCapacity, other.minCapacity);
+        std::swap(maxLoadFactor, other.maxLoadFactor);
+        std::swap(bits, other.bits);
+        std::swap(hasher, other.hasher);
+        std::swap(keyEqual, other.keyEqual);
+        std::swap(slotAllocator, other.slotAllocator);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(slotAllocator);
+    }
+
+    void clear()
+    {
+        if(count != 0)
+        {
+            for(size_type i = 0; i < capacity; ++i)
+            {
+                if(slots[i].distance == EMPTY) continue;
+                slots[i].val().~value_type();
+                slots[i].distance = EMPTY;
+            }
+        }
+        count = 0;
+    }
+
+    size_type size() const
+    {
+        return count;
+    }
+
+    size_type bucket_count() const
+    {
+        return capacity;
+    }
+
+    float load_factor() const
+    {
+        return capacity == 0 ? 0.0f : static_cast<float>(count) / capacity;
+    }
+
+    float max_load_factor() const
+    {
+        return maxLoadFactor;
+    }
+
+    //Set the load factor above which the table grows; shrinking starts below a quarter of it
+    void max_load_factor(float ml)
+    {
+        if(!(ml > 0.0f) || ml >= 1.0f) throw std::invalid_argument("Max load factor must be in (0, 1)");
+        maxLoadFactor = ml;
+        if(count > capacity * maxLoadFactor) rehash(0);
+    }
+
+    //Resize the table to at least *n* slots (and at least enough for the current size),
+    // the table won't shrink below that until the next call
+    void rehash(size_type n)
+    {
+        size_type needed = capacityFor(count);
+        if(n < needed) n = needed;
+        minCapacity = roundUpCapacity(n);
+        if(minCapacity != capacity) rehashTo(minCapacity);
+    }
+
+    //Make room for *n* elements without further growth
+    void reserve(size_type n)
+    {
+        rehash(capacityFor(n));
+    }
+
+    Position find(const key_type& key) const
+    {
+        return Position(lookup(key));
+    }
+
+    //Return the element with given *key*, default-constructing its value if it doesn't exist
+    value_type& insert(const key_type& key)
+    {
+        size_type index = lookup(key);
+        if(index != END_INDEX) return slots[index].val();
+
+        if(count + 1 > capacity * maxLoadFactor) rehashTo(std::max(minCapacity, capacity << 1));
+
+        index = place(key, mapped_type());
+        ++count;
+        return slots[index].val();
+    }
+
+    //Remove the element and shift the following displaced elements one slot back
+    void erase(const Position& pos)
+    {
+        slots[pos.index].val().~value_type();
+        slots[pos.index].distance = EMPTY;
+        closeGap(pos.index);
+        --count;
+        shrinkIfNeeded();
+    }
+
+    value_type& at(const Position& pos) const
+    {
+        return slots[pos.index].val();
+    }
+
+    Position first() const
+    {
+        if(count == 0) return end();
+        size_type index = 0;
+        while(slots[index].distance == EMPTY) ++index;
+        return Position(index);
+    }
+
+    Position end() const
+    {
+        return Position(END_INDEX);
+    }
+
+    //Move *pos* to the next element or to the end position
+    void next(Position& pos) const
+    {
+        for(size_type i = pos.index+1; i < capacity; ++i)
+        {
+            if(slots[i].distance == EMPTY) continue;
+            pos.index = i;
+            return;
+        }
+        pos.index = END_INDEX;
+    }
+
+    //Move *pos* to the previous element, it must not be the first one
+    void prev(Position& pos) const
+    {
+        size_type i = pos.index == END_INDEX ? capacity : pos.index;
+        do --i;
+        while(slots[i].distance == EMPTY);
+        pos.index = i;
+    }
+};
+
+//Element position: index of its slot
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+struct RobinHoodTable<KeyType, ValueType, Hash, KeyEqual, Allocator>::Position
+{
+    size_type index;
+
+    explicit Position(size_type in): index(in)
+    {}
+
+    bool operator==(const Position& other) const
+    {
+        return index == other.index;
+    }
+
+    bool operator!=(const Position& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+//HashMap storage policy selecting RobinHoodTable
+struct RobinHoodStorage
+{
+    template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+    using Engine = RobinHoodTable<KeyType, ValueType, Hash, KeyEqual, Allocator>;
+};
+
+}
+
+#endif /* AISDI_MAPS_ROBINHOODSTORAGE_H */
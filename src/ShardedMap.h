@@ -0,0 +1,341 @@
+#ifndef AISDI_MAPS_SHARDEDMAP_H
+#define AISDI_MAPS_SHARDEDMAP_H
+
+#include <cstddef>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Hash.h"
+
+namespace aisdi
+{
+
+//Reader-writer lock: any number of readers or a single writer.
+//A waiting writer stops new readers from coming in, so a stream of readers can't starve it.
+class ReadWriteLock
+{
+    std::mutex mutex;
+    std::condition_variable canWrite, canRead;
+    std::size_t readers;
+    std::size_t waitingWriters;
+    bool writing;
+
+public:
+    ReadWriteLock(): readers(0), waitingWriters(0), writing(false)
+    {}
+
+    ReadWriteLock(const ReadWriteLock&) = delete;
+    ReadWriteLock& operator=(const ReadWriteLock&) = delete;
+
+    void lock()
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        ++waitingWriters;
+        canWrite.wait(guard, [this] { return !writing && readers == 0; });
+        --waitingWriters;
+        writing = true;
+    }
+
+    void unlock()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            writing = false;
+        }
+        canWrite.notify_one();
+        canRead.notify_all();
+    }
+
+    void lock_shared()
+    {
+        std::unique_lock<std::mutex> guard(mutex);
+        canRead.wait(guard, [this] { return !writing && waitingWriters == 0; });
+        ++readers;
+    }
+
+    void unlock_shared()
+    {
+        bool last;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            last = --readers == 0;
+        }
+        if(last) canWrite.notify_one();
+    }
+};
+
+//Scoped shared (reader) ownership of a ReadWriteLock, std::lock_guard covers the exclusive one
+class SharedLockGuard
+{
+    ReadWriteLock& lock;
+
+public:
+    explicit SharedLockGuard(ReadWriteLock& l): lock(l)
+    {
+        lock.lock_shared();
+    }
+
+    SharedLockGuard(const SharedLockGuard&) = delete;
+    SharedLockGuard& operator=(const SharedLockGuard&) = delete;
+
+    ~SharedLockGuard()
+    {
+        lock.unlock_shared();
+    }
+};
+
+//Whether const lookups of *MapT* change it, as those of a splay tree do
+template <typename MapT, typename = void>
+struct LookupsChangeMap : std::false_type
+{};
+
+template <typename MapT>
+struct LookupsChangeMap<MapT, typename std::enable_if<MapT::balance_policy::splay>::type> : std::true_type
+{};
+
+//Thread-safe map made of *ShardCount* independent maps of type *MapT* (HashMap, TreeMap, ...),
+// each behind its own reader-writer lock; a key always goes to the shard picked by its hash.
+//Lookups take a shard's lock shared and use only const operations of *MapT*, updates take it
+// exclusively, so maps whose lookups change them (splay trees) are rejected.
+//Values are returned by copy, since a reference would outlive the lock.
+template <typename MapT, std::size_t ShardCount = 16, typename ShardHash = std::hash<typename MapT::key_type>>
+class ShardedMap
+{
+public:
+    using map_type = MapT;
+    using key_type = typename MapT::key_type;
+    using mapped_type = typename MapT::mapped_type;
+    using value_type = typename MapT::value_type;
+    using size_type = std::size_t;
+
+    static_assert(ShardCount > 0, "ShardedMap needs at least one shard");
+    static_assert(!LookupsChangeMap<MapT>::value, "Shared lookups need a map whose const lookups don't change it");
+
+private:
+    const static std::size_t CACHE_LINE = 64;
+
+    struct Shard
+    {
+        mutable ReadWriteLock lock;
+        MapT map;
+        char padding[CACHE_LINE]; //keeps the locks of neighbouring shards off each other's cache line
+    };
+
+    Shard shards[ShardCount];
+    ShardHash hasher;
+
+    //Shared ownership of every shard's lock, taken in shard order
+    class AllShardsLock
+    {
+        const Shard* shards;
+
+    public:
+        explicit AllShardsLock(const Shard* s): shards(s)
+        {
+            for(size_type i = 0; i < ShardCount; ++i)
+                shards[i].lock.lock_shared();
+        }
+
+        ~AllShardsLock()
+        {
+            for(size_type i = 0; i < ShardCount; ++i)
+                shards[i].lock.unlock_shared();
+        }
+    };
+
+public:
+    ShardedMap()
+    {}
+
+    ShardedMap(std::initializer_list<std::pair<key_type, mapped_type>> list): ShardedMap()
+    {
+        insertBatch(list.begin(), list.end());
+    }
+
+    ShardedMap(const ShardedMap&) = delete;
+    ShardedMap& operator=(const ShardedMap&) = delete;
+
+    static constexpr size_type shardCount()
+    {
+        return ShardCount;
+    }
+
+    //Index of the shard holding *key*; the hash is mixed first, so the shard doesn't depend
+    // on the same bits the shard's own map uses to pick a bucket
+    size_type shardOf(const key_type& key) const
+    {
+        return static_cast<size_type>(mix64(hasher(key)) % ShardCount);
+    }
+
+    //Set the value of *key*, adding it if it doesn't exist
+    void insert(const key_type& key, const mapped_type& value)
+    {
+        Shard& shard = shards[shardOf(key)];
+        std::lock_guard<ReadWriteLock> guard(shard.lock);
+        shard.map[key] = value;
+    }
+
+    //Call *f* on the value of *key* (default-constructed if it doesn't exist) under the shard's
+    // exclusive lock, so read-modify-write updates are atomic
+    template <typename Function>
+    void update(const key_type& key, Function f)
+    {
+        Shard& shard = shards[shardOf(key)];
+        std::lock_guard<ReadWriteLock> guard(shard.lock);
+        f(shard.map[key]);
+    }
+
+    //Remove *key* (returns false if it didn't exist)
+    bool remove(const key_type& key)
+    {
+        Shard& shard = shards[shardOf(key)];
+        std::lock_guard<ReadWriteLock> guard(shard.lock);
+        auto it = shard.map.find(key);
+        if(it == shard.map.end()) return false;
+        shard.map.remove(it);
+        return true;
+    }
+
+    //Copy the value of *key* to *value* (returns false if the key doesn't exist)
+    bool find(const key_type& key, mapped_type& value) const
+    {
+        const Shard& shard = shards[shardOf(key)];
+        SharedLockGuard guard(shard.lock);
+        const MapT& map = shard.map;
+        auto it = map.find(key);
+        if(it == map.end()) return false;
+        value = it->second;
+        return true;
+    }
+
+    bool contains(const key_type& key) const
+    {
+        const Shard& shard = shards[shardOf(key)];
+        SharedLockGuard guard(shard.lock);
+        const MapT& map = shard.map;
+        return map.find(key) != map.end();
+    }
+
+    mapped_type valueOf(const key_type& key) const
+    {
+        const Shard& shard = shards[shardOf(key)];
+        SharedLockGuard guard(shard.lock);
+        return shard.map.valueOf(key);
+    }
+
+    //Sum of the shard sizes, each read under its own lock
+    size_type getSize() const
+    {
+        size_type size = 0;
+        for(const Shard& shard : shards)
+        {
+            SharedLockGuard guard(shard.lock);
+            size += shard.map.getSize();
+        }
+        return size;
+    }
+
+    bool isEmpty() const
+    {
+        return getSize() == 0;
+    }
+
+    //Set the values of all (key, value) pairs in [first, last), taking each shard's lock only once
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last)
+    {
+        std::vector<std::vector<std::pair<key_type, mapped_type>>> perShard(ShardCount);
+        for(; first != last; ++first)
+            perShard[shardOf(first->first)].emplace_back(first->first, first->second);
+
+        for(size_type i = 0; i < ShardCount; ++i)
+        {
+            if(perShard[i].empty()) continue;
+            std::lock_guard<ReadWriteLock> guard(shards[i].lock);
+            for(const auto& item : perShard[i])
+                shards[i].map[item.first] = item.second;
+        }
+    }
+
+    //Remove all keys in [first, last), taking each shard's lock only once (returns number of removed keys)
+    template <typename InputIt>
+    size_type removeBatch(InputIt first, InputIt last)
+    {
+        std::vector<std::vector<key_type>> perShard(ShardCount);
+        for(; first != last; ++first)
+            perShard[shardOf(*first)].push_back(*first);
+
+        size_type removed = 0;
+        for(size_type i = 0; i < ShardCount; ++i)
+        {
+            if(perShard[i].empty()) continue;
+            std::lock_guard<ReadWriteLock> guard(shards[i].lock);
+            MapT& map = shards[i].map;
+            for(const key_type& key : perShard[i])
+            {
+                auto it = map.find(key);
+                if(it == map.end()) continue;
+                map.remove(it);
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+    //Run *f* on shard number *index*'s map under its exclusive lock
+    template <typename Function>
+    void withShard(size_type index, Function f)
+    {
+        if(index >= ShardCount) throw std::out_of_range("Shard index out of range");
+        std::lock_guard<ReadWriteLock> guard(shards[index].lock);
+        f(shards[index].map);
+    }
+
+    //Run *f* on shard number *index*'s map (as const) under its shared lock
+    template <typename Function>
+    void withShard(size_type index, Function f) const
+    {
+        if(index >= ShardCount) throw std::out_of_range("Shard index out of range");
+        SharedLockGuard guard(shards[index].lock);
+        f(static_cast<const MapT&>(shards[index].map));
+    }
+
+    //Call *f* on every element, one shard at a time under that shard's shared lock:
+    // each shard is seen in a consistent state, but shards are visited at different moments
+    template <typename Function>
+    void forEach(Function f) const
+    {
+        for(const Shard& shard : shards)
+        {
+            SharedLockGuard guard(shard.lock);
+            const MapT& map = shard.map;
+            for(auto it = map.begin(); it != map.end(); ++it)
+                f(*it);
+        }
+    }
+
+    //Copy of all elements taken at a single moment: every shard stays read-locked until
+    // the last one is copied (locks are taken in shard order, writers hold only one, so no deadlock)
+    std::vector<std::pair<key_type, mapped_type>> snapshot() const
+    {
+        AllShardsLock guard(shards);
+        std::vector<std::pair<key_type, mapped_type>> result;
+        for(const Shard& shard : shards)
+        {
+            const MapT& map = shard.map;
+            for(auto it = map.begin(); it != map.end(); ++it)
+                result.emplace_back(it->first, it->second);
+        }
+        return result;
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_SHARDEDMAP_H */
@@ -0,0 +1,607 @@
+#ifndef AISDI_MAPS_SWISSSTORAGE_H
+#define AISDI_MAPS_SWISSSTORAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Hash.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace aisdi
+{
+
+//Group of consecutive control bytes matched at once: 32 with AVX2, 16 with SSE2,
+// otherwise 8 using 64-bit SWAR arithmetic.
+//A control byte is EMPTY, DELETED or, for a full slot, the 7 low bits of its element's hash.
+//Matching returns a mask with one bit per matching slot, see lowest()/leadingSlots().
+class SwissGroup
+{
+public:
+    using ctrl_t = std::int8_t;
+    const static ctrl_t EMPTY = -128;
+    const static ctrl_t DELETED = -2;
+
+#if defined(__AVX2__)
+    using mask_type = std::uint32_t;
+    const static std::size_t WIDTH = 32;
+
+private:
+    __m256i ctrl;
+
+public:
+    explicit SwissGroup(const ctrl_t* p): ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))
+    {}
+
+    mask_type match(ctrl_t h2) const
+    {
+        return static_cast<mask_type>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(h2), ctrl)));
+    }
+
+    mask_type matchEmpty() const
+    {
+        return match(EMPTY);
+    }
+
+    //EMPTY and DELETED are the only negative control bytes
+    mask_type matchEmptyOrDeleted() const
+    {
+        return static_cast<mask_type>(_mm256_movemask_epi8(ctrl));
+    }
+
+    static std::size_t leadingSlots(mask_type m)
+    {
+        return __builtin_clz(m);
+    }
+
+    static std::size_t lowest(mask_type m)
+    {
+        return __builtin_ctz(m);
+    }
+
+#elif defined(__SSE2__)
+    using mask_type = std::uint32_t;
+    const static std::size_t WIDTH = 16;
+
+private:
+    __m128i ctrl;
+
+public:
+    explicit SwissGroup(const ctrl_t* p): ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))
+    {}
+
+    mask_type match(ctrl_t h2) const
+    {
+        return static_cast<mask_type>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+    }
+
+    mask_type matchEmpty() const
+    {
+        return match(EMPTY);
+    }
+
+    //EMPTY and DELETED are the only negative control bytes
+    mask_type matchEmptyOrDeleted() const
+    {
+        return static_cast<mask_type>(_mm_movemask_epi8(ctrl));
+    }
+
+    static std::size_t leadingSlots(mask_type m)
+    {
+        return __builtin_clz(m) - 16;
+    }
+
+    static std::size_t lowest(mask_type m)
+    {
+        return __builtin_ctz(m);
+    }
+
+#else
+    using mask_type = std::uint64_t;
+    const static std::size_t WIDTH = 8;
+
+private:
+    const static std::uint64_t LSBS = 0x0101010101010101ull;
+    const static std::uint64_t MSBS = 0x8080808080808080ull;
+    std::uint64_t ctrl;
+
+public:
+    explicit SwissGroup(const ctrl_t* p)
+    {
+        std::memcpy(&ctrl, p, sizeof(ctrl));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        ctrl = __builtin_bswap64(ctrl);
+#endif
+    }
+
+    //May report false positives next to a real match, the keys are compared anyway
+    mask_type match(ctrl_t h2) const
+    {
+        std::uint64_t x = ctrl ^ (LSBS * static_cast<std::uint8_t>(h2));
+        return (x - LSBS) & ~x & MSBS;
+    }
+
+    //EMPTY is the only control byte with bit 7 set and bit 1 clear
+    mask_type matchEmpty() const
+    {
+        return ctrl & (~ctrl << 6) & MSBS;
+    }
+
+    mask_type matchEmptyOrDeleted() const
+    {
+        return ctrl & MSBS;
+    }
+
+    static std::size_t leadingSlots(mask_type m)
+    {
+        return __builtin_clzll(m) >> 3;
+    }
+
+    static std::size_t lowest(mask_type m)
+    {
+        return __builtin_ctzll(m) >> 3;
+    }
+#endif
+};
+
+//HashMap storage engine in the style of Swiss tables: a separate array of control bytes holding
+// 7 bits of each element's hash is probed a whole SwissGroup at a time, so most negative
+// lookups are decided without reading any key.
+//Both arrays are allocated by the first insertion (from *Allocator*), an empty table owns no memory.
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>,
+          typename KeyEqual = std::equal_to<KeyType>,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+class SwissTable
+{
+public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using size_type = std::size_t;
+    using allocator_type = Allocator;
+
+    struct Position;
+
+private:
+    using ctrl_t = SwissGroup::ctrl_t;
+    using mask_type = SwissGroup::mask_type;
+    const static size_type WIDTH = SwissGroup::WIDTH;
+    const static size_type MIN_CAPACITY = WIDTH < 16 ? 16 : WIDTH;
+    const static size_type END_INDEX = static_cast<size_type>(-1); //index of the end position
+
+    using Slot = typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type;
+
+    using CtrlAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<ctrl_t>;
+    using CtrlTraits = std::allocator_traits<CtrlAllocator>;
+    using SlotAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using SlotTraits = std::allocator_traits<SlotAllocator>;
+
+    ctrl_t* ctrl; //capacity + WIDTH bytes, the last WIDTH mirror the first so groups can wrap around
+    Slot* slots;
+    size_type capacity; //always a power of two, at least WIDTH
+    size_type count;
+    size_type tombstones; //DELETED control bytes
+    size_type minCapacity; //lower bound for shrinking, raised by reserve() and rehash()
+    float maxLoadFactor;
+    Hash hasher;
+    KeyEqual keyEqual;
+    CtrlAllocator ctrlAllocator;
+    SlotAllocator slotAllocator;
+
+public:
+    SwissTable(): SwissTable(Allocator())
+    {}
+
+    explicit SwissTable(const Allocator& alloc) noexcept: ctrl(nullptr), slots(nullptr), capacity(0), count(0),
+        tombstones(0), minCapacity(MIN_CAPACITY), maxLoadFactor(0.875f), ctrlAllocator(alloc), slotAllocator(alloc)
+    {}
+
+    SwissTable(const SwissTable& other):
+        SwissTable(Allocator(SlotTraits::select_on_container_copy_construction(other.slotAllocator)))
+    {
+        copyTable(other);
+    }
+
+    SwissTable(SwissTable&& other) noexcept: SwissTable(Allocator(other.slotAllocator))
+    {
+        swap(other);
+    }
+
+    ~SwissTable()
+    {
+        clear();
+        freeArrays(ctrl, slots, capacity);
+    }
+
+    SwissTable& operator=(const SwissTable& other)
+    {
+        if(&other != this)
+        {
+            clear();
+            copyTable(other);
+        }
+        return *this;
+    }
+
+    SwissTable& operator=(SwissTable&& other) noexcept
+    {
+        if(&other != this)
+        {
+            SwissTable tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+private:
+    void allocateSlots(size_type n)
+    {
+        ctrl_t* newCtrl = CtrlTraits::allocate(ctrlAllocator, n + WIDTH);
+        try
+        {
+            slots = SlotTraits::allocate(slotAllocator, n);
+        }
+        catch(...)
+        {
+            CtrlTraits::deallocate(ctrlAllocator, newCtrl, n + WIDTH);
+            throw;
+        }
+        ctrl = newCtrl;
+        std::memset(ctrl, static_cast<std::uint8_t>(SwissGroup::EMPTY), n + WIDTH);
+        capacity = n;
+        tombstones = 0;
+    }
+
+    void freeArrays(ctrl_t* c, Slot* s, size_type n)
+    {
+        if(c == nullptr) return;
+        CtrlTraits::deallocate(ctrlAllocator, c, n + WIDTH);
+        SlotTraits::deallocate(slotAllocator, s, n);
+    }
+
+    //Fill this (empty) table with copies of *other*'s elements
+    void copyTable(const SwissTable& other)
+    {
+        maxLoadFactor = other.maxLoadFactor;
+        hasher = other.hasher;
+        keyEqual = other.keyEqual;
+        if(other.count == 0) return;
+        reserve(other.count);
+        for(size_type i = 0; i < other.capacity; ++i)
+            if(other.ctrl[i] >= 0)
+                insert(other.val(i).first).second = other.val(i).second;
+    }
+
+
+    value_type& val(size_type index) const
+    {
+        return *reinterpret_cast<value_type*>(&slots[index]);
+    }
+
+    //Both the 7-bit fragment and the probe start are cut out of this hash, see fullHash()
+    std::uint64_t hashOf(const key_type& key) const
+    {
+        return fullHash(hasher, key);
+    }
+
+    static ctrl_t fragment(std::uint64_t hash)
+    {
+        return static_cast<ctrl_t>(hash & 0x7F);
+    }
+
+    //Set control byte *index* and its mirror past the end of the array
+    void setCtrl(size_type index, ctrl_t c)
+    {
+        ctrl[index] = c;
+        if(index < WIDTH) ctrl[capacity + index] = c;
+    }
+
+    //Index of the slot holding *key* or END_INDEX
+    size_type lookup(const key_type& key) const
+    {
+        if(count == 0) return END_INDEX;
+        std::uint64_t hash = hashOf(key);
+        ctrl_t h2 = fragment(hash);
+        size_type mask = capacity - 1;
+        size_type pos = static_cast<size_type>(hash >> 7) & mask;
+        for(size_type step = WIDTH; ; step += WIDTH)
+        {
+            SwissGroup group(ctrl + pos);
+            for(mask_type m = group.match(h2); m != 0; m &= m - 1)
+            {
+                size_type index = (pos + SwissGroup::lowest(m)) & mask;
+                if(keyEqual(val(index).first, key)) return index;
+            }
+            if(group.matchEmpty() != 0) return END_INDEX;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    //First EMPTY or DELETED slot on the probe sequence of *hash*
+    size_type findFreeSlot(std::uint64_t hash) const
+    {
+        size_type mask = capacity - 1;
+        size_type pos = static_cast<size_type>(hash >> 7) & mask;
+        for(size_type step = WIDTH; ; step += WIDTH)
+        {
+            mask_type m = SwissGroup(ctrl + pos).matchEmptyOrDeleted();
+            if(m != 0) return (pos + SwissGroup::lowest(m)) & mask;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    //Smallest capacity keeping *n* elements within the max load factor
+    size_type capacityFor(size_type n) const
+    {
+        return static_cast<size_type>(n / maxLoadFactor) + (n != 0);
+    }
+
+    //Capacities are powers of two, no smaller than MIN_CAPACITY
+    static size_type roundUpCapacity(size_type n)
+    {
+        size_type c = MIN_CAPACITY;
+        while(c < n) c <<= 1;
+        return c;
+    }
+
+    //Move every element into freshly allocated arrays of *newCapacity* slots (drops tombstones).
+    //All or nothing: if a key copy throws, the old arrays stay as they were. Values are moved only
+    // when that can't throw, and moved back then.
+    void rehashTo(size_type newCapacity)
+    {
+        const bool moveValues = std::is_nothrow_move_constructible<mapped_type>::value &&
+            std::is_nothrow_move_assignable<mapped_type>::value;
+        ctrl_t* oldCtrl = ctrl;
+        Slot* oldSlots = slots;
+        size_type oldCapacity = capacity;
+        size_type oldTombstones = tombstones;
+        allocateSlots(newCapacity);
+        try
+        {
+            for(size_type i = 0; i < oldCapacity; ++i)
+            {
+                if(oldCtrl[i] < 0) continue;
+                value_type& v = *reinterpret_cast<value_type*>(&oldSlots[i]);
+                std::uint64_t hash = hashOf(v.first);
+                size_type index = findFreeSlot(hash);
+                if(moveValues) new (&slots[index]) value_type(v.first, std::move(v.second));
+                else new (&slots[index]) value_type(v.first, v.second);
+                setCtrl(index, fragment(hash));
+            }
+        }
+        catch(...)
+        {
+            ctrl_t* newCtrl = ctrl;
+            Slot* newSlots = slots;
+            size_type newSlotCount = capacity;
+            ctrl = oldCtrl;
+            slots = oldSlots;
+            capacity = oldCapacity;
+            tombstones = oldTombstones;
+            for(size_type i = 0; i < newSlotCount; ++i)
+            {
+                if(newCtrl[i] < 0) continue;
+                value_type& v = *reinterpret_cast<value_type*>(&newSlots[i]);
+                if(moveValues) val(lookup(v.first)).second = std::move(v.second);
+                v.~value_type();
+            }
+            freeArrays(newCtrl, newSlots, newSlotCount);
+            throw;
+        }
+
+        for(size_type i = 0; i < oldCapacity; ++i)
+            if(oldCtrl[i] >= 0) reinterpret_cast<value_type*>(&oldSlots[i])->~value_type();
+        freeArrays(oldCtrl, oldSlots, oldCapacity);
+    }
+
+    void shrinkIfNeeded()
+    {
+        size_type half = capacity >> 1;
+        if(half >= minCapacity && count < half * maxLoadFactor / 2)
+            rehashTo(half);
+    }
+
+public:
+    //Exchange contents with *other*, only pointers and counters are swapped
+    void swap(SwissTable& other) noexcept
+    {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        std::swap(tombstones, other.tombstones);
+        std::swap(minCapacity, other.minCapacity);
+        std::swap(maxLoadFactor, other.maxLoadFactor);
+        std::swap(hasher, other.hasher);
+        std::swap(keyEqual, other.keyEqual);
+        std::swap(ctrlAllocator, other.ctrlAllocator);
+        std::swap(slotAllocator, other.slotAllocator);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(slotAllocator);
+    }
+
+    void clear()
+    {
+        if(count != 0)
+        {
+            for(size_type i = 0; i < capacity; ++i)
+                if(ctrl[i] >= 0) val(i).~value_type();
+        }
+        if(count != 0 || tombstones != 0)
+            std::memset(ctrl, static_cast<std::uint8_t>(SwissGroup::EMPTY), capacity + WIDTH);
+        count = tombstones = 0;
+    }
+
+    size_type size() const
+    {
+        return count;
+    }
+
+    size_type bucket_count() const
+    {
+        return capacity;
+    }
+
+    float load_factor() const
+    {
+        return capacity == 0 ? 0.0f : static_cast<float>(count) / capacity;
+    }
+
+    float max_load_factor() const
+    {
+        return maxLoadFactor;
+    }
+
+    //Set the load factor above which the table grows; shrinking starts below a quarter of it
+    void max_load_factor(float ml)
+    {
+        if(!(ml > 0.0f) || ml >= 1.0f) throw std::invalid_argument("Max load factor must be in (0, 1)");
+        maxLoadFactor = ml;
+        if(count > capacity * maxLoadFactor) rehash(0);
+    }
+
+    //Resize the table to at least *n* slots (and at least enough for the current size),
+    // the table won't shrink below that until the next call
+    void rehash(size_type n)
+    {
+        size_type needed = capacityFor(count);
+        if(n < needed) n = needed;
+        minCapacity = roundUpCapacity(n);
+        if(minCapacity != capacity) rehashTo(minCapacity);
+    }
+
+    //Make room for *n* elements without further growth
+    void reserve(size_type n)
+    {
+        rehash(capacityFor(n));
+    }
+
+    Position find(const key_type& key) const
+    {
+        return Position(lookup(key));
+    }
+
+    //Return the element with given *key*, default-constructing its value if it doesn't exist
+    value_type& insert(const key_type& key)
+    {
+        size_type index = lookup(key);
+        if(index != END_INDEX) return val(index);
+
+        std::uint64_t hash = hashOf(key);
+        if(count + tombstones + 1 > capacity * maxLoadFactor)
+        {
+            //Mostly tombstones: clean them up in place instead of growing
+            if(count + 1 <= capacity * maxLoadFactor / 2) rehashTo(capacity);
+            else rehashTo(std::max(minCapacity, capacity << 1));
+        }
+
+        index = findFreeSlot(hash);
+        new (&slots[index]) value_type(key, mapped_type());
+        if(ctrl[index] == SwissGroup::DELETED) --tombstones;
+        setCtrl(index, fragment(hash));
+        ++count;
+        return val(index);
+    }
+
+    //A slot can go back to EMPTY only if no group-wide probe could have passed over it
+    // while it was full, i.e. there is an EMPTY slot less than a group away on both sides
+    void erase(const Position& pos)
+    {
+        size_type index = pos.index;
+        val(index).~value_type();
+        --count;
+
+        mask_type emptyAfter = SwissGroup(ctrl + index).matchEmpty();
+        mask_type emptyBefore = SwissGroup(ctrl + ((index - WIDTH) & (capacity - 1))).matchEmpty();
+        bool wasNeverFull = emptyAfter != 0 && emptyBefore != 0 &&
+            SwissGroup::lowest(emptyAfter) + SwissGroup::leadingSlots(emptyBefore) < WIDTH;
+        setCtrl(index, wasNeverFull ? SwissGroup::EMPTY : SwissGroup::DELETED);
+        if(!wasNeverFull) ++tombstones;
+        shrinkIfNeeded();
+    }
+
+    value_type& at(const Position& pos) const
+    {
+        return val(pos.index);
+    }
+
+    Position first() const
+    {
+        if(count == 0) return end();
+        size_type index = 0;
+        while(ctrl[index] < 0) ++index;
+        return Position(index);
+    }
+
+    Position end() const
+    {
+        return Position(END_INDEX);
+    }
+
+    //Move *pos* to the next element or to the end position
+    void next(Position& pos) const
+    {
+        for(size_type i = pos.index+1; i < capacity; ++i)
+        {
+            if(ctrl[i] < 0) continue;
+            pos.index = i;
+            return;
+        }
+        pos.index = END_INDEX;
+    }
+
+    //Move *pos* to the previous element, it must not be the first one
+    void prev(Position& pos) const
+    {
+        size_type i = pos.index == END_INDEX ? capacity : pos.index;
+        do --i;
+        while(ctrl[i] < 0);
+        pos.index = i;
+    }
+};
+
+//Element position: index of its slot
+template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+struct SwissTable<KeyType, ValueType, Hash, KeyEqual, Allocator>::Position
+{
+    size_type index;
+
+    explicit Position(size_type in): index(in)
+    {}
+
+    bool operator==(const Position& other) const
+    {
+        return index == other.index;
+    }
+
+    bool operator!=(const Position& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+//HashMap storage policy selecting SwissTable
+struct SwissStorage
+{
+    template <typename KeyType, typename ValueType, typename Hash, typename KeyEqual, typename Allocator>
+    using Engine = SwissTable<KeyType, ValueType, Hash, KeyEqual, Allocator>;
+};
+
+}
+
+#endif /* AISDI_MAPS_SWISSSTORAGE_H */
@@ -0,0 +1,132 @@
+#ifndef AISDI_MAPS_THREADPOOL_H
+#define AISDI_MAPS_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aisdi
+{
+
+//Fixed set of worker threads for fork-join recursion.
+//parallel(a, b) runs *a* and *b*, possibly at the same time, and returns once both are done. The
+// calling thread runs *b* itself and offers *a* to the workers; while waiting for it, the caller
+// takes *a* back if no worker has started it yet, or else runs other queued tasks, so nested
+// calls never leave a thread blocked while there is work to do. Workers take the oldest tasks,
+// which in a recursion are the biggest ones.
+//Tasks must not throw, an exception escaping a worker thread ends the program.
+class ThreadPool
+{
+    struct Task
+    {
+        std::function<void()> run;
+        bool done; //guarded by the pool's mutex
+    };
+
+    std::mutex mutex;
+    std::condition_variable changed; //a task was queued or finished, or the pool is stopping
+    std::deque<Task*> queue;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+public:
+    //A pool of *threads* threads in all, counting the one calling parallel()
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()): stopping(false)
+    {
+        for(unsigned i = 1; i < threads; ++i)
+            workers.emplace_back([this]() { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        for(std::thread& worker : workers)
+            worker.join();
+    }
+
+    //The process-wide pool with a thread per core; it is never destroyed, like EpochManager
+    static ThreadPool& instance()
+    {
+        static ThreadPool* pool = new ThreadPool();
+        return *pool;
+    }
+
+    unsigned getThreadCount() const
+    {
+        return workers.size() + 1;
+    }
+
+    template <typename A, typename B>
+    void parallel(A&& a, B&& b)
+    {
+        if(workers.empty())
+        {
+            a();
+            b();
+            return;
+        }
+
+        Task task{ [&a]() { a(); }, false };
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            queue.push_back(&task);
+        }
+        changed.notify_one();
+        b();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!task.done)
+        {
+            if(queue.empty())
+            {
+                changed.wait(lock);
+                continue;
+            }
+            //The newest task, most likely *a* itself
+            Task* next = queue.back();
+            queue.pop_back();
+            run(next, lock);
+        }
+    }
+
+private:
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;)
+        {
+            if(!queue.empty())
+            {
+                Task* next = queue.front();
+                queue.pop_front();
+                run(next, lock);
+            }
+            else if(stopping) return;
+            else changed.wait(lock);
+        }
+    }
+
+    //Run *task* with the mutex (held in *lock*) released
+    void run(Task* task, std::unique_lock<std::mutex>& lock)
+    {
+        lock.unlock();
+        task->run();
+        lock.lock();
+        task->done = true;
+        changed.notify_all();
+    }
+};
+
+}
+
+#endif /* AISDI_MAPS_THREADPOOL_H */
@@ -1,16 +1,53 @@
 #ifndef AISDI_MAPS_TREEMAP_H
 #define AISDI_MAPS_TREEMAP_H
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <functional>
 #include <initializer_list>
 #include <stdexcept>
 #include <iostream>
+#include <memory>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#include "ParallelSort.h"
+#include "PoolAllocator.h"
+#include "ThreadPool.h"
 
 namespace aisdi
 {
 
-template <typename KeyType, typename ValueType>
+//Keeps TreeMap an AVL tree: subtree heights of every node's children differ by at most one, so
+// the height stays below 1.44 log2(n) whatever the order of insertions and removals.
+struct AvlBalance
+{
+    const static bool splay = false;
+};
+
+//Makes TreeMap a splay tree: every node that is added, found (or where a search ends) is rotated
+// up to the root, so often used keys stay a few steps from it. No height bound holds, but any
+// sequence of operations takes O(log n) amortized each, and much less when few keys are used often.
+//Lookups change the shape of the tree, so const lookups must not run concurrently either.
+//Iterators stay valid, rotations don't move elements.
+struct SplayBalance
+{
+    const static bool splay = true;
+};
+
+//Binary search tree kept balanced by *BalancePolicy* (AvlBalance by default, or SplayBalance).
+//The sentinel, which stands for end(), is the right child of the last node and counts as an empty subtree.
+//Nodes are also threaded in key order: each links to its predecessor and successor, in a ring
+// closed by the sentinel, so begin(), --end() and every step of an iterator take O(1).
+//Every node also keeps the number of nodes in its subtree, so the size, the rank of a key and the
+// element at a given position are found in O(log n).
+//*Allocator* supplies the nodes; with an arena allocator such as PoolAllocator the destructor
+// gives all nodes back at once when the values need no destructor.
+template <typename KeyType, typename ValueType,
+          typename Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+          typename BalancePolicy = AvlBalance>
 class TreeMap
 {
 public:
@@ -20,6 +57,8 @@ public:
     using size_type = std::size_t;
     using reference = value_type&;
     using const_reference = const value_type&;
+    using allocator_type = Allocator;
+    using balance_policy = BalancePolicy;
 
     class ConstIterator;
     class Iterator;
@@ -27,22 +66,114 @@ public:
     using const_iterator = ConstIterator;
     class Node;
     using node = Node;
+    template <typename It>
+    class Range;
+    using range = Range<iterator>;
+    using const_range = Range<const_iterator>;
 
 private:
-    node *sentinel, *root;
-    bool inOrderSuccessorRecentlyUsed = false; //variable used for choosing different variants of remove function
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    NodeAllocator nodeAllocator;
+    node* sentinel;
+    mutable node* root; //splaying moves it even in const lookups
+
+    template <typename... Args>
+    node* createNode(Args&&... args)
+    {
+        node* nd = NodeTraits::allocate(nodeAllocator, 1);
+        try
+        {
+            NodeTraits::construct(nodeAllocator, nd, std::forward<Args>(args)...);
+        }
+        catch(...)
+        {
+            NodeTraits::deallocate(nodeAllocator, nd, 1);
+            throw;
+        }
+        return nd;
+    }
+
+    void destroyNode(node* nd)
+    {
+        NodeTraits::destroy(nodeAllocator, nd);
+        NodeTraits::deallocate(nodeAllocator, nd, 1);
+    }
 
 public:
-    TreeMap(): sentinel(new node), root(sentinel)
+    TreeMap(): TreeMap(Allocator())
     {}
 
+    explicit TreeMap(const Allocator& alloc): nodeAllocator(alloc), sentinel(createNode()), root(sentinel)
+    {
+        sentinel->prev = sentinel->next = sentinel;
+    }
+
     TreeMap(std::initializer_list<value_type> list): TreeMap()
     {
         for(value_type val : list)
             (*this)[val.first] = val.second;
     }
 
-    TreeMap(const TreeMap& other): TreeMap()
+    //Build a map from [*first*, *last*) sorted by key, in O(n): the nodes are created in order
+    // and then linked into a perfectly balanced tree, without searching or rotating
+    //Of equal keys the last one wins, like when adding them one by one; throws std::invalid_argument
+    // if the keys are not sorted
+    template <typename InputIt>
+    static TreeMap fromSorted(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+    {
+        TreeMap map(alloc);
+        std::vector<node*> nodes;
+        try
+        {
+            for(; first != last; ++first)
+            {
+                if(!nodes.empty() && !(nodes.back()->val.first < first->first))
+                {
+                    if(first->first < nodes.back()->val.first) throw std::invalid_argument("Keys are not sorted");
+                    nodes.back()->val.second = first->second;
+                    continue;
+                }
+                nodes.push_back(nullptr); //make room first, so no created node is ever lost
+                nodes.back() = map.createNode(value_type(first->first, first->second), nullptr);
+            }
+        }
+        catch(...)
+        {
+            for(node* nd : nodes)
+                if(nd != nullptr) map.destroyNode(nd);
+            throw;
+        }
+
+        if(nodes.empty()) return map;
+        map.root = map.linkBalanced(nodes.data(), nodes.size(), nullptr);
+        nodes.back()->right = map.sentinel;
+        map.sentinel->parent = nodes.back();
+        node* previous = map.sentinel;
+        for(node* nd : nodes)
+        {
+            linkAfter(previous, nd);
+            previous = nd;
+        }
+        return map;
+    }
+
+    //Build a map from [*first*, *last*) in any order: the items are sorted on all cores
+    // (keeping equal keys in order, so the last one wins) and then loaded with fromSorted()
+    template <typename InputIt>
+    static TreeMap fromUnsorted(InputIt first, InputIt last, const Allocator& alloc = Allocator())
+    {
+        std::vector<std::pair<key_type, mapped_type>> items;
+        for(; first != last; ++first)
+            items.emplace_back(first->first, first->second);
+        parallelStableSort(items.begin(), items.end(),
+            [](const std::pair<key_type, mapped_type>& a, const std::pair<key_type, mapped_type>& b) { return a.first < b.first; });
+        return fromSorted(items.begin(), items.end(), alloc);
+    }
+
+    TreeMap(const TreeMap& other):
+        TreeMap(Allocator(NodeTraits::select_on_container_copy_construction(other.nodeAllocator)))
     {
         if(other.isEmpty()) return;
         else copy_tree(other.root, other.sentinel);
@@ -55,9 +186,13 @@ public:
 
     ~TreeMap()
     {
-        empty_tree(root);
+        //With an arena, values that need no destructor are dropped together with the nodes
+        if(!std::is_trivially_destructible<value_type>::value || !releaseArena(nodeAllocator))
+        {
+            empty_tree(root);
+            destroyNode(sentinel);
+        }
         root = nullptr;
-        delete sentinel;
         sentinel = nullptr;
     }
 
@@ -67,6 +202,7 @@ public:
         {
             empty_tree(root);
             sentinel->parent = nullptr;
+            sentinel->prev = sentinel->next = sentinel;
             root = sentinel;
             copy_tree(other.root, other.sentinel);
         }
@@ -85,21 +221,68 @@ public:
     }
 
     //Delete all nodes from the given subtree except the sentinel
+    //Leaves are deleted bottom-up, climbing back through parent pointers, so no stack is needed
     void empty_tree(node* nd)
     {
         if(nd == nullptr || nd == sentinel) return;
-        empty_tree(nd->left);
-        empty_tree(nd->right);
-        delete nd;
+        node* stop = nd->parent;
+        while(nd != stop)
+        {
+            if(nd->left != nullptr) nd = nd->left;
+            else if(nd->right != nullptr && nd->right != sentinel) nd = nd->right;
+            else
+            {
+                node* parent = nd->parent;
+                if(parent != stop)
+                {
+                    if(parent->left == nd) parent->left = nullptr;
+                    else parent->right = nullptr;
+                }
+                destroyNode(nd);
+                nd = parent;
+            }
+        }
     }
 
-    //Copy all nodes from the given subtree except the sentinel
+    //Make *this* (empty) a copy of the given subtree of a tree whose sentinel is *sentinel*
+    //The shape is cloned node by node, walking both trees in step, so it takes O(n) and no stack;
+    // then the copies are threaded in order
     void copy_tree(node* nd, node* sentinel)
     {
         if(nd == nullptr || nd == sentinel) return;
-        (*this)[nd->val.first] = nd->val.second;
-        copy_tree(nd->left, sentinel);
-        copy_tree(nd->right, sentinel);
+        node* copy = root = createNode(nd->val, nullptr);
+        copy->height = nd->height;
+        copy->count = nd->count;
+        for(;;)
+        {
+            if(nd->left != nullptr && copy->left == nullptr)
+            {
+                copy->left = createNode(nd->left->val, copy);
+                nd = nd->left;
+                copy = copy->left;
+            }
+            else if(nd->right != nullptr && nd->right != sentinel && copy->right == nullptr)
+            {
+                copy->right = createNode(nd->right->val, copy);
+                nd = nd->right;
+                copy = copy->right;
+            }
+            else
+            {
+                if(nd->right == sentinel)
+                {
+                    copy->right = this->sentinel;
+                    this->sentinel->parent = copy;
+                }
+                if(copy == root) break;
+                nd = nd->parent;
+                copy = copy->parent;
+                continue;
+            }
+            copy->height = nd->height;
+            copy->count = nd->count;
+        }
+        threadInOrder();
     }
 
     //Move tree nodes from *other* to *this* tree
@@ -112,8 +295,16 @@ public:
         root = other.root;
         sentinel = other.sentinel;
 
-        //Make *other* an empty tree with one sentinel node
+        //Make *other* an empty tree with one sentinel node, the allocators go along with their nodes
+        temp->parent = nullptr;
+        temp->prev = temp->next = temp;
         other.root = other.sentinel = temp;
+        std::swap(nodeAllocator, other.nodeAllocator);
+    }
+
+    allocator_type get_allocator() const
+    {
+        return allocator_type(nodeAllocator);
     }
 
     bool isEmpty() const
@@ -121,44 +312,77 @@ public:
         return (root == sentinel);
     }
 
-    //Return a node with the given key or create a new one
-    node* getNode(node *&nd, const key_type &key, node *parent, node *&requested)
+    //Height of the subtree rooted at *nd*, empty subtrees and the sentinel count as 0
+    int heightOf(const node* nd) const
+    {
+        return (nd == nullptr || nd == sentinel) ? 0 : nd->height;
+    }
+
+    int getHeight() const
+    {
+        return heightOf(root);
+    }
+
+    //Number of nodes in the subtree rooted at *nd*, empty subtrees and the sentinel count as 0
+    size_type countOf(const node* nd) const
+    {
+        return (nd == nullptr || nd == sentinel) ? 0 : nd->count;
+    }
+
+    //Return the node with the given key, inserting it (and rebalancing the tree) if it doesn't exist
+    node* getNode(const key_type &key)
     {
-        //Node with given key doesn't exist, create it
-        if(nd == nullptr)
+        node* parent = nullptr;
+        node* nd = root;
+        while(nd != nullptr && nd != sentinel)
         {
-            nd = new node(key, parent);
-            requested = nd;
+            if(key == nd->val.first)
+            {
+                if(BalancePolicy::splay) splay(nd);
+                return nd;
+            }
+            parent = nd;
+            nd = key < nd->val.first ? nd->left : nd->right;
         }
-        /*Currently visited node is the sentinel, so the node we are looking
-          for doesn't exist -> create it and insert before sentinel*/
-        else if(nd == sentinel)
+
+        node* created = createNode(key, parent);
+        if(nd == sentinel) //inserting after the last node, before the sentinel
+        {
+            created->right = sentinel;
+            sentinel->parent = created;
+        }
+        //A new left child comes right before its parent in key order, a new right child right after it
+        if(parent == nullptr)
+        {
+            root = created;
+            linkAfter(sentinel, created);
+        }
+        else if(key < parent->val.first)
+        {
+            parent->left = created;
+            linkAfter(parent->prev, created);
+        }
+        else
         {
-            nd = new node(key, parent);
-            nd->right = sentinel;
-            sentinel->parent = nd;
-            requested = nd;
+            parent->right = created;
+            linkAfter(parent, created);
         }
-        //Requested node has smaller key than currently visited one
-        else if(key < nd->val.first)
-            nd->left = getNode(nd->left, key, nd, requested);
-        //Requested node has greater key than currently visited one
-        else if(key > nd->val.first)
-            nd->right = getNode(nd->right, key, nd, requested);
-        //Currently visited node has the right key
-        else requested = nd;
 
-        return nd;
+        if(BalancePolicy::splay) //the rotations recount the whole path
+        {
+            splay(created);
+            return created;
+        }
+        //The path was just walked, so this doesn't touch any node that isn't in cache
+        for(node* nd = parent; nd != nullptr; nd = nd->parent)
+            ++nd->count;
+        rebalanceUpwards(parent);
+        return created;
     }
 
     mapped_type& operator[](const key_type &key)
     {
-        bool wasEmpty = false;
-        node *temp;
-        if(isEmpty()) wasEmpty = true;
-        getNode(root, key, nullptr, temp);
-        if(wasEmpty) root = temp;
-        return temp->val.second;
+        return getNode(key)->val.second;
     }
 
     const mapped_type& valueOf(const key_type& key) const
@@ -177,11 +401,20 @@ public:
 
     node* search(node *root, const key_type& key) const
     {
-        if(root == nullptr || key == root->val.first)
-            return root;
-        else if(key < root->val.first)
-            return search(root->left, key);
-        else return search(root->right, key);
+        node* nd = root;
+        node* last = nullptr;
+        while(nd != nullptr && nd != sentinel)
+        {
+            if(key == nd->val.first) break;
+            last = nd;
+            //A select rather than a branch: the next node's address doesn't wait for a misprediction
+            nd = key < nd->val.first ? nd->left : nd->right;
+        }
+        if(nd == sentinel) nd = nullptr;
+        //Splaying only rotates, which leaves the elements, and so the map's value, unchanged
+        if(BalancePolicy::splay && (nd != nullptr || last != nullptr))
+            const_cast<TreeMap*>(this)->splay(nd != nullptr ? nd : last);
+        return nd;
     }
 
     const_iterator find(const key_type& key) const
@@ -200,6 +433,108 @@ public:
         else return iterator(const_iterator(this, temp));
     }
 
+    //First element whose key is not less than *key* (end() if there is none)
+    const_iterator lowerBound(const key_type& key) const
+    {
+        node* result = sentinel;
+        node* nd = root;
+        while(nd != nullptr && nd != sentinel)
+        {
+            if(nd->val.first < key) nd = nd->right;
+            else
+            {
+                result = nd;
+                nd = nd->left;
+            }
+        }
+        return const_iterator(this, result);
+    }
+
+    iterator lowerBound(const key_type& key)
+    {
+        return iterator(static_cast<const TreeMap*>(this)->lowerBound(key));
+    }
+
+    //First element whose key is greater than *key* (end() if there is none)
+    const_iterator upperBound(const key_type& key) const
+    {
+        node* result = sentinel;
+        node* nd = root;
+        while(nd != nullptr && nd != sentinel)
+        {
+            if(key < nd->val.first)
+            {
+                result = nd;
+                nd = nd->left;
+            }
+            else nd = nd->right;
+        }
+        return const_iterator(this, result);
+    }
+
+    iterator upperBound(const key_type& key)
+    {
+        return iterator(static_cast<const TreeMap*>(this)->upperBound(key));
+    }
+
+    //Element with the greatest key not greater than *key* (end() if there is none)
+    const_iterator floor(const key_type& key) const
+    {
+        node* result = sentinel;
+        node* nd = root;
+        while(nd != nullptr && nd != sentinel)
+        {
+            if(key < nd->val.first) nd = nd->left;
+            else
+            {
+                result = nd;
+                nd = nd->right;
+            }
+        }
+        return const_iterator(this, result);
+    }
+
+    iterator floor(const key_type& key)
+    {
+        return iterator(static_cast<const TreeMap*>(this)->floor(key));
+    }
+
+    //Element with the least key not less than *key* (end() if there is none)
+    const_iterator ceiling(const key_type& key) const
+    {
+        return lowerBound(key);
+    }
+
+    iterator ceiling(const key_type& key)
+    {
+        return lowerBound(key);
+    }
+
+    //Elements with key equal to *key*: empty, or just the one found by find()
+    std::pair<const_iterator, const_iterator> equalRange(const key_type& key) const
+    {
+        return std::make_pair(lowerBound(key), upperBound(key));
+    }
+
+    std::pair<iterator, iterator> equalRange(const key_type& key)
+    {
+        return std::make_pair(lowerBound(key), upperBound(key));
+    }
+
+    //View of the elements with keys in [*low*, *high*); it holds just two iterators, so elements
+    // are visited as it is iterated, and it is invalidated like them
+    const_range rangeOf(const key_type& low, const key_type& high) const
+    {
+        if(!(low < high)) return const_range(end(), end());
+        return const_range(lowerBound(low), lowerBound(high));
+    }
+
+    range rangeOf(const key_type& low, const key_type& high)
+    {
+        if(!(low < high)) return range(end(), end());
+        return range(lowerBound(low), lowerBound(high));
+    }
+
     void remove(const key_type& key)
     {
         const_iterator it = find(key);
@@ -210,111 +545,735 @@ public:
     {
         if(it == end()) throw std::out_of_range("Node with given key doesn't exist or iterator is in end position");
         node* temp = it.getNode();
-        bool isNotRoot = (temp != root);
-        bool isRightChild = isNotRoot ? (temp->parent->right == temp) : false;
-        if(temp->left == nullptr)
+        node* unbalanced; //lowest node whose subtree got shorter
+
+        if(temp->left != nullptr && temp->right != nullptr && temp->right != sentinel) //two children
         {
-            if(temp->right == nullptr) //no children (*temp* can't be root)
+            //Put the in-order successor in place of *temp*
+            node* nd = temp->next;
+
+            if(nd != temp->right)
             {
-                if(isRightChild) temp->parent->right = nullptr;
-                else temp->parent->left = nullptr;
-                delete temp;
+                unbalanced = nd->parent;
+                nd->parent->left = nd->right;
+                if(nd->right != nullptr)
+                    nd->right->parent = nd->parent;
+                nd->right = temp->right;
+                temp->right->parent = nd;
             }
-            else //one child on the right (can be sentinel node)
-            {
-                if(isNotRoot)
-                {
-                    if(isRightChild) temp->parent->right = temp->right;
-                    else temp->parent->left = temp->right;
-                }
-                else root = temp->right;
+            else unbalanced = nd;
 
-                temp->right->parent = temp->parent; //this line is ok even if *temp* is root,
-                                                    //because temp->parent is nullptr in that case
-                delete temp;
+            nd->left = temp->left;
+            temp->left->parent = nd;
+            nd->height = temp->height;
+            nd->count = temp->count;
+            replaceChild(temp, nd);
+        }
+        else
+        {
+            node* child = temp->left != nullptr ? temp->left : temp->right; //may be the sentinel or nullptr
+            if(temp->left != nullptr && temp->right == sentinel) //the sentinel goes to the new last node
+            {
+                temp->prev->right = sentinel;
+                sentinel->parent = temp->prev;
             }
+            unbalanced = temp->parent;
+            replaceChild(temp, child);
         }
-        else //(temp->left != nullptr)
+
+        temp->prev->next = temp->next;
+        temp->next->prev = temp->prev;
+        destroyNode(temp);
+        if(BalancePolicy::splay) //the rotations fix heights and counts of the whole path
+        {
+            if(unbalanced == nullptr) return;
+            updateHeight(unbalanced);
+            splay(unbalanced);
+            return;
+        }
+        for(node* nd = unbalanced; nd != nullptr; nd = nd->parent)
+            --nd->count;
+        rebalanceUpwards(unbalanced);
+    }
+
+    //Rebuild the tree perfectly balanced in fresh nodes laid out for lookups, in O(n)
+    //After long churn the nodes are scattered over the heap and each step of a search is a cache
+    // miss; here all of them are allocated anew, before the old ones are freed, and handed out
+    // in van Emde Boas order by address: the top half of the levels first, then each of the
+    // subtrees below it in the same way, so a search keeps finding the next node in memory it has
+    // just touched. How close together the nodes end up is the allocator's business.
+    //Values are moved if that can't throw; if anything throws the map is left as it was.
+    //Invalidates all iterators except end(), meant for a quiet moment between bursts of changes.
+    void compact()
+    {
+        size_type count = getSize();
+        if(count == 0) return;
+
+        std::vector<node*> nodes; //in key order
+        nodes.reserve(count);
+        for(node* nd = sentinel->next; nd != sentinel; nd = nd->next)
+            nodes.push_back(nd);
+
+        std::vector<node*> blocks;
+        blocks.reserve(count);
+        try
+        {
+            for(size_type i = 0; i < count; ++i)
+                blocks.push_back(NodeTraits::allocate(nodeAllocator, 1));
+        }
+        catch(...)
+        {
+            for(node* block : blocks)
+                NodeTraits::deallocate(nodeAllocator, block, 1);
+            throw;
+        }
+        std::sort(blocks.begin(), blocks.end(), std::less<node*>());
+
+        //The k-th lowest block goes to the k-th node of the layout
+        std::vector<size_type> layout;
+        layout.reserve(count);
+        vanEmdeBoasOrder(0, count, heightOfBalanced(count), layout);
+        std::vector<node*> compacted(count);
+        for(size_type k = 0; k < count; ++k)
+            compacted[layout[k]] = blocks[k];
+
+        const bool moveValues = std::is_nothrow_move_constructible<mapped_type>::value &&
+            std::is_nothrow_move_assignable<mapped_type>::value;
+        size_type constructed = 0;
+        try
         {
-            if(temp->right == nullptr) //one child on the left (*temp* can't be root)
+            for(; constructed < count; ++constructed)
             {
-                temp->left->parent = temp->parent;
-                if(isRightChild) temp->parent->right = temp->left;
-                else temp->parent->left = temp->left;
-                delete temp;
+                node* old = nodes[constructed];
+                if(moveValues) NodeTraits::construct(nodeAllocator, compacted[constructed], old->val.first, std::move(old->val.second), nullptr);
+                else NodeTraits::construct(nodeAllocator, compacted[constructed], old->val.first, old->val.second, nullptr);
             }
-            else if(temp->right == sentinel) //two children, sentinel on the right (*temp* is root)
+        }
+        catch(...)
+        {
+            for(size_type i = 0; i < constructed; ++i)
             {
-                node* nd = temp->left;
-                while(nd->right != nullptr)
-                    nd = nd->right;
-                nd->right = sentinel;
-                sentinel->parent = nd;
+                if(moveValues) nodes[i]->val.second = std::move(compacted[i]->val.second);
+                NodeTraits::destroy(nodeAllocator, compacted[i]);
+            }
+            for(node* block : blocks)
+                NodeTraits::deallocate(nodeAllocator, block, 1);
+            throw;
+        }
+
+        for(node* nd : nodes)
+            destroyNode(nd);
+        root = linkBalanced(compacted.data(), count, nullptr);
+        compacted.back()->right = sentinel;
+        sentinel->parent = compacted.back();
+        sentinel->prev = sentinel->next = sentinel;
+        node* previous = sentinel;
+        for(node* nd : compacted)
+        {
+            linkAfter(previous, nd);
+            previous = nd;
+        }
+    }
+
+    //Set operations taking the trees apart and joining the pieces again rather than searching one
+    // map for every item of the other (join-based): the other tree is split at this tree's root
+    // key, the two halves are combined with the root's subtrees in parallel, as tasks on *pool*,
+    // and the results are joined back under the root. For maps of m <= n items that takes
+    // O(m log(n/m + 1)) steps instead of the O(m log n) of lookups, besides using all cores.
+    //*other* is consumed, its nodes become this map's or are freed; pass it with std::move()
+    // unless it is needed afterwards. Its iterators are invalidated, as are this map's iterators to
+    // removed items. A key in both maps gets resolve(value here, value in *other*); *resolve*
+    // may be called from several threads at once and must not throw.
+    //They recurse as deep as the trees are high, so splay trees, whose height is not bounded, can't use them.
+
+    //Add all items of *other*
+    template <typename Resolve>
+    void unionWith(TreeMap other, Resolve resolve, ThreadPool& pool = ThreadPool::instance())
+    {
+        static_assert(!BalancePolicy::splay, "Set operations need a tree of bounded height, not a splay tree");
+        adopt(other);
+        std::atomic<node*> discarded(nullptr);
+        attach(uniteTrees(detach(), other.detach(), resolve, discarded, pool));
+        destroyDiscarded(discarded);
+    }
+
+    //Keep only the keys that are also in *other*
+    template <typename Resolve>
+    void intersectWith(TreeMap other, Resolve resolve, ThreadPool& pool = ThreadPool::instance())
+    {
+        static_assert(!BalancePolicy::splay, "Set operations need a tree of bounded height, not a splay tree");
+        adopt(other);
+        std::atomic<node*> discarded(nullptr);
+        attach(intersectTrees(detach(), other.detach(), resolve, discarded, pool));
+        destroyDiscarded(discarded);
+    }
+
+    //Remove the keys that are in *other*
+    void difference(TreeMap other, ThreadPool& pool = ThreadPool::instance())
+    {
+        static_assert(!BalancePolicy::splay, "Set operations need a tree of bounded height, not a splay tree");
+        adopt(other);
+        std::atomic<node*> discarded(nullptr);
+        attach(subtractTrees(detach(), other.detach(), discarded, pool));
+        destroyDiscarded(discarded);
+    }
+
+    //Move the items with keys not less than *key* to a new map, which is returned, in O(log n)
+    //Iterators to the moved items are invalidated.
+    TreeMap split(const key_type& key)
+    {
+        static_assert(!BalancePolicy::splay, "Set operations need a tree of bounded height, not a splay tree");
+        TreeMap greater{ allocator_type(nodeAllocator) };
+        node *left, *found, *right;
+        splitTree(detach(), key, left, found, right);
+        if(found != nullptr) right = joinTrees(nullptr, found, right);
+        attach(left);
+        greater.attach(right);
+        return greater;
+    }
+
+    //Map of the items of *less* followed by those of *greater*, in O(log n); all keys of *less*
+    // have to be less than those of *greater*, throws std::invalid_argument if they are not
+    static TreeMap join(TreeMap less, TreeMap greater)
+    {
+        static_assert(!BalancePolicy::splay, "Set operations need a tree of bounded height, not a splay tree");
+        if(less.isEmpty()) return greater;
+        if(greater.isEmpty()) return less;
+        if(!((--less.end())->first < greater.begin()->first)) throw std::invalid_argument("Maps overlap");
+        less.adopt(greater);
+        node* last;
+        node* rest = less.splitLast(less.detach(), last);
+        less.attach(less.joinTrees(rest, last, greater.detach()));
+        return less;
+    }
+
+private:
+    const static size_type PARALLEL_GRAIN = 1 << 12; //smaller set operations aren't worth a task
+
+    //Make the nodes of *other* ones this map can free, copying them if the allocators differ
+    void adopt(TreeMap& other)
+    {
+        if(other.nodeAllocator != nodeAllocator)
+            other = fromSorted(other.begin(), other.end(), allocator_type(nodeAllocator));
+    }
+
+    //Take the tree out of the map, without the sentinel, leaving the map empty (returns its root)
+    //Its nodes stay threaded in order, except that the first and the last node point nowhere.
+    node* detach()
+    {
+        if(isEmpty()) return nullptr;
+        node* top = root;
+        sentinel->parent->right = nullptr;
+        sentinel->parent = nullptr;
+        sentinel->prev = sentinel->next = sentinel;
+        root = sentinel;
+        return top;
+    }
+
+    //Make the tree rooted at *top* (threaded in order but for its ends) the map's tree
+    void attach(node* top)
+    {
+        if(top == nullptr) return;
+        root = top;
+        top->parent = nullptr;
+        node *first = top, *last = top;
+        while(first->left != nullptr)
+            first = first->left;
+        while(last->right != nullptr)
+            last = last->right;
+        last->right = sentinel;
+        sentinel->parent = last;
+        first->prev = sentinel;
+        sentinel->next = first;
+        last->next = sentinel;
+        sentinel->prev = last;
+    }
+
+    //Queue the tree rooted at *top* to be freed once the operation is over; nodes are never
+    // freed by the tasks themselves, since an allocator may not be shared between threads
+    static void discard(node* top, std::atomic<node*>& discarded)
+    {
+        if(top == nullptr) return;
+        top->parent = nullptr;
+        top->next = discarded.load(std::memory_order_relaxed);
+        while(!discarded.compare_exchange_weak(top->next, top, std::memory_order_relaxed))
+        {}
+    }
+
+    void destroyDiscarded(std::atomic<node*>& discarded)
+    {
+        node* top = discarded.load(std::memory_order_relaxed);
+        while(top != nullptr)
+        {
+            node* next = top->next;
+            empty_tree(top);
+            top = next;
+        }
+    }
+
+    //Make *nd* the root of *left* and *right*, which are already balanced against each other
+    node* linkTrees(node* left, node* nd, node* right)
+    {
+        nd->parent = nullptr;
+        nd->left = left;
+        nd->right = right;
+        if(left != nullptr) left->parent = nd;
+        if(right != nullptr) right->parent = nd;
+        nd->height = 1 + std::max(heightOf(left), heightOf(right));
+        updateCount(nd);
+        return nd;
+    }
+
+    //Tree of *left*, *nd* and *right*, in this order of keys, in O(difference of their heights):
+    // *nd* goes down the spine of the taller tree to a subtree as tall as the other one, and the
+    // rotations on the way back up restore the AVL property
+    node* joinTrees(node* left, node* nd, node* right)
+    {
+        //Thread *nd* between the two trees, which are threaded themselves
+        if(left != nullptr)
+        {
+            node* last = left;
+            while(last->right != nullptr)
+                last = last->right;
+            last->next = nd;
+            nd->prev = last;
+        }
+        if(right != nullptr)
+        {
+            node* first = right;
+            while(first->left != nullptr)
+                first = first->left;
+            first->prev = nd;
+            nd->next = first;
+        }
+        return joinBalanced(left, nd, right);
+    }
+
+    node* joinBalanced(node* left, node* nd, node* right)
+    {
+        if(heightOf(left) > heightOf(right) + 1) return joinRight(left, nd, right);
+        if(heightOf(right) > heightOf(left) + 1) return joinLeft(left, nd, right);
+        return linkTrees(left, nd, right);
+    }
+
+    //*left* is taller than *right* by more than one
+    node* joinRight(node* left, node* nd, node* right)
+    {
+        node *l = left->left, *c = left->right;
+        if(heightOf(c) <= heightOf(right) + 1)
+        {
+            if(1 + std::max(heightOf(c), heightOf(right)) <= heightOf(l) + 1)
+                return linkTrees(l, left, linkTrees(c, nd, right));
+            //Too tall by one on the inner side: a double rotation
+            node *cl = c->left, *cr = c->right;
+            return linkTrees(linkTrees(l, left, cl), c, linkTrees(cr, nd, right));
+        }
+        node* joined = joinRight(c, nd, right);
+        if(heightOf(joined) <= heightOf(l) + 1) return linkTrees(l, left, joined);
+        node *jl = joined->left, *jr = joined->right;
+        return linkTrees(linkTrees(l, left, jl), joined, jr);
+    }
+
+    //*right* is taller than *left* by more than one
+    node* joinLeft(node* left, node* nd, node* right)
+    {
+        node *c = right->left, *r = right->right;
+        if(heightOf(c) <= heightOf(left) + 1)
+        {
+            if(1 + std::max(heightOf(c), heightOf(left)) <= heightOf(r) + 1)
+                return linkTrees(linkTrees(left, nd, c), right, r);
+            node *cl = c->left, *cr = c->right;
+            return linkTrees(linkTrees(left, nd, cl), c, linkTrees(cr, right, r));
+        }
+        node* joined = joinLeft(left, nd, c);
+        if(heightOf(joined) <= heightOf(r) + 1) return linkTrees(joined, right, r);
+        node *jl = joined->left, *jr = joined->right;
+        return linkTrees(jl, joined, linkTrees(jr, right, r));
+    }
+
+    //Tree of *left* followed by *right*
+    node* joinTrees(node* left, node* right)
+    {
+        if(left == nullptr) return right;
+        node* last;
+        node* rest = splitLast(left, last);
+        return joinTrees(rest, last, right);
+    }
 
-                temp->left->parent = nullptr;
-                root = temp->left;
+    //Split the tree rooted at *top* into the keys less than *key*, the node with *key* (nullptr if
+    // there is none) and the keys greater than it, in O(log n); the pieces keep their threading,
+    // only the links across the cut are left pointing at the other side
+    void splitTree(node* top, const key_type& key, node*& left, node*& found, node*& right)
+    {
+        if(top == nullptr)
+        {
+            left = found = right = nullptr;
+            return;
+        }
+        node *l = top->left, *r = top->right;
+        if(l != nullptr) l->parent = nullptr;
+        if(r != nullptr) r->parent = nullptr;
+        if(key == top->val.first)
+        {
+            left = l;
+            right = r;
+            found = linkTrees(nullptr, top, nullptr);
+        }
+        else if(key < top->val.first)
+        {
+            node* rest;
+            splitTree(l, key, left, found, rest);
+            right = joinBalanced(rest, top, r); //neighbours already, no threading needed
+        }
+        else
+        {
+            node* rest;
+            splitTree(r, key, rest, found, right);
+            left = joinBalanced(l, top, rest);
+        }
+    }
 
-                delete temp;
+    //Take the last node out of the tree rooted at *top* (returns the rest)
+    node* splitLast(node* top, node*& last)
+    {
+        node *l = top->left, *r = top->right;
+        if(l != nullptr) l->parent = nullptr;
+        if(r == nullptr)
+        {
+            last = top;
+            return l;
+        }
+        r->parent = nullptr;
+        return joinBalanced(l, top, splitLast(r, last));
+    }
+
+    //Run *a* and *b* as parallel tasks if there are at least *size* items to process
+    template <typename A, typename B>
+    static void fork(size_type size, ThreadPool& pool, A a, B b)
+    {
+        if(size >= PARALLEL_GRAIN) pool.parallel(a, b);
+        else
+        {
+            a();
+            b();
+        }
+    }
+
+    template <typename Resolve>
+    node* uniteTrees(node* a, node* b, Resolve& resolve, std::atomic<node*>& discarded, ThreadPool& pool)
+    {
+        if(a == nullptr) return b;
+        if(b == nullptr) return a;
+        size_type size = a->count + b->count;
+        node *bl, *found, *br, *l, *r;
+        splitTree(b, a->val.first, bl, found, br);
+        if(found != nullptr)
+        {
+            a->val.second = resolve(a->val.second, found->val.second);
+            discard(found, discarded);
+        }
+        node *al = a->left, *ar = a->right;
+        fork(size, pool, [&]() { l = uniteTrees(al, bl, resolve, discarded, pool); },
+            [&]() { r = uniteTrees(ar, br, resolve, discarded, pool); });
+        return joinTrees(l, a, r);
+    }
+
+    template <typename Resolve>
+    node* intersectTrees(node* a, node* b, Resolve& resolve, std::atomic<node*>& discarded, ThreadPool& pool)
+    {
+        if(a == nullptr || b == nullptr)
+        {
+            discard(a, discarded);
+            discard(b, discarded);
+            return nullptr;
+        }
+        size_type size = a->count + b->count;
+        node *bl, *found, *br, *l, *r;
+        splitTree(b, a->val.first, bl, found, br);
+        node *al = a->left, *ar = a->right;
+        fork(size, pool, [&]() { l = intersectTrees(al, bl, resolve, discarded, pool); },
+            [&]() { r = intersectTrees(ar, br, resolve, discarded, pool); });
+        if(found == nullptr)
+        {
+            discard(linkTrees(nullptr, a, nullptr), discarded);
+            return joinTrees(l, r);
+        }
+        a->val.second = resolve(a->val.second, found->val.second);
+        discard(found, discarded);
+        return joinTrees(l, a, r);
+    }
+
+    node* subtractTrees(node* a, node* b, std::atomic<node*>& discarded, ThreadPool& pool)
+    {
+        if(a == nullptr || b == nullptr)
+        {
+            discard(b, discarded);
+            return a;
+        }
+        size_type size = a->count + b->count;
+        node *bl, *found, *br, *l, *r;
+        splitTree(b, a->val.first, bl, found, br);
+        node *al = a->left, *ar = a->right;
+        fork(size, pool, [&]() { l = subtractTrees(al, bl, discarded, pool); },
+            [&]() { r = subtractTrees(ar, br, discarded, pool); });
+        if(found == nullptr) return joinTrees(l, a, r);
+        discard(found, discarded);
+        discard(linkTrees(nullptr, a, nullptr), discarded);
+        return joinTrees(l, r);
+    }
+
+    //Thread *nd* into the ring of nodes right after *previous*
+    static void linkAfter(node* previous, node* nd)
+    {
+        nd->prev = previous;
+        nd->next = previous->next;
+        previous->next->prev = nd;
+        previous->next = nd;
+    }
+
+    //Thread all nodes in key order, found from the tree's shape by climbing parent pointers
+    void threadInOrder()
+    {
+        node* previous = sentinel;
+        node* nd = root;
+        while(nd->left != nullptr)
+            nd = nd->left;
+        while(nd != sentinel)
+        {
+            previous->next = nd;
+            nd->prev = previous;
+            previous = nd;
+            if(nd->right != nullptr) //the last node's right child is the sentinel, which ends the walk
+            {
+                nd = nd->right;
+                while(nd->left != nullptr)
+                    nd = nd->left;
             }
-            else //two children (*temp* can't be root)
+            else
             {
-                node* nd;
-                if(inOrderSuccessorRecentlyUsed) //use in-order predecessor this time
-                {
-                    nd = temp->left;
-                    while(nd->right != nullptr)
-                        nd = nd->right;
+                while(nd->parent->right == nd)
+                    nd = nd->parent;
+                nd = nd->parent;
+            }
+        }
+        previous->next = sentinel;
+        sentinel->prev = previous;
+    }
 
-                    nd->parent->right = nd->left;
-                    if(nd->left != nullptr)
-                        nd->left->parent = nd->parent;
+    //Put *replacement* (can be nullptr) in place of *nd* in *nd*'s parent
+    void replaceChild(node* nd, node* replacement)
+    {
+        if(nd->parent == nullptr) root = replacement;
+        else if(nd->parent->left == nd) nd->parent->left = replacement;
+        else nd->parent->right = replacement;
+        if(replacement != nullptr) replacement->parent = nd->parent;
+    }
 
-                    inOrderSuccessorRecentlyUsed = false;
-                }
-                else //use in-order successor
-                {
-                    nd = temp->right;
-                    while(nd->left != nullptr)
-                        nd = nd->left;
+    void updateCount(node* nd)
+    {
+        nd->count = 1 + countOf(nd->left) + countOf(nd->right);
+    }
 
-                    nd->parent->left = nd->right;
-                    if(nd->right != nullptr)
-                        nd->right->parent = nd->parent;
+    void updateHeight(node* nd)
+    {
+        nd->height = 1 + std::max(heightOf(nd->left), heightOf(nd->right));
+        updateCount(nd);
+    }
 
-                    inOrderSuccessorRecentlyUsed = true;
-                }
+    //Rotations keep the sentinel the right child of the last node, since they never reorder nodes
+    node* rotateLeft(node* nd)
+    {
+        node* pivot = nd->right;
+        nd->right = pivot->left;
+        if(pivot->left != nullptr) pivot->left->parent = nd;
+        replaceChild(nd, pivot);
+        pivot->left = nd;
+        nd->parent = pivot;
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
 
-                nd->left = temp->left;
-                if(temp->left != nullptr)
-                    temp->left->parent = nd;
-                nd->right = temp->right;
-                if(temp->right != nullptr)
-                    temp->right->parent = nd;
-                nd->parent = temp->parent;
-                if(isNotRoot)
-                {
-                    if(isRightChild) temp->parent->right = nd;
-                    else temp->parent->left = nd;
-                }
-                else root = nd;
-                delete temp;
-            }
+    node* rotateRight(node* nd)
+    {
+        node* pivot = nd->left;
+        nd->left = pivot->right;
+        if(pivot->right != nullptr) pivot->right->parent = nd;
+        replaceChild(nd, pivot);
+        pivot->right = nd;
+        nd->parent = pivot;
+        updateHeight(nd);
+        updateHeight(pivot);
+        return pivot;
+    }
+
+    //Restore the AVL property (subtree heights differ by at most 1) at *nd*, whose children are
+    // already balanced (returns the new root of the subtree)
+    node* rebalance(node* nd)
+    {
+        updateHeight(nd);
+        int balance = heightOf(nd->left) - heightOf(nd->right);
+        if(balance > 1)
+        {
+            if(heightOf(nd->left->left) < heightOf(nd->left->right)) rotateLeft(nd->left);
+            return rotateRight(nd);
+        }
+        if(balance < -1)
+        {
+            if(heightOf(nd->right->right) < heightOf(nd->right->left)) rotateRight(nd->right);
+            return rotateLeft(nd);
+        }
+        return nd;
+    }
+
+    //Link *count* nodes, sorted by key, into a perfectly balanced subtree hanging from *parent*
+    // (returns its root); the recursion goes only log2(count) deep
+    node* linkBalanced(node** nodes, size_type count, node* parent)
+    {
+        if(count == 0) return nullptr;
+        size_type middle = count / 2;
+        node* nd = nodes[middle];
+        nd->parent = parent;
+        nd->left = linkBalanced(nodes, middle, nd);
+        nd->right = linkBalanced(nodes + middle + 1, count - middle - 1, nd);
+        nd->count = count;
+        nd->height = 1 + std::max(heightOf(nd->left), heightOf(nd->right));
+        return nd;
+    }
+
+    //Height of the tree linkBalanced() makes of *count* nodes
+    static int heightOfBalanced(size_type count)
+    {
+        int height = 0;
+        for(; count != 0; count /= 2)
+            ++height;
+        return height;
+    }
+
+    //Append to *order* the positions (in key order) of the top *levels* levels of the subtree
+    // linkBalanced() makes of the *count* nodes from position *first*, in van Emde Boas order
+    static void vanEmdeBoasOrder(size_type first, size_type count, int levels, std::vector<size_type>& order)
+    {
+        if(count == 0) return;
+        if(levels == 1)
+        {
+            order.push_back(first + count / 2);
+            return;
+        }
+        int top = levels / 2;
+        vanEmdeBoasOrder(first, count, top, order);
+        std::vector<std::pair<size_type, size_type>> subtrees;
+        subtreesAtDepth(first, count, top, subtrees);
+        for(const std::pair<size_type, size_type>& subtree : subtrees)
+            vanEmdeBoasOrder(subtree.first, subtree.second, levels - top, order);
+    }
+
+    //Append to *subtrees* the first positions and sizes of the subtrees rooted *depth* levels
+    // below the root of the one linkBalanced() makes of the *count* nodes from position *first*
+    static void subtreesAtDepth(size_type first, size_type count, int depth,
+        std::vector<std::pair<size_type, size_type>>& subtrees)
+    {
+        if(count == 0) return;
+        if(depth == 0)
+        {
+            subtrees.emplace_back(first, count);
+            return;
+        }
+        size_type middle = count / 2;
+        subtreesAtDepth(first, middle, depth - 1, subtrees);
+        subtreesAtDepth(first + middle + 1, count - middle - 1, depth - 1, subtrees);
+    }
+
+    //Rotate *nd* up to the root, two levels at a time: a node and its parent on the same side of
+    // their parents are rotated parent first, which roughly halves the depth of the nodes on the path
+    void splay(node* nd)
+    {
+        while(nd->parent != nullptr)
+        {
+            node* parent = nd->parent;
+            node* grandparent = parent->parent;
+            if(grandparent != nullptr)
+                rotateUp((grandparent->left == parent) == (parent->left == nd) ? parent : nd);
+            rotateUp(nd);
+        }
+    }
+
+    //Rotate *nd* above its parent
+    void rotateUp(node* nd)
+    {
+        if(nd->parent->left == nd) rotateRight(nd->parent);
+        else rotateLeft(nd->parent);
+    }
+
+    //Rebalance from *nd* up to the root, stopping as soon as a subtree keeps its old height
+    void rebalanceUpwards(node* nd)
+    {
+        while(nd != nullptr)
+        {
+            int oldHeight = nd->height;
+            nd = rebalance(nd);
+            if(nd->height == oldHeight) return;
+            nd = nd->parent;
         }
     }
 
+public:
+    //Add the number of nodes in the given subtree to *s*
     void size(node* nd, size_type &s) const
     {
-        if(nd == nullptr || nd == sentinel) return;
-        size(nd->left, s);
-        ++s;
-        size(nd->right, s);
+        s += countOf(nd);
     }
 
     size_type getSize() const
     {
-        size_type temp = 0;
-        size(root, temp);
-        return temp;
+        return countOf(root);
+    }
+
+    //Number of keys smaller than *key*, which needn't be in the map
+    size_type rank(const key_type& key) const
+    {
+        size_type smaller = 0;
+        node* nd = root;
+        while(nd != nullptr && nd != sentinel)
+        {
+            if(nd->val.first < key)
+            {
+                smaller += countOf(nd->left) + 1;
+                nd = nd->right;
+            }
+            else nd = nd->left;
+        }
+        return smaller;
+    }
+
+    //Iterator to the element at position *index* in key order, counting from 0
+    const_iterator select(size_type index) const
+    {
+        if(index >= getSize()) throw std::out_of_range("Index is out of range");
+        node* nd = root;
+        for(;;)
+        {
+            size_type left = countOf(nd->left);
+            if(index == left) return const_iterator(this, nd);
+            if(index < left) nd = nd->left;
+            else
+            {
+                index -= left + 1;
+                nd = nd->right;
+            }
+        }
+    }
+
+    iterator select(size_type index)
+    {
+        return iterator(static_cast<const TreeMap*>(this)->select(index));
+    }
+
+    //Number of keys in [*low*, *high*)
+    size_type countRange(const key_type& low, const key_type& high) const
+    {
+        if(!(low < high)) return 0;
+        return rank(high) - rank(low);
     }
 
     bool operator==(const TreeMap& other) const
@@ -343,10 +1302,7 @@ public:
 
     const_iterator cbegin() const
     {
-        node *temp = root;
-        while(temp->left != nullptr)
-            temp = temp->left;
-        return const_iterator(this, temp);
+        return const_iterator(this, sentinel->next);
     }
 
     const_iterator cend() const
@@ -366,27 +1322,37 @@ public:
     }
 };
 
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::Node
+template <typename KeyType, typename ValueType, typename Allocator, typename BalancePolicy>
+class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>::Node
 {
 public:
-    friend class TreeMap<KeyType, ValueType>;
+    friend class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>;
     using key_type = KeyType;
     using mapped_type = ValueType;
     using value_type = std::pair<const key_type, mapped_type>;
 
 private:
     Node *parent, *left, *right;
+    Node *prev, *next; //neighbours in key order, the sentinel closes the ring
+    int height; //of the subtree rooted here
+    std::size_t count; //nodes in the subtree rooted here
     value_type val;
 
 public:
-    Node(Node *p=nullptr): parent(p), left(nullptr), right(nullptr)
+    Node(Node *p=nullptr): parent(p), left(nullptr), right(nullptr), prev(nullptr), next(nullptr), height(1), count(1)
+    {}
+
+    Node(key_type key, Node *p=nullptr): parent(p), left(nullptr), right(nullptr), prev(nullptr), next(nullptr), height(1), count(1),
+        val(value_type(key, mapped_type()))
     {}
 
-    Node(key_type key, Node *p=nullptr): parent(p), left(nullptr), right(nullptr), val(value_type(key, mapped_type()))
+    Node(value_type v, Node *p): parent(p), left(nullptr), right(nullptr), prev(nullptr), next(nullptr), height(1), count(1), val(std::move(v))
     {}
 
-    Node(value_type v, Node *p): parent(p), left(nullptr), right(nullptr), val(v)
+    //The key is copied before *value* is taken, so a throwing key copy leaves *value* where it was
+    template <typename V>
+    Node(const key_type& key, V&& value, Node *p): parent(p), left(nullptr), right(nullptr), prev(nullptr), next(nullptr), height(1), count(1),
+        val(key, std::forward<V>(value))
     {}
 
     ~Node()
@@ -397,17 +1363,18 @@ public:
 };
 
 
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename Allocator, typename BalancePolicy>
+class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>::ConstIterator
 {
 public:
-    friend class TreeMap<KeyType, ValueType>;
+    friend class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>;
     using reference = typename TreeMap::const_reference;
     using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
     using value_type = typename TreeMap::value_type;
     using pointer = const typename TreeMap::value_type*;
-    using node = TreeMap<KeyType, ValueType>::Node;
-    using tree_map = TreeMap<KeyType, ValueType>;
+    using node = typename TreeMap::Node;
+    using tree_map = TreeMap<KeyType, ValueType, Allocator, BalancePolicy>;
 
 private:
     node *current;
@@ -427,26 +1394,7 @@ public:
             throw std::out_of_range("Cannot increment iterator");
             return *this;
         }
-
-        node *temp;
-        if(current->right != nullptr)
-        {
-            temp = current->right;
-            while(temp->left != nullptr)
-                temp = temp->left;
-            current = temp;
-        }
-        else if(current->parent != nullptr)
-        {
-            temp = current;
-            while(temp->parent != nullptr && temp->parent->right == temp)
-                temp = temp->parent;
-            if(temp->parent != nullptr)
-                current = temp->parent;
-            else throw std::out_of_range("Cannot increment iterator");
-        }
-        else throw std::out_of_range("Cannot increment iterator");
-
+        current = current->next;
         return *this;
     }
 
@@ -464,26 +1412,7 @@ public:
             throw std::out_of_range("Cannot decrement iterator");
             return *this;
         }
-
-        node *temp;
-        if(current->left != nullptr)
-        {
-            temp = current->left;
-            while(temp->right != nullptr)
-                temp = temp->right;
-            current = temp;
-        }
-        else if(current->parent != nullptr)
-        {
-            temp = current;
-            while(temp->parent != nullptr && temp->parent->left == temp)
-                temp = temp->parent;
-            if(temp->parent != nullptr)
-                current = temp->parent;
-            else throw std::out_of_range("Cannot increment iterator");
-        }
-        else throw std::out_of_range("Cannot increment iterator");
-
+        current = current->prev;
         return *this;
     }
 
@@ -522,11 +1451,41 @@ private:
     }
 };
 
-template <typename KeyType, typename ValueType>
-class TreeMap<KeyType, ValueType>::Iterator : public TreeMap<KeyType, ValueType>::ConstIterator
+template <typename KeyType, typename ValueType, typename Allocator, typename BalancePolicy>
+template <typename It>
+class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>::Range
+{
+public:
+    using iterator = It;
+
+private:
+    iterator first, last;
+
+public:
+    Range(const iterator& f, const iterator& l): first(f), last(l)
+    {}
+
+    iterator begin() const
+    {
+        return first;
+    }
+
+    iterator end() const
+    {
+        return last;
+    }
+
+    bool isEmpty() const
+    {
+        return first == last;
+    }
+};
+
+template <typename KeyType, typename ValueType, typename Allocator, typename BalancePolicy>
+class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>::Iterator : public TreeMap<KeyType, ValueType, Allocator, BalancePolicy>::ConstIterator
 {
 public:
-    friend class TreeMap<KeyType, ValueType>;
+    friend class TreeMap<KeyType, ValueType, Allocator, BalancePolicy>;
     using reference = typename TreeMap::reference;
     using pointer = typename TreeMap::value_type*;
 
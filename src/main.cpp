@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdlib>
 #include <string>
@@ -5,9 +8,19 @@
 #include <ctime>
 #include <vector>
 #include <chrono>
+#include <mutex>
+#include <thread>
+#include <random>
 
 #include "TreeMap.h"
 #include "HashMap.h"
+#include "ShardedMap.h"
+#include "ConcurrentHashMap.h"
+#include "BPlusTreeMap.h"
+#include "FrozenTreeMap.h"
+#include "ConcurrentSkipListMap.h"
+#include "ConcurrentTreeMap.h"
+#include "PersistentTreeMap.h"
 namespace
 {
     using std::cout;
@@ -20,63 +33,853 @@ namespace
     template <typename K, typename V>
     using HashMap = aisdi::HashMap<K, V>;
 
-} // namespace
+    template <typename K, typename V>
+    using RobinHoodHashMap = aisdi::RobinHoodHashMap<K, V>;
 
-int main(int argc, char* argv[])
-{
-    srand(time(0));
-    long long NUM;
-    if(argc > 1) NUM = std::atoll(argv[1]);
-    else
+    template <typename K, typename V>
+    using SwissHashMap = aisdi::SwissHashMap<K, V>;
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    long long millisecondsSince(Clock::time_point start)
     {
-        cout << "Usage: aisdiMaps <number_of_elements>" << endl;
-        return 1;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    }
+
+    //Add, iterate and find all pairs of *testSet* in a map of type *Map*
+    template <typename Map>
+    void testMap(const char* name, const vector<pair<long long, long long>>& testSet)
+    {
+        cout << "Testing " << name << endl;
+        auto start_time = Clock::now();
+
+        Map map;
+
+        for(const pair<long long, long long>& val : testSet)
+            map[val.first] = val.second;
+        cout << "...finished adding" << endl;
+
+        for(auto it = map.begin(); it!=map.end(); ++it)
+            if(it->first % 10000 == 0) cout << it->first << " ";
+        cout << endl << "...finished iteration" << endl;
+
+        for(const pair<long long, long long>& val : testSet)
+            map.find(val.first);
+        cout << "...finished finding" << endl << endl;
+
+        cout << "Test run for: " << millisecondsSince(start_time) << " milliseconds" << endl << endl << endl;
+    }
+
+    //Add, iterate and find *NUM* random pairs in every map
+    void compareMaps(long long NUM)
+    {
+        vector <pair<long long, long long>> testSet;
+        for(long long i = 0; i < NUM; ++i)
+            testSet.push_back(std::make_pair((rand() % NUM), (rand() % NUM)));
+
+        testMap<TreeMap<long long, long long>>("TreeMap", testSet);
+        testMap<HashMap<long long, long long>>("HashMap", testSet);
+        testMap<RobinHoodHashMap<long long, long long>>("RobinHoodHashMap", testSet);
+        testMap<SwissHashMap<long long, long long>>("SwissHashMap", testSet);
     }
-    vector <pair<long long, long long>> testSet;
-    for(long long i = 0; i < NUM; ++i)
-        testSet.push_back(std::make_pair((rand() % NUM), (rand() % NUM)));
 
-    cout << "Testing TreeMap" << endl;
-    auto start_time = std::chrono::high_resolution_clock::now();
+    //Look up random keys of which only every tenth is in the map
+    template <typename Map>
+    void testMissingKeys(const char* name, const vector<long long>& keys, const vector<long long>& queries)
+    {
+        Map map;
+        for(long long key : keys)
+            map[key] = key;
 
-    TreeMap<long long, long long> tree;
+        auto start_time = Clock::now();
+        long long found = 0;
+        for(long long key : queries)
+            if(map.find(key) != map.end()) ++found;
+        cout << name << ": " << found << " found in " << millisecondsSince(start_time) << " milliseconds" << endl;
+    }
 
-    for(long long i = 0; i < NUM; ++i)
-        tree[testSet[i].first] = testSet[i].second;
-    cout << "...finished adding" << endl;
+    void compareMissingKeys(long long NUM)
+    {
+        vector<long long> keys, queries;
+        for(long long i = 0; i < NUM * 10; ++i)
+        {
+            long long key = (static_cast<long long>(rand()) << 31) ^ rand();
+            if(i % 10 == 0) keys.push_back(key);
+            queries.push_back(key);
+        }
 
-    for(auto it = tree.begin(); it!=tree.end(); ++it)
-        if(it->first % 10000 == 0) cout << it->first << " ";
-    cout << endl << "...finished iteration" << endl;
+        cout << "Testing lookups of mostly missing keys" << endl;
+        testMissingKeys<HashMap<long long, long long>>("HashMap", keys, queries);
+        testMissingKeys<RobinHoodHashMap<long long, long long>>("RobinHoodHashMap", keys, queries);
+        testMissingKeys<SwissHashMap<long long, long long>>("SwissHashMap", keys, queries);
+    }
 
-    for(std::pair <long long, long long> val : testSet)
-        tree.find(val.first);
-    cout << "...finished finding" << endl << endl;
+    //Insert *NUM* keys one by one and report the slowest single insertion
+    void measureInsertLatency(long long NUM, bool incremental)
+    {
+        HashMap<long long, long long> hash;
+        hash.setIncrementalRehash(incremental);
 
-    auto current_time = std::chrono::high_resolution_clock::now();
-    cout << "Test run for: " << std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count()
-        << " milliseconds" << endl;
+        Clock::duration worst = Clock::duration::zero();
+        auto start_time = Clock::now();
+        for(long long i = 0; i < NUM; ++i)
+        {
+            auto op_start = Clock::now();
+            hash[i] = i;
+            auto op_time = Clock::now() - op_start;
+            if(op_time > worst) worst = op_time;
+        }
 
-    cout << endl << endl << "Testing HashMap" << endl;
-    start_time = std::chrono::high_resolution_clock::now();
-    HashMap<long long, long long> hash;
+        cout << (incremental ? "Incremental" : "Stop-the-world") << " rehash: total "
+            << millisecondsSince(start_time) << " milliseconds, worst insert "
+            << std::chrono::duration_cast<std::chrono::microseconds>(worst).count() << " microseconds" << endl;
+    }
 
+    //Let the allocator settle after a previous run freed its nodes, so it doesn't skew the next one
+    void warmUpAllocator()
+    {
+        HashMap<long long, long long> warmUp;
+        for(long long i = 0; i < 1000; ++i)
+            warmUp[i] = i;
+    }
 
-    for(long long i = 0; i < NUM; ++i)
-        hash[testSet[i].first] = testSet[i].second;
-    cout << "...finished adding" << endl;
+    void compareRehashLatency(long long NUM)
+    {
+        cout << "Testing HashMap insert latency" << endl;
+        measureInsertLatency(NUM, false);
+        warmUpAllocator();
+        measureInsertLatency(NUM, true);
+    }
+
+    //Insert and find keys spaced 2^20 apart, which defeat a plain modulo of an identity hash
+    template <typename Map>
+    void testStridedKeys(const char* name, long long NUM)
+    {
+        auto start_time = Clock::now();
+        Map map;
+        for(long long i = 0; i < NUM; ++i)
+            map[i << 20] = i;
+        for(long long i = 0; i < NUM; ++i)
+            map.find(i << 20);
+        cout << name << ": " << millisecondsSince(start_time) << " milliseconds" << endl;
+    }
+
+    void compareHashers(long long NUM)
+    {
+        cout << "Testing strided keys" << endl;
+        testStridedKeys<HashMap<long long, long long>>("HashMap, std::hash", NUM);
+        testStridedKeys<aisdi::HashMap<long long, long long, aisdi::ChainedStorage, aisdi::FastHash<long long>>>(
+            "HashMap, FastHash", NUM);
+        testStridedKeys<SwissHashMap<long long, long long>>("SwissHashMap, std::hash", NUM);
+        testStridedKeys<aisdi::SwissHashMap<long long, long long, aisdi::FastHash<long long>>>(
+            "SwissHashMap, FastHash", NUM);
+    }
+
+    //Fill a map with *NUM* random keys and destroy it, timing both
+    template <typename Map>
+    void testAllocation(const char* name, const vector<long long>& keys)
+    {
+        auto start_time = Clock::now();
+        {
+            Map map;
+            for(long long key : keys)
+                map[key] = key;
+            cout << name << ": filled in " << millisecondsSince(start_time) << " milliseconds";
+            start_time = Clock::now();
+        }
+        cout << ", destroyed in " << millisecondsSince(start_time) << " milliseconds" << endl;
+    }
+
+    void compareAllocators(long long NUM)
+    {
+        using Pool = aisdi::PoolAllocator<std::pair<const long long, long long>>;
+        using HugePagePool = aisdi::PoolAllocator<std::pair<const long long, long long>, true>;
+        using Hash = std::hash<long long>;
+        using Equal = std::equal_to<long long>;
+
+        vector<long long> keys;
+        for(long long i = 0; i < NUM; ++i)
+            keys.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+
+        cout << "Testing node allocators" << endl;
+        testAllocation<HashMap<long long, long long>>("HashMap, std::allocator", keys);
+        testAllocation<aisdi::HashMap<long long, long long, aisdi::ChainedStorage, Hash, Equal, Pool>>(
+            "HashMap, PoolAllocator", keys);
+        testAllocation<aisdi::HashMap<long long, long long, aisdi::ChainedStorage, Hash, Equal, HugePagePool>>(
+            "HashMap, PoolAllocator with huge pages", keys);
+        testAllocation<TreeMap<long long, long long>>("TreeMap, std::allocator", keys);
+        testAllocation<aisdi::TreeMap<long long, long long, Pool>>("TreeMap, PoolAllocator", keys);
+    }
+
+    //A map behind one global mutex, the baseline for ShardedMap and the concurrent maps
+    template <typename Map>
+    class GlobalLockMap
+    {
+        std::mutex mutex;
+        Map map;
+
+    public:
+        void insert(long long key, long long value)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            map[key] = value;
+        }
+
+        bool find(long long key, long long& value)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            auto it = map.find(key);
+            if(it == map.end()) return false;
+            value = it->second;
+            return true;
+        }
+    };
+
+    //Split *NUM* operations (one insert for every *writeEvery* operations, lookups otherwise) among
+    // *threads* threads working on *map* and report the throughput
+    template <typename Map>
+    void testThroughput(const char* name, Map& map, long long NUM, int threads, int writeEvery = 10)
+    {
+        auto start_time = Clock::now();
+        vector<std::thread> workers;
+        for(int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&map, NUM, threads, writeEvery, t]()
+            {
+                unsigned long long state = 0x9E3779B97F4A7C15ull * (t + 1);
+                long long found = 0, value;
+                for(long long i = t; i < NUM; i += threads)
+                {
+                    state = state * 6364136223846793005ull + 1442695040888963407ull;
+                    long long key = static_cast<long long>((state >> 33) % NUM);
+                    if(i % writeEvery == 0) map.insert(key, i);
+                    else if(map.find(key, value)) ++found;
+                }
+                if(found < 0) cout << found;
+            });
+        }
+        for(std::thread& worker : workers)
+            worker.join();
+
+        long long ms = millisecondsSince(start_time);
+        cout << name << ", " << threads << " threads: " << ms << " milliseconds, "
+            << (ms > 0 ? NUM / ms : NUM) << " operations per millisecond" << endl;
+    }
+
+    void compareThroughput(long long NUM)
+    {
+        cout << "Testing concurrent throughput (hardware threads: " << std::thread::hardware_concurrency() << ")" << endl;
+        for(int threads = 1; threads <= 64; threads *= 2)
+        {
+            GlobalLockMap<HashMap<long long, long long>> global;
+            aisdi::ShardedMap<HashMap<long long, long long>, 64> sharded;
+            testThroughput("HashMap with a global mutex", global, NUM, threads);
+            testThroughput("ShardedMap<HashMap, 64>", sharded, NUM, threads);
+        }
+    }
+
+    //99% lookups on a map filled with every other key, where lock-free readers should pay off
+    void compareReadHeavy(long long NUM)
+    {
+        cout << "Testing read-heavy throughput (hardware threads: " << std::thread::hardware_concurrency() << ")" << endl;
+        for(int threads = 1; threads <= 64; threads *= 2)
+        {
+            aisdi::ShardedMap<HashMap<long long, long long>, 64> sharded;
+            aisdi::ConcurrentHashMap<long long, long long> concurrent;
+            for(long long key = 0; key < NUM; key += 2)
+            {
+                sharded.insert(key, key);
+                concurrent.insert(key, key);
+            }
+            //Free the tables outgrown while filling now rather than during the measurement
+            for(int i = 0; i < 3; ++i)
+                aisdi::EpochManager::instance().collect();
+            testThroughput("ShardedMap<HashMap, 64>", sharded, NUM, threads, 100);
+            testThroughput("ConcurrentHashMap", concurrent, NUM, threads, 100);
+        }
+    }
+
+    //Same mix as compareThroughput on ordered maps, starting from a map filled with every other key
+    void compareOrderedThroughput(long long NUM)
+    {
+        cout << "Testing ordered map throughput (hardware threads: " << std::thread::hardware_concurrency() << ")" << endl;
+        for(int threads = 1; threads <= 64; threads *= 2)
+        {
+            GlobalLockMap<TreeMap<long long, long long>> global;
+            aisdi::ConcurrentSkipListMap<long long, long long> skipList;
+            for(long long key = 0; key < NUM; key += 2)
+            {
+                global.insert(key, key);
+                skipList.insert(key, key);
+            }
+            testThroughput("TreeMap with a global mutex", global, NUM, threads);
+            testThroughput("ConcurrentSkipListMap", skipList, NUM, threads);
+        }
+    }
+
+    //Split *NUM* lookups among *readers* threads while one more thread keeps adding keys to *map*,
+    // and report the lookup throughput
+    template <typename Map>
+    void testReadersWithWriter(const char* name, Map& map, long long NUM, int readers)
+    {
+        std::atomic<bool> done(false);
+        std::thread writer([&map, &done, NUM]()
+        {
+            for(long long key = 1; !done.load(std::memory_order_relaxed); key = (key + 2) % NUM)
+                map.insert(key, key);
+        });
+
+        auto start_time = Clock::now();
+        vector<std::thread> workers;
+        for(int t = 0; t < readers; ++t)
+        {
+            workers.emplace_back([&map, NUM, readers, t]()
+            {
+                unsigned long long state = 0x9E3779B97F4A7C15ull * (t + 1);
+                long long found = 0, value;
+                for(long long i = t; i < NUM; i += readers)
+                {
+                    state = state * 6364136223846793005ull + 1442695040888963407ull;
+                    if(map.find(static_cast<long long>((state >> 33) % NUM), value)) ++found;
+                }
+                if(found < 0) cout << found;
+            });
+        }
+        for(std::thread& worker : workers)
+            worker.join();
+        long long ms = millisecondsSince(start_time);
+        done = true;
+        writer.join();
+
+        cout << name << ", " << readers << " readers: " << ms << " milliseconds, "
+            << (ms > 0 ? NUM / ms : NUM) << " lookups per millisecond" << endl;
+    }
+
+    void compareReadersWithWriter(long long NUM)
+    {
+        cout << "Testing lookups during updates (hardware threads: " << std::thread::hardware_concurrency() << ")" << endl;
+        for(int readers = 1; readers <= 64; readers *= 2)
+        {
+            GlobalLockMap<TreeMap<long long, long long>> global;
+            aisdi::ConcurrentSkipListMap<long long, long long> skipList;
+            aisdi::ConcurrentTreeMap<long long, long long> optimistic;
+            for(long long key = 0; key < NUM; key += 2)
+            {
+                global.insert(key, key);
+                skipList.insert(key, key);
+                optimistic.insert(key, key);
+            }
+            testReadersWithWriter("TreeMap with a global mutex", global, NUM, readers);
+            testReadersWithWriter("ConcurrentSkipListMap", skipList, NUM, readers);
+            testReadersWithWriter("ConcurrentTreeMap", optimistic, NUM, readers);
+        }
+    }
+
+    //Fill a map with *keys* in the given order and look all of them up
+    template <typename Map>
+    void testLoadOrder(const char* name, const vector<long long>& keys)
+    {
+        auto start_time = Clock::now();
+        Map map;
+        for(long long key : keys)
+            map[key] = key;
+        long long loaded = millisecondsSince(start_time);
+        start_time = Clock::now();
+        long long found = 0;
+        for(long long key : keys)
+            if(map.find(key) != map.end()) ++found;
+        cout << name << ": loaded in " << loaded << " milliseconds, " << found << " found in "
+            << millisecondsSince(start_time) << " milliseconds" << endl;
+    }
+
+    void compareLoadOrders(long long NUM)
+    {
+        vector<long long> sorted, reversed, shuffled;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            sorted.push_back(i);
+            reversed.push_back(NUM - i);
+            shuffled.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+        }
+
+        cout << "Testing TreeMap load order" << endl;
+        testLoadOrder<TreeMap<long long, long long>>("TreeMap, sorted", sorted);
+        testLoadOrder<TreeMap<long long, long long>>("TreeMap, reverse-sorted", reversed);
+        testLoadOrder<TreeMap<long long, long long>>("TreeMap, random", shuffled);
+    }
+
+    std::size_t allocatedBytes = 0;
+
+    //std::allocator that keeps count of the bytes in use in allocatedBytes
+    template <typename T>
+    struct CountingAllocator
+    {
+        using value_type = T;
 
-    for(auto it = hash.begin(); it!=hash.end(); ++it)
-        if(it->first % 10000 == 0) cout << it->first << " ";
-    cout << endl << "...finished iteration" << endl;
+        CountingAllocator()
+        {}
 
-    for(std::pair <long long, long long> val : testSet)
-        hash.find(val.first);
-    cout << "...finished finding" << endl << endl;
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>&)
+        {}
 
-    current_time = std::chrono::high_resolution_clock::now();
-    cout << "Test run for: " << std::chrono::duration_cast<std::chrono::milliseconds>(current_time - start_time).count()
-        << " milliseconds" << endl;
+        T* allocate(std::size_t n)
+        {
+            allocatedBytes += n * sizeof(T);
+            return std::allocator<T>().allocate(n);
+        }
 
-    return 0;
+        void deallocate(T* p, std::size_t n)
+        {
+            allocatedBytes -= n * sizeof(T);
+            std::allocator<T>().deallocate(p, n);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U>&) const
+        {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(const CountingAllocator<U>&) const
+        {
+            return false;
+        }
+    };
+
+    //Fill an ordered map with *keys*, then look all of them up and scan it in order
+    template <typename Map>
+    void testOrderedMap(const char* name, const vector<long long>& keys)
+    {
+        allocatedBytes = 0;
+        Map map;
+        auto start_time = Clock::now();
+        for(long long key : keys)
+            map[key] = key;
+        cout << name << ": filled in " << millisecondsSince(start_time) << " milliseconds, "
+            << allocatedBytes / map.getSize() << " bytes per element" << endl;
+
+        start_time = Clock::now();
+        long long found = 0;
+        for(long long key : keys)
+            if(map.find(key) != map.end()) ++found;
+        cout << "    " << found << " found in " << millisecondsSince(start_time) << " milliseconds" << endl;
+
+        start_time = Clock::now();
+        long long sum = 0;
+        for(int i = 0; i < 10; ++i)
+            for(auto it = map.begin(); it != map.end(); ++it)
+                sum += it->second;
+        cout << "    10 scans in " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+    }
+
+    void compareOrderedMaps(long long NUM)
+    {
+        using Counting = CountingAllocator<std::pair<const long long, long long>>;
+        vector<long long> keys;
+        for(long long i = 0; i < NUM; ++i)
+            keys.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+
+        cout << "Testing ordered maps" << endl;
+        testOrderedMap<aisdi::TreeMap<long long, long long, Counting>>("TreeMap", keys);
+        testOrderedMap<aisdi::BPlusTreeMap<long long, long long, Counting>>("BPlusTreeMap", keys);
+    }
+
+    //Percentile queries: the element at each percent of the key order, by walking from begin()
+    // and by select()
+    void comparePercentiles(long long NUM)
+    {
+        TreeMap<long long, long long> map;
+        for(long long i = 0; i < NUM; ++i)
+            map[(static_cast<long long>(rand()) << 31) ^ rand()] = i;
+        const std::size_t size = map.getSize();
+
+        cout << "Testing percentile queries" << endl;
+        auto start_time = Clock::now();
+        long long sum = 0;
+        for(std::size_t percent = 0; percent < 100; ++percent)
+        {
+            auto it = map.begin();
+            for(std::size_t i = size * percent / 100; i > 0; --i)
+                ++it;
+            sum += it->first;
+        }
+        cout << "Walking: " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+
+        start_time = Clock::now();
+        sum = 0;
+        for(int round = 0; round < 1000; ++round)
+            for(std::size_t percent = 0; percent < 100; ++percent)
+                sum += map.select(size * percent / 100)->first;
+        cout << "Select, 1000 rounds: " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+
+        start_time = Clock::now();
+        std::size_t below = 0;
+        for(int round = 0; round < 100000; ++round)
+            below += map.rank((static_cast<long long>(rand()) << 31) ^ rand());
+        cout << "100000 ranks: " << millisecondsSince(start_time) << " milliseconds (" << below / 100000 << " below on average)" << endl;
+    }
+
+    //Time-window queries over consecutive keys, by filtering a walk over the whole map and by rangeOf()
+    void compareRangeQueries(long long NUM)
+    {
+        TreeMap<long long, long long> map;
+        for(long long i = 0; i < NUM; ++i)
+            map[i] = i;
+        const long long WIDTH = 100;
+
+        cout << "Testing range queries of " << WIDTH << " keys" << endl;
+        auto start_time = Clock::now();
+        long long sum = 0;
+        for(int query = 0; query < 10; ++query)
+        {
+            long long low = rand() % NUM;
+            for(auto it = map.begin(); it != map.end(); ++it)
+                if(it->first >= low && it->first < low + WIDTH) sum += it->second;
+        }
+        cout << "Filtering, 10 queries: " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+
+        start_time = Clock::now();
+        sum = 0;
+        for(int query = 0; query < 100000; ++query)
+        {
+            long long low = rand() % NUM;
+            for(const auto& item : map.rangeOf(low, low + WIDTH))
+                sum += item.second;
+        }
+        cout << "Range view, 100000 queries: " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+    }
+
+    //Restoring a map from a snapshot: item by item, and by bulk loading
+    void compareBulkLoads(long long NUM)
+    {
+        vector<pair<long long, long long>> sorted, shuffled;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            sorted.emplace_back(i, i);
+            shuffled.emplace_back((static_cast<long long>(rand()) << 31) ^ rand(), i);
+        }
+
+        cout << "Testing bulk loads" << endl;
+        for(const auto* items : { &sorted, &shuffled })
+        {
+            const char* order = items == &sorted ? "sorted" : "random";
+            auto start_time = Clock::now();
+            {
+                TreeMap<long long, long long> map;
+                for(const auto& item : *items)
+                    map[item.first] = item.second;
+                cout << "TreeMap, " << order << ", operator[]: " << millisecondsSince(start_time) << " milliseconds, height "
+                    << map.getHeight() << endl;
+            }
+
+            start_time = Clock::now();
+            {
+                auto map = items == &sorted ? TreeMap<long long, long long>::fromSorted(items->begin(), items->end())
+                    : TreeMap<long long, long long>::fromUnsorted(items->begin(), items->end());
+                cout << "TreeMap, " << order << ", " << (items == &sorted ? "fromSorted" : "fromUnsorted") << ": "
+                    << millisecondsSince(start_time) << " milliseconds, height " << map.getHeight() << endl;
+            }
+        }
+    }
+
+    //Lookups in a TreeMap and in a FrozenTreeMap made of it, in random order
+    void compareFrozenLookups(long long NUM)
+    {
+        vector<long long> keys;
+        TreeMap<long long, long long> map;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            keys.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+            map[keys.back()] = i;
+        }
+        auto start_time = Clock::now();
+        const aisdi::FrozenTreeMap<long long, long long> frozen(map);
+        cout << "Testing frozen lookups" << endl << "Frozen in " << millisecondsSince(start_time) << " milliseconds" << endl;
+
+        for(int round = 0; round < 2; ++round)
+        {
+            start_time = Clock::now();
+            long long sum = 0;
+            for(long long key : keys)
+                sum += map.valueOf(key);
+            cout << "TreeMap: " << keys.size() << " found in " << millisecondsSince(start_time) << " milliseconds (sum "
+                << sum << ")" << endl;
+
+            start_time = Clock::now();
+            sum = 0;
+            for(long long key : keys)
+                sum += frozen.valueOf(key);
+            cout << "FrozenTreeMap: " << keys.size() << " found in " << millisecondsSince(start_time)
+                << " milliseconds (sum " << sum << ")" << endl;
+        }
+
+        start_time = Clock::now();
+        long long sum = 0;
+        for(const auto& item : frozen)
+            sum += item.second;
+        cout << "FrozenTreeMap: scanned in " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+    }
+
+    //Lookups and a scan in a tree whose nodes were scattered by churn, before and after compact()
+    template <typename Map>
+    void testCompaction(const char* name, long long NUM)
+    {
+        cout << "Testing " << name << endl;
+        std::mt19937_64 random(rand());
+        vector<long long> keys;
+        Map map;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            keys.push_back(static_cast<long long>(random() >> 1));
+            map[keys.back()] = i;
+        }
+        //Replace every key once, in random order, so old and new nodes end up interleaved
+        for(long long i = 0; i < NUM; ++i)
+        {
+            long long& key = keys[random() % keys.size()];
+            map.remove(key);
+            key = static_cast<long long>(random() >> 1);
+            map[key] = i;
+        }
+        std::shuffle(keys.begin(), keys.end(), random);
+
+        for(int round = 0; round < 2; ++round)
+        {
+            auto start_time = Clock::now();
+            long long sum = 0;
+            for(long long key : keys)
+                sum += map.valueOf(key);
+            cout << (round == 0 ? "Churned" : "Compacted") << ": " << keys.size() << " found in "
+                << millisecondsSince(start_time) << " milliseconds (sum " << sum << "), height " << map.getHeight();
+            start_time = Clock::now();
+            sum = 0;
+            for(const auto& item : map)
+                sum += item.second;
+            cout << ", scanned in " << millisecondsSince(start_time) << " milliseconds (sum " << sum << ")" << endl;
+
+            if(round == 0)
+            {
+                start_time = Clock::now();
+                map.compact();
+                cout << "Compacted in " << millisecondsSince(start_time) << " milliseconds" << endl;
+            }
+        }
+    }
+
+    void compareCompaction(long long NUM)
+    {
+        using Pool = aisdi::PoolAllocator<std::pair<const long long, long long>>;
+        testCompaction<TreeMap<long long, long long>>("TreeMap", NUM);
+        testCompaction<aisdi::TreeMap<long long, long long, Pool>>("TreeMap, PoolAllocator", NUM);
+    }
+
+    //Ten rounds of keeping a copy of *map* and changing a tenth of its keys, as a report
+    // generator taking point-in-time views of a live map would, then a lookup of every key
+    template <typename Map>
+    void testSnapshots(const char* name, const vector<long long>& keys)
+    {
+        const int ROUNDS = 10;
+        Map map;
+        for(long long key : keys)
+            map[key] = key;
+
+        vector<Map> snapshots;
+        long long copying = 0;
+        auto start_time = Clock::now();
+        for(int round = 0; round < ROUNDS; ++round)
+        {
+            auto copy_time = Clock::now();
+            snapshots.push_back(map);
+            copying += millisecondsSince(copy_time);
+            for(std::size_t i = round; i < keys.size(); i += ROUNDS)
+                map[keys[i]] = round;
+        }
+        long long updating = millisecondsSince(start_time);
+
+        start_time = Clock::now();
+        long long sum = 0;
+        for(long long key : keys)
+            sum += map.valueOf(key);
+        cout << name << ": " << ROUNDS << " copies in " << copying << " milliseconds, with the updates "
+            << updating << " milliseconds; lookups " << millisecondsSince(start_time) << " milliseconds (sum "
+            << sum << ")" << endl;
+    }
+
+    void compareSnapshots(long long NUM)
+    {
+        vector<long long> keys;
+        for(long long i = 0; i < NUM; ++i)
+            keys.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+        cout << "Testing point-in-time copies of a changing map" << endl;
+        testSnapshots<TreeMap<long long, long long>>("TreeMap", keys);
+        testSnapshots<aisdi::PersistentTreeMap<long long, long long>>("PersistentTreeMap", keys);
+    }
+
+    //Union, intersection and difference of two maps of random keys, half of them shared, item by
+    // item and with the join-based set operations
+    void compareSetOperations(long long NUM)
+    {
+        std::mt19937_64 random(rand());
+        TreeMap<long long, long long> first, second;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            long long key = static_cast<long long>(random() >> 1);
+            first[key] = i;
+            second[i % 2 == 0 ? key : static_cast<long long>(random() >> 1)] = i;
+        }
+        auto sum = [](long long mine, long long theirs) { return mine + theirs; };
+        cout << "Testing set operations on " << aisdi::ThreadPool::instance().getThreadCount() << " threads" << endl;
+        //The join-based operations free the nodes of the map they consume, which counts in their times
+        {
+            TreeMap<long long, long long> copy = second;
+            auto start_time = Clock::now();
+            copy = TreeMap<long long, long long>();
+            cout << "Freeing the second map: " << millisecondsSince(start_time) << " milliseconds" << endl;
+        }
+
+        TreeMap<long long, long long> map = first;
+        auto start_time = Clock::now();
+        for(const auto& item : second)
+            map[item.first] += item.second;
+        cout << "Union item by item: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize() << " items" << endl;
+        map = first;
+        TreeMap<long long, long long> other = second;
+        start_time = Clock::now();
+        map.unionWith(std::move(other), sum);
+        cout << "Union by joins: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize() << " items" << endl;
+
+        map = first;
+        start_time = Clock::now();
+        for(auto it = map.begin(); it != map.end();)
+        {
+            auto found = second.find(it->first);
+            if(found == second.end()) map.remove(it++);
+            else (it++)->second += found->second;
+        }
+        cout << "Intersection item by item: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize()
+            << " items" << endl;
+        map = first;
+        other = second;
+        start_time = Clock::now();
+        map.intersectWith(std::move(other), sum);
+        cout << "Intersection by joins: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize()
+            << " items" << endl;
+
+        map = first;
+        start_time = Clock::now();
+        for(const auto& item : second)
+            if(map.find(item.first) != map.end()) map.remove(item.first);
+        cout << "Difference item by item: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize()
+            << " items" << endl;
+        map = first;
+        other = second;
+        start_time = Clock::now();
+        map.difference(std::move(other));
+        cout << "Difference by joins: " << millisecondsSince(start_time) << " milliseconds, " << map.getSize()
+            << " items" << endl;
+    }
+
+    //Lookups of keys drawn from a Zipf distribution (the key of rank r has weight 1 / r^1.2, so the
+    // top 1% of keys take about 90% of lookups) in the AVL and in the splay tree
+    template <typename Map>
+    void testSkewedLookups(const char* name, const vector<long long>& keys, const vector<long long>& lookups)
+    {
+        Map map;
+        for(long long key : keys)
+            map[key] = key;
+
+        auto start_time = Clock::now();
+        long long sum = 0;
+        for(long long key : lookups)
+            sum += map.valueOf(key);
+        cout << name << ": " << lookups.size() << " lookups in " << millisecondsSince(start_time)
+            << " milliseconds (sum " << sum << "), height " << map.getHeight() << endl;
+    }
+
+    void compareSkewedLookups(long long NUM)
+    {
+        const double EXPONENT = 1.2;
+        vector<long long> keys;
+        vector<double> cumulative;
+        double total = 0;
+        for(long long i = 0; i < NUM; ++i)
+        {
+            keys.push_back((static_cast<long long>(rand()) << 31) ^ rand());
+            total += 1 / std::pow(i + 1, EXPONENT);
+            cumulative.push_back(total);
+        }
+
+        std::mt19937_64 random(rand());
+        std::uniform_real_distribution<double> uniform(0, total);
+        vector<long long> lookups;
+        long long hot = 0;
+        for(long long i = 0; i < 10 * NUM; ++i)
+        {
+            std::size_t rank = std::upper_bound(cumulative.begin(), cumulative.end(), uniform(random)) - cumulative.begin();
+            rank = std::min<std::size_t>(rank, NUM - 1);
+            if(static_cast<long long>(rank) < NUM / 100) ++hot;
+            lookups.push_back(keys[rank]);
+        }
+
+        cout << "Testing Zipf-distributed lookups, " << hot * 100 / lookups.size() << "% of them to the top 1% of keys" << endl;
+        testSkewedLookups<TreeMap<long long, long long>>("TreeMap (AVL)", keys, lookups);
+        testSkewedLookups<aisdi::TreeMap<long long, long long, std::allocator<std::pair<const long long, long long>>,
+            aisdi::SplayBalance>>("TreeMap (splay)", keys, lookups);
+    }
+
+    struct Benchmark
+    {
+        const char* name;
+        void (*run)(long long);
+    };
+
+    const Benchmark BENCHMARKS[] = {
+        { "compare", compareMaps },
+        { "latency", compareRehashLatency },
+        { "missing", compareMissingKeys },
+        { "hash", compareHashers },
+        { "alloc", compareAllocators },
+        { "threads", compareThroughput },
+        { "concurrent", compareReadHeavy },
+        { "order", compareLoadOrders },
+        { "btree", compareOrderedMaps },
+        { "percentile", comparePercentiles },
+        { "range", compareRangeQueries },
+        { "bulk", compareBulkLoads },
+        { "frozen", compareFrozenLookups },
+        { "zipf", compareSkewedLookups },
+        { "compact", compareCompaction },
+        { "setops", compareSetOperations },
+        { "skiplist", compareOrderedThroughput },
+        { "optimistic", compareReadersWithWriter },
+        { "snapshot", compareSnapshots },
+    };
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    srand(time(0));
+    long long NUM;
+    if(argc > 1) NUM = std::atoll(argv[1]);
+    else
+    {
+        cout << "Usage: aisdiMaps <number_of_elements> [benchmark]" << endl << "Benchmarks:";
+        for(const Benchmark& b : BENCHMARKS)
+            cout << " " << b.name;
+        cout << endl;
+        return 1;
+    }
+
+    std::string name = argc > 2 ? argv[2] : BENCHMARKS[0].name;
+    for(const Benchmark& b : BENCHMARKS)
+    {
+        if(name != b.name) continue;
+        b.run(NUM);
+        return 0;
+    }
+    cout << "Unknown benchmark: " << name << endl;
+    return 1;
 }
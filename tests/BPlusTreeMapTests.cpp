@@ -0,0 +1,317 @@
+#include <BPlusTreeMap.h>
+#include <PoolAllocator.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <string>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t, std::string>;
+
+template <typename K>
+using Map = aisdi::BPlusTreeMap<K, std::string>;
+
+namespace
+{
+
+template <typename K>
+K keyOf(int i)
+{
+    return static_cast<K>(i);
+}
+
+//Zero-padded, so strings sort like the numbers
+template <>
+std::string keyOf<std::string>(int i)
+{
+    std::string digits = std::to_string(i);
+    return std::string(8 - digits.size(), '0') + digits;
+}
+
+template <typename K>
+void thenMapContainsItems(const Map<K>& map, const std::map<K, std::string>& expected)
+{
+    BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+    auto it = map.begin();
+    for(const auto& item : expected)
+    {
+        BOOST_REQUIRE(it != map.end());
+        BOOST_REQUIRE(it->first == item.first);
+        BOOST_REQUIRE_EQUAL(it->second, item.second);
+        BOOST_REQUIRE(map.find(item.first) == it);
+        ++it;
+    }
+    BOOST_CHECK(it == map.end());
+}
+
+//Value whose construction number *failAt* (copies included) throws, to break insertion at every step
+struct FragileValue
+{
+    static int made;
+    static int failAt;
+    int value;
+
+    FragileValue(int v = 0): value(v)
+    {
+        if(made++ == failAt) throw std::bad_alloc();
+    }
+
+    FragileValue(const FragileValue& other): value(other.value)
+    {
+        if(made++ == failAt) throw std::bad_alloc();
+    }
+
+    FragileValue& operator=(const FragileValue&) = default;
+};
+
+int FragileValue::made = 0;
+int FragileValue::failAt = -1;
+
+//std::allocator that remembers the biggest block it was asked for
+std::size_t largestAllocation = 0;
+
+template <typename T>
+struct MeasuringAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        using other = MeasuringAllocator<U>;
+    };
+
+    MeasuringAllocator() = default;
+
+    template <typename U>
+    MeasuringAllocator(const MeasuringAllocator<U>&)
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        largestAllocation = std::max(largestAllocation, n * sizeof(T));
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+template <typename K, typename V>
+void thenNodesFitPoolSizeClasses()
+{
+    largestAllocation = 0;
+    aisdi::BPlusTreeMap<K, V, MeasuringAllocator<std::pair<const K, V>>> map;
+    for(int i = 0; i < 2000; ++i)
+        map[keyOf<K>(i * 7919 % 2003)];
+    const std::size_t largestClass = aisdi::NodePool::MAX_CLASS_SIZE;
+    BOOST_CHECK_GT(largestAllocation, 0);
+    BOOST_CHECK_LE(largestAllocation, largestClass);
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(BPlusTreeMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenAddingAndRemovingItems_ThenTheyAreFoundOrNot, K, TestedKeyTypes)
+{
+    Map<K> map;
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(keyOf<K>(1)) == map.end());
+    BOOST_CHECK_THROW(map.valueOf(keyOf<K>(1)), std::out_of_range);
+    BOOST_CHECK_THROW(map.remove(keyOf<K>(1)), std::out_of_range);
+
+    map[keyOf<K>(42)] = "Alice";
+    map[keyOf<K>(27)] = "Bob";
+    map[keyOf<K>(42)] = "Chuck";
+    thenMapContainsItems<K>(map, { { keyOf<K>(27), "Bob" }, { keyOf<K>(42), "Chuck" } });
+    BOOST_CHECK_EQUAL(map.valueOf(keyOf<K>(27)), "Bob");
+
+    map.remove(map.find(keyOf<K>(27)));
+    map.remove(keyOf<K>(42));
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK_EQUAL(map.getHeight(), 0);
+    BOOST_CHECK_THROW(map.remove(map.end()), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenIterators_WhenMovingPastEnds_ThenOperationsThrow, K, TestedKeyTypes)
+{
+    Map<K> map = { { keyOf<K>(1), "a" }, { keyOf<K>(2), "b" } };
+    auto it = map.end();
+    BOOST_CHECK_THROW(++it, std::out_of_range);
+    BOOST_CHECK_THROW(*it, std::out_of_range);
+    --it;
+    BOOST_CHECK(it->first == keyOf<K>(2));
+    it->second = "c";
+    BOOST_CHECK_EQUAL(map.valueOf(keyOf<K>(2)), "c");
+    --it;
+    BOOST_CHECK(it == map.begin());
+    BOOST_CHECK_THROW(--it, std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSortedAndReversedKeys_WhenAdding_ThenTreeIsShallowAndOrdered, K, TestedKeyTypes)
+{
+    const int COUNT = 20000;
+    Map<K> ascending, descending;
+    std::map<K, std::string> expected;
+    for(int i = 0; i < COUNT; ++i)
+    {
+        ascending[keyOf<K>(i)] = "x";
+        descending[keyOf<K>(COUNT - 1 - i)] = "x";
+        expected[keyOf<K>(i)] = "x";
+    }
+    thenMapContainsItems(ascending, expected);
+    thenMapContainsItems(descending, expected);
+    BOOST_CHECK(ascending == descending);
+    //Nodes have a fixed size in bytes, so large keys get a smaller fan-out
+    const std::size_t maxHeight = sizeof(K) <= 8 ? 5 : 8;
+    BOOST_CHECK_LE(ascending.getHeight(), maxHeight);
+    BOOST_CHECK_LE(descending.getHeight(), maxHeight);
+
+    //Walk all the way back
+    auto it = ascending.end();
+    for(int i = COUNT - 1; i >= 0; --i)
+        BOOST_REQUIRE((--it)->first == keyOf<K>(i));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenRandomInsertionsAndRemovals_WhenComparedWithStdMap_ThenContentsMatch, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    unsigned state = 2024;
+    for(int i = 0; i < 30000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = keyOf<K>((state >> 8) % 5000);
+        if((state >> 4) % 3 == 0)
+        {
+            bool present = expected.erase(key) != 0;
+            if(present) map.remove(key);
+            else BOOST_REQUIRE_THROW(map.remove(key), std::out_of_range);
+        }
+        else map[key] = expected[key] = std::to_string(i);
+    }
+    thenMapContainsItems(map, expected);
+
+    //Empty it from the front, which keeps merging the leftmost nodes
+    while(!expected.empty())
+    {
+        map.remove(map.begin());
+        expected.erase(expected.begin());
+        if(expected.size() % 997 == 0) thenMapContainsItems(map, expected);
+    }
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenCopyingAndMoving_ThenItemsFollow, K, TestedKeyTypes)
+{
+    Map<K> map;
+    for(int i = 0; i < 1000; ++i)
+        map[keyOf<K>(i * 7 % 1000)] = std::to_string(i);
+
+    Map<K> copy = map;
+    BOOST_CHECK(copy == map);
+    copy[keyOf<K>(5000)] = "new";
+    BOOST_CHECK(copy != map);
+
+    Map<K> moved = std::move(copy);
+    BOOST_CHECK(copy.isEmpty());
+    BOOST_CHECK_EQUAL(moved.getSize(), 1001);
+
+    map = moved;
+    BOOST_CHECK(map == moved);
+    copy = std::move(moved);
+    BOOST_CHECK(moved.isEmpty());
+    BOOST_CHECK_EQUAL(copy.valueOf(keyOf<K>(5000)), "new");
+}
+
+BOOST_AUTO_TEST_CASE(GivenNegativeAndUnsignedKeys_WhenSearching_ThenSimdOrderMatchesKeyOrder)
+{
+    aisdi::BPlusTreeMap<std::int64_t, int> signedMap;
+    aisdi::BPlusTreeMap<std::uint32_t, int> unsignedMap;
+    for(int i = -500; i < 500; ++i)
+    {
+        signedMap[i * 1000000007LL] = i;
+        unsignedMap[static_cast<std::uint32_t>(i) * 2654435761u] = i;
+    }
+    for(int i = -500; i < 500; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(signedMap.valueOf(i * 1000000007LL), i);
+        BOOST_REQUIRE_EQUAL(unsignedMap.valueOf(static_cast<std::uint32_t>(i) * 2654435761u), i);
+    }
+    BOOST_CHECK(signedMap.begin()->first == -500 * 1000000007LL);
+    BOOST_CHECK(signedMap.find(1) == signedMap.end());
+    BOOST_CHECK(unsignedMap.find(1) == unsignedMap.end());
+}
+
+//Bigger nodes would bypass the pool's size classes and get a slab each
+BOOST_AUTO_TEST_CASE(GivenCommonKeyAndValueTypes_WhenAllocatingNodes_ThenTheyFitPoolSizeClasses)
+{
+    thenNodesFitPoolSizeClasses<std::int32_t, std::int32_t>();
+    thenNodesFitPoolSizeClasses<std::uint64_t, std::uint64_t>();
+    thenNodesFitPoolSizeClasses<std::int32_t, std::string>();
+    thenNodesFitPoolSizeClasses<std::string, std::string>();
+}
+
+BOOST_AUTO_TEST_CASE(GivenPoolAllocator_WhenDestroyingMap_ThenNodesAreReleasedAtOnce)
+{
+    using Pool = aisdi::PoolAllocator<std::pair<const int, int>>;
+    aisdi::BPlusTreeMap<int, int, Pool> map;
+    for(int i = 0; i < 10000; ++i)
+        map[i] = i;
+    for(int i = 0; i < 10000; i += 2)
+        map.remove(i);
+    BOOST_CHECK_EQUAL(map.getSize(), 5000);
+    BOOST_CHECK_EQUAL(map.valueOf(9999), 9999);
+    map.clear();
+    BOOST_CHECK(map.isEmpty());
+    map[1] = 2;
+    BOOST_CHECK_EQUAL(map.valueOf(1), 2);
+}
+
+BOOST_AUTO_TEST_CASE(GivenValueConstructorThrowing_WhenAdding_ThenMapStaysAsItWas)
+{
+    aisdi::BPlusTreeMap<int, FragileValue> map;
+    std::map<int, int> expected;
+    //Sorted, so leaves are full and the insertions below split them
+    for(int i = 0; i < 200; i += 2)
+    {
+        map[i] = FragileValue(i);
+        expected[i] = i;
+    }
+
+    for(int key : { 1, 51, 199, 201, -1, 53 })
+    {
+        for(FragileValue::failAt = 0; ; ++FragileValue::failAt)
+        {
+            FragileValue::made = 0;
+            try
+            {
+                map[key] = FragileValue(-key);
+                break;
+            }
+            catch(const std::bad_alloc&)
+            {
+                BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+                auto it = map.begin();
+                for(const auto& item : expected)
+                {
+                    BOOST_REQUIRE_EQUAL(it->first, item.first);
+                    BOOST_REQUIRE(map.find(item.first) == it);
+                    BOOST_REQUIRE_EQUAL((it++)->second.value, item.second);
+                }
+                BOOST_REQUIRE(it == map.end());
+            }
+        }
+        BOOST_CHECK_GT(FragileValue::failAt, 1);
+        FragileValue::failAt = -1;
+        expected[key] = -key;
+        BOOST_REQUIRE_EQUAL(map.valueOf(key).value, -key);
+    }
+    BOOST_CHECK_EQUAL(std::distance(map.cbegin(), map.cend()), static_cast<std::ptrdiff_t>(expected.size()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
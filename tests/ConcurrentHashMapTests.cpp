@@ -0,0 +1,185 @@
+#include <ConcurrentHashMap.h>
+#include <Epoch.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Counted.h"
+
+BOOST_AUTO_TEST_SUITE(ConcurrentHashMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenEmptyMap_WhenAddingAndRemovingItems_ThenTheyAreFoundOrNot)
+{
+    aisdi::ConcurrentHashMap<std::int32_t, std::string> map;
+    BOOST_CHECK(map.isEmpty());
+
+    map.insert(42, "Alice");
+    map.insert(27, "Bob");
+    map.insert(42, "Chuck");
+
+    std::string value;
+    BOOST_CHECK(map.find(42, value));
+    BOOST_CHECK_EQUAL(value, "Chuck");
+    BOOST_CHECK_EQUAL(map.valueOf(27), "Bob");
+    BOOST_CHECK(!map.contains(13));
+    BOOST_CHECK_THROW(map.valueOf(13), std::out_of_range);
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+
+    BOOST_CHECK(map.remove(42));
+    BOOST_CHECK(!map.remove(42));
+    BOOST_CHECK(!map.find(42, value));
+    BOOST_CHECK_EQUAL(map.getSize(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyItems_WhenTableGrows_ThenAllItemsAreKept)
+{
+    aisdi::ConcurrentHashMap<std::int32_t, std::string> map = { { 1, "a" }, { 2, "b" } };
+    std::map<std::int32_t, std::string> expected = { { 1, "a" }, { 2, "b" } };
+    for(int i = 3; i < 5000; ++i)
+    {
+        map.insert(i, std::to_string(i));
+        expected[i] = std::to_string(i);
+    }
+    BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+    BOOST_CHECK_GE(map.bucket_count(), expected.size());
+
+    std::map<std::int32_t, std::string> visited;
+    map.forEach([&visited](const std::pair<const std::int32_t, std::string>& item) { visited[item.first] = item.second; });
+    BOOST_CHECK(visited == expected);
+}
+
+BOOST_AUTO_TEST_CASE(GivenRetiredObjects_WhenNoThreadIsPinned_ThenTheyAreFreed)
+{
+    aisdi::EpochManager& epochs = aisdi::EpochManager::instance();
+    {
+        aisdi::EpochGuard guard;
+        for(int i = 0; i < 10; ++i)
+            epochs.retire(new Counted());
+        epochs.collect();
+        //Still pinned at the epoch of their retirement
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 10);
+    }
+
+    for(int i = 0; i < 3 && epochs.pending() != 0; ++i)
+        epochs.collect();
+    BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenPinnedReader_WhenObjectsAreRetiredByAnotherThread_ThenTheyOutliveTheReader)
+{
+    aisdi::EpochManager& epochs = aisdi::EpochManager::instance();
+    std::atomic<bool> pinned(false), retired(false), checked(false);
+
+    std::thread reader([&]()
+    {
+        aisdi::EpochGuard guard;
+        pinned = true;
+        while(!retired) std::this_thread::yield();
+        checked = Counted::alive.load() == 5;
+    });
+
+    while(!pinned) std::this_thread::yield();
+    for(int i = 0; i < 5; ++i)
+        epochs.retire(new Counted());
+    for(int i = 0; i < 5; ++i)
+        epochs.collect();
+    retired = true;
+    reader.join();
+    BOOST_CHECK(checked.load());
+
+    for(int i = 0; i < 3 && epochs.pending() != 0; ++i)
+        epochs.collect();
+    BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+}
+
+//Readers check that a key is either missing or has one of the values writers ever store for it,
+// while writers keep replacing, removing and re-adding keys and the table grows
+BOOST_AUTO_TEST_CASE(GivenReadersAndWriters_WhenRunningConcurrently_ThenReadersSeeOnlyConsistentValues)
+{
+    aisdi::ConcurrentHashMap<int, long long> map;
+    const int READERS = 6, WRITERS = 2, KEYS = 2000, ROUNDS = 20;
+    std::atomic<bool> done(false);
+    std::atomic<long long> badReads(0), reads(0);
+
+    for(int key = 0; key < KEYS; key += 2)
+        map.insert(key, key * 1000LL);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < READERS; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            long long value, local = 0;
+            for(int key = t; !done.load(); key = (key + 7) % (KEYS * 2))
+            {
+                if(map.find(key, value) && (value / 1000 != key || value % 1000 > ROUNDS)) ++badReads;
+                ++local;
+            }
+            reads += local;
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for(int t = 0; t < WRITERS; ++t)
+    {
+        writers.emplace_back([&, t]()
+        {
+            for(int round = 1; round <= ROUNDS; ++round)
+            {
+                for(int key = t; key < KEYS * 2; key += WRITERS)
+                {
+                    if(key % 3 == 0) map.remove(key);
+                    else map.insert(key, key * 1000LL + round);
+                }
+                for(int key = t; key < KEYS * 2; key += WRITERS)
+                    if(key % 3 == 0) map.update(key, [key, round](long long& v) { v = key * 1000LL + round; });
+            }
+        });
+    }
+    for(std::thread& writer : writers)
+        writer.join();
+    done = true;
+    for(std::thread& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(badReads.load(), 0);
+    BOOST_CHECK_GT(reads.load(), 0);
+    BOOST_CHECK_EQUAL(map.getSize(), KEYS * 2);
+    for(int key = 0; key < KEYS * 2; ++key)
+        BOOST_REQUIRE_EQUAL(map.valueOf(key), key * 1000LL + ROUNDS);
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyThreads_WhenUpdatingConcurrently_ThenNoUpdateIsLost)
+{
+    aisdi::ConcurrentHashMap<int, int, std::hash<int>, std::equal_to<int>, 4> map;
+    const int THREADS = 8, KEYS = 200, ROUNDS = 50;
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&map, t]()
+        {
+            for(int round = 0; round < ROUNDS; ++round)
+            {
+                for(int key = 0; key < KEYS; ++key)
+                    map.update(key, [](int& value) { ++value; });
+                map.insert(KEYS + t, round);
+                map.remove(KEYS + t);
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(map.getSize(), KEYS);
+    for(int key = 0; key < KEYS; ++key)
+        BOOST_REQUIRE_EQUAL(map.valueOf(key), THREADS * ROUNDS);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
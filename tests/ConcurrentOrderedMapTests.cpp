@@ -0,0 +1,251 @@
+#include <ConcurrentSkipListMap.h>
+#include <ConcurrentTreeMap.h>
+#include <Epoch.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+#include "Counted.h"
+
+namespace
+{
+
+//Both lock-free ordered maps, as templates over key and value type
+struct SkipList
+{
+    template <typename K, typename V>
+    using Map = aisdi::ConcurrentSkipListMap<K, V>;
+};
+
+struct Tree
+{
+    template <typename K, typename V>
+    using Map = aisdi::ConcurrentTreeMap<K, V>;
+};
+
+template <typename Kind, typename K, typename V>
+using MapOf = typename Kind::template Map<K, V>;
+
+} // namespace
+
+using TestedMapKinds = boost::mpl::list<SkipList, Tree>;
+
+BOOST_AUTO_TEST_SUITE(ConcurrentOrderedMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenAddingAndRemovingItems_ThenTheyAreFoundOrNot, Kind, TestedMapKinds)
+{
+    MapOf<Kind, std::int32_t, std::string> map;
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+
+    map.insert(42, "Alice");
+    map.insert(27, "Bob");
+    map.insert(42, "Chuck");
+
+    std::string value;
+    BOOST_CHECK(map.find(42, value));
+    BOOST_CHECK_EQUAL(value, "Chuck");
+    BOOST_CHECK_EQUAL(map.valueOf(27), "Bob");
+    BOOST_CHECK(!map.contains(13));
+    BOOST_CHECK_THROW(map.valueOf(13), std::out_of_range);
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+
+    BOOST_CHECK(map.remove(42));
+    BOOST_CHECK(!map.remove(42));
+    BOOST_CHECK(!map.find(42, value));
+    BOOST_CHECK_EQUAL(map.getSize(), 1);
+    map.insert(42, "Dave");
+    BOOST_CHECK_EQUAL(map.valueOf(42), "Dave");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyItems_WhenIterating_ThenKeysComeInOrder, Kind, TestedMapKinds)
+{
+    MapOf<Kind, std::int32_t, std::string> map = { { 5, "e" }, { 1, "a" } };
+    std::map<std::int32_t, std::string> expected = { { 5, "e" }, { 1, "a" } };
+    for(int i = 0; i < 5000; ++i)
+    {
+        int key = i * 7919 % 10007;
+        if(i % 5 == 4)
+        {
+            BOOST_REQUIRE_EQUAL(map.remove(key), expected.erase(key) != 0);
+            continue;
+        }
+        map.insert(key, std::to_string(i));
+        expected[key] = std::to_string(i);
+    }
+    BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+
+    auto it = map.begin();
+    for(const auto& item : expected)
+    {
+        BOOST_REQUIRE(it != map.end());
+        BOOST_REQUIRE_EQUAL(it->first, item.first);
+        BOOST_REQUIRE_EQUAL((it++)->second, item.second);
+    }
+    BOOST_CHECK(it == map.end());
+    BOOST_CHECK_THROW(++it, std::out_of_range);
+    BOOST_CHECK_THROW(*it, std::out_of_range);
+
+    //Range scans
+    for(int key : { -1, 0, 1, 2, 5000, 10006, 10007 })
+    {
+        auto lower = map.lowerBound(key);
+        auto expectedLower = expected.lower_bound(key);
+        BOOST_REQUIRE_EQUAL(lower == map.end(), expectedLower == expected.end());
+        if(lower != map.end()) BOOST_CHECK_EQUAL(lower->first, expectedLower->first);
+        auto upper = map.upperBound(key);
+        auto expectedUpper = expected.upper_bound(key);
+        BOOST_REQUIRE_EQUAL(upper == map.end(), expectedUpper == expected.end());
+        if(upper != map.end()) BOOST_CHECK_EQUAL(upper->first, expectedUpper->first);
+    }
+    std::size_t scanned = 0;
+    for(auto item = map.lowerBound(100); item != map.end() && item->first < 2000; ++item)
+        ++scanned;
+    BOOST_CHECK_EQUAL(scanned, std::distance(expected.lower_bound(100), expected.lower_bound(2000)));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenReplacedAndRemovedValues_WhenNoThreadIsPinned_ThenTheyAreFreed, Kind, TestedMapKinds)
+{
+    aisdi::EpochManager& epochs = aisdi::EpochManager::instance();
+    {
+        MapOf<Kind, int, Counted> map;
+        for(int i = 0; i < 1000; ++i)
+            map.insert(i % 100, Counted(i));
+        for(int i = 0; i < 100; i += 2)
+            map.remove(i);
+        BOOST_CHECK_EQUAL(map.valueOf(99).value, 999);
+        for(int i = 0; i < 3 && epochs.pending() != 0; ++i)
+            epochs.collect();
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 50);
+    }
+    BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+}
+
+//Readers check that a key is either missing or has one of the values writers ever store for it,
+// and that scans come in key order, while writers keep replacing, removing and re-adding keys
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenReadersAndWriters_WhenRunningConcurrently_ThenReadersSeeOnlyConsistentValues, Kind, TestedMapKinds)
+{
+    MapOf<Kind, int, long long> map;
+    const int READERS = 4, WRITERS = 4, KEYS = 2000, ROUNDS = 20;
+    std::atomic<bool> done(false);
+    std::atomic<long long> badReads(0), reads(0);
+
+    for(int key = 0; key < KEYS; key += 2)
+        map.insert(key, key * 1000LL);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < READERS; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            long long value, local = 0;
+            for(int key = t; !done.load(); key = (key + 7) % (KEYS * 2))
+            {
+                if(map.find(key, value) && (value / 1000 != key || value % 1000 > ROUNDS)) ++badReads;
+                ++local;
+                if(key % 97 != 0) continue;
+                int previous = -1;
+                for(auto it = map.lowerBound(key); it != map.end() && it->first < key + 200; ++it)
+                {
+                    if(it->first <= previous || it->second / 1000 != it->first) ++badReads;
+                    previous = it->first;
+                }
+            }
+            reads += local;
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for(int t = 0; t < WRITERS; ++t)
+    {
+        writers.emplace_back([&, t]()
+        {
+            for(int round = 1; round <= ROUNDS; ++round)
+            {
+                for(int key = t; key < KEYS * 2; key += WRITERS)
+                {
+                    if(key % 3 == 0) map.remove(key);
+                    else map.insert(key, key * 1000LL + round);
+                }
+                for(int key = t; key < KEYS * 2; key += WRITERS)
+                    if(key % 3 == 0) map.insert(key, key * 1000LL + round);
+            }
+        });
+    }
+    for(std::thread& writer : writers)
+        writer.join();
+    done = true;
+    for(std::thread& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(badReads.load(), 0);
+    BOOST_CHECK_GT(reads.load(), 0);
+    BOOST_CHECK_EQUAL(map.getSize(), KEYS * 2);
+    int expected = 0;
+    for(const auto& item : map)
+    {
+        BOOST_REQUIRE_EQUAL(item.first, expected);
+        BOOST_REQUIRE_EQUAL(item.second, expected * 1000LL + ROUNDS);
+        ++expected;
+    }
+    BOOST_CHECK_EQUAL(expected, KEYS * 2);
+}
+
+//All threads fight over the same few keys, so inserts, removals and unlinking (and rotations) keep colliding
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyThreads_WhenChangingSameKeys_ThenEveryOperationCounts, Kind, TestedMapKinds)
+{
+    MapOf<Kind, int, int> map;
+    const int THREADS = 8, KEYS = 64, ROUNDS = 2000;
+    std::atomic<long long> added(0), removed(0);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            unsigned state = t + 1;
+            long long localAdded = 0, localRemoved = 0;
+            for(int i = 0; i < ROUNDS; ++i)
+            {
+                state = state * 1103515245u + 12345u;
+                int key = (state >> 8) % KEYS;
+                if((state >> 20) % 2 == 0)
+                {
+                    if(map.remove(key)) ++localRemoved;
+                }
+                else if(!map.contains(key))
+                {
+                    map.insert(key, t);
+                    ++localAdded;
+                }
+            }
+            added += localAdded;
+            removed += localRemoved;
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    //Adding a key that another thread added in the meantime only replaces the value
+    std::size_t size = 0;
+    for(auto it = map.begin(); it != map.end(); ++it)
+        ++size;
+    BOOST_CHECK_EQUAL(size, map.getSize());
+    BOOST_CHECK_LE(static_cast<long long>(size), added.load() - removed.load());
+    for(int key = 0; key < KEYS; ++key)
+    {
+        bool present = map.contains(key);
+        BOOST_REQUIRE_EQUAL(map.remove(key), present);
+    }
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
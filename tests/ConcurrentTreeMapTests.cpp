@@ -0,0 +1,117 @@
+#include <ConcurrentTreeMap.h>
+#include <Epoch.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Counted.h"
+
+//Cases shared with ConcurrentSkipListMap are in ConcurrentOrderedMapTests
+BOOST_AUTO_TEST_SUITE(ConcurrentTreeMapTests)
+
+//Every node and every item holds a copy of its key, so counting keys counts the nodes
+BOOST_AUTO_TEST_CASE(GivenRemovalsAndRotations_WhenRemovedNodesLoseAChild_ThenTheyAreUnlinked)
+{
+    aisdi::EpochManager& epochs = aisdi::EpochManager::instance();
+    {
+        aisdi::ConcurrentTreeMap<Counted, int> map;
+        unsigned state = 7;
+        for(int i = 0; i < 20000; ++i)
+        {
+            state = state * 1103515245u + 12345u;
+            int key = (state >> 8) % 2000;
+            if(i % 3 == 2) map.remove(key);
+            else map.insert(key, i);
+        }
+        for(int i = 0; i < 3 && epochs.pending() != 0; ++i)
+            epochs.collect();
+        //Each removed node left routes between two subtrees, and so has more live nodes below it
+        const int size = static_cast<int>(map.getSize());
+        BOOST_CHECK_LT(Counted::alive.load() - 2 * size, size);
+
+        for(int key = 0; key < 2000; ++key)
+            map.remove(key);
+        for(int i = 0; i < 3 && epochs.pending() != 0; ++i)
+            epochs.collect();
+        BOOST_CHECK(map.isEmpty());
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+    }
+    BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(GivenRemovedInnerNodes_WhenAddingKeysAgain_ThenMapStaysInOrder)
+{
+    aisdi::ConcurrentTreeMap<int, int> map;
+    for(int key = 0; key < 127; ++key)
+        map.insert(key, key);
+    //Inner nodes with two children stay in the tree, without a value, until a child goes
+    for(int key = 1; key < 127; key += 2)
+        BOOST_REQUIRE(map.remove(key));
+    BOOST_CHECK(!map.contains(63));
+    BOOST_CHECK_EQUAL(map.lowerBound(63)->first, 64);
+    BOOST_CHECK_EQUAL(map.upperBound(62)->first, 64);
+    for(int key = 3; key < 127; key += 4)
+        map.insert(key, -key);
+    for(int key = 0; key < 127; key += 4)
+        BOOST_REQUIRE(map.remove(key));
+
+    int expected = 2, size = 0;
+    for(const auto& item : map)
+    {
+        BOOST_REQUIRE_EQUAL(item.first, expected);
+        BOOST_REQUIRE_EQUAL(item.second, expected % 4 == 3 ? -expected : expected);
+        expected += expected % 4 == 2 ? 1 : 3;
+        ++size;
+    }
+    BOOST_CHECK_EQUAL(size, map.getSize());
+}
+
+//Keys that are never removed have to be found every time, however the writer rotates the tree
+// around them
+BOOST_AUTO_TEST_CASE(GivenWriterRotatingTree_WhenReadersLookUpStableKeys_ThenTheyAlwaysFindThem)
+{
+    aisdi::ConcurrentTreeMap<int, int> map;
+    const int READERS = 4, KEYS = 4096;
+    std::atomic<bool> done(false);
+    std::atomic<long long> misses(0), reads(0);
+    for(int key = 0; key < KEYS; key += 4)
+        map.insert(key, key);
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < READERS; ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            int value = 0;
+            long long local = 0;
+            for(int key = t * 4; !done.load(); key = (key + 4 * 37) % KEYS)
+            {
+                if(!map.find(key, value) || value != key) ++misses;
+                ++local;
+            }
+            reads += local;
+        });
+    }
+
+    //Growing and shrinking a run of keys on one side keeps rotating the nodes above it
+    for(int round = 0; round < 20; ++round)
+    {
+        int low = round % 2 == 0 ? 1 : KEYS / 2 + 1;
+        for(int key = low; key < low + KEYS / 2; ++key)
+            if(key % 4 != 0) map.insert(key, key);
+        for(int key = low; key < low + KEYS / 2; ++key)
+            if(key % 4 != 0) map.remove(key);
+    }
+    done = true;
+    for(std::thread& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(misses.load(), 0);
+    BOOST_CHECK_GT(reads.load(), 0);
+    BOOST_CHECK_EQUAL(map.getSize(), KEYS / 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
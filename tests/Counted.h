@@ -0,0 +1,48 @@
+#ifndef AISDI_MAPS_TESTS_COUNTED_H
+#define AISDI_MAPS_TESTS_COUNTED_H
+
+#include <atomic>
+
+namespace
+{
+
+//Counts live instances, to check that removed, replaced and retired values are freed.
+//Each test file gets a counter of its own.
+struct Counted
+{
+    static std::atomic<int> alive;
+    int value;
+
+    Counted(int v = 0): value(v)
+    {
+        ++alive;
+    }
+
+    Counted(const Counted& other): value(other.value)
+    {
+        ++alive;
+    }
+
+    Counted& operator=(const Counted&) = default;
+
+    bool operator==(const Counted& other) const
+    {
+        return value == other.value;
+    }
+
+    bool operator<(const Counted& other) const
+    {
+        return value < other.value;
+    }
+
+    ~Counted()
+    {
+        --alive;
+    }
+};
+
+std::atomic<int> Counted::alive(0);
+
+} // namespace
+
+#endif /* AISDI_MAPS_TESTS_COUNTED_H */
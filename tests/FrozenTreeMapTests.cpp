@@ -0,0 +1,114 @@
+#include <FrozenTreeMap.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+using TestedKeyTypes = boost::mpl::list<std::int32_t, std::uint64_t>;
+
+template <typename K>
+using Frozen = aisdi::FrozenTreeMap<K, std::string>;
+
+BOOST_AUTO_TEST_SUITE(FrozenTreeMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenSearching_ThenNothingIsFound, K, TestedKeyTypes)
+{
+    const Frozen<K> map;
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(1) == map.end());
+    BOOST_CHECK(map.lowerBound(1) == map.end());
+    BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+    auto it = map.end();
+    BOOST_CHECK_THROW(--it, std::out_of_range);
+    BOOST_CHECK_THROW(++it, std::out_of_range);
+}
+
+//Every size up to a few full levels, so the last level is filled in every possible way
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTreeMapOfAnySize_WhenFrozen_ThenItemsAreFoundAndOrdered, K, TestedKeyTypes)
+{
+    aisdi::TreeMap<K, std::string> source;
+    std::map<K, std::string> expected;
+    for(int size = 0; size <= 70; ++size)
+    {
+        const Frozen<K> map(source);
+        BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+
+        auto it = map.begin();
+        for(const auto& item : expected)
+        {
+            BOOST_REQUIRE_EQUAL(it->first, item.first);
+            BOOST_REQUIRE_EQUAL(map.valueOf(item.first), item.second);
+            BOOST_REQUIRE(map.find(item.first) == it);
+            BOOST_REQUIRE(map.find(item.first + 1) == map.end()); //odd keys are missing
+            BOOST_REQUIRE(map.lowerBound(item.first - 1) == it);
+            BOOST_REQUIRE(map.lowerBound(item.first) == it);
+            ++it;
+            BOOST_REQUIRE(map.upperBound(item.first) == it);
+            BOOST_REQUIRE(map.lowerBound(item.first + 1) == it);
+        }
+        BOOST_REQUIRE(it == map.end());
+        for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+            BOOST_REQUIRE_EQUAL((--it)->first, item->first);
+        BOOST_REQUIRE(it == map.begin());
+
+        source[2 * size + 2] = expected[2 * size + 2] = std::to_string(size);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenFrozen_ThenItMatchesTheTreeMap, K, TestedKeyTypes)
+{
+    aisdi::TreeMap<K, std::string> source;
+    unsigned state = 31337;
+    for(int i = 0; i < 50000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        source[state >> 4] = std::to_string(i);
+    }
+
+    const Frozen<K> map(source);
+    BOOST_CHECK_EQUAL(map.getSize(), source.getSize());
+    auto frozen = map.begin();
+    for(const auto& item : source)
+    {
+        BOOST_REQUIRE_EQUAL(frozen->first, item.first);
+        BOOST_REQUIRE_EQUAL(map.valueOf(item.first), item.second);
+        ++frozen;
+    }
+    BOOST_CHECK(frozen == map.end());
+
+    const Frozen<K> copy = map;
+    BOOST_CHECK(copy == map);
+    BOOST_CHECK(copy != Frozen<K>());
+}
+
+BOOST_AUTO_TEST_CASE(GivenDuplicatedOrUnsortedItems_WhenFreezing_ThenLastValueWinsOrFreezingFails)
+{
+    std::vector<std::pair<int, std::string>> items = { { -5, "a" }, { 2, "b" }, { 2, "c" } };
+    const aisdi::FrozenTreeMap<int, std::string> map(items.begin(), items.end());
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+    BOOST_CHECK_EQUAL(map.valueOf(-5), "a");
+    BOOST_CHECK_EQUAL(map.valueOf(2), "c");
+
+    items.emplace_back(1, "d");
+    BOOST_CHECK_THROW((aisdi::FrozenTreeMap<int, std::string>(items.begin(), items.end())), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(GivenStringKeys_WhenFrozen_ThenTheyAreFound)
+{
+    aisdi::TreeMap<std::string, int> source;
+    for(int i = 0; i < 1000; ++i)
+        source[std::to_string(i)] = i;
+    const aisdi::FrozenTreeMap<std::string, int> map(source);
+    for(int i = 0; i < 1000; ++i)
+        BOOST_REQUIRE_EQUAL(map.valueOf(std::to_string(i)), i);
+    BOOST_CHECK(map.find("x") == map.end());
+    BOOST_CHECK_EQUAL(map.begin()->first, "0");
+    BOOST_CHECK_EQUAL((--map.end())->first, "999");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
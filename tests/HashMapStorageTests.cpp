@@ -0,0 +1,272 @@
+#include <HashMap.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <map>
+#include <new>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+//Every alternative storage engine with both key types and with the bundled hasher
+using TestedMapTypes = boost::mpl::list<aisdi::RobinHoodHashMap<std::int32_t, std::string>,
+                                        aisdi::RobinHoodHashMap<std::uint64_t, std::string>,
+                                        aisdi::SwissHashMap<std::int32_t, std::string>,
+                                        aisdi::SwissHashMap<std::uint64_t, std::string>,
+                                        aisdi::RobinHoodHashMap<std::uint64_t, std::string,
+                                                                aisdi::FastHash<std::uint64_t>>,
+                                        aisdi::SwissHashMap<std::uint64_t, std::string,
+                                                            aisdi::FastHash<std::uint64_t>>>;
+
+namespace
+{
+
+//Key whose copy number *failAt* throws, to break insertion at every step
+struct FragileKey
+{
+    static int copies;
+    static int failAt;
+    int value;
+
+    FragileKey(int v = 0): value(v) {}
+
+    FragileKey(const FragileKey& other): value(other.value)
+    {
+        if(copies++ == failAt) throw std::bad_alloc();
+    }
+
+    bool operator==(const FragileKey& other) const
+    {
+        return value == other.value;
+    }
+};
+
+int FragileKey::copies = 0;
+int FragileKey::failAt = -1;
+
+//Only a few home slots, so inserting keeps displacing elements
+struct CollidingHash
+{
+    std::size_t operator()(const FragileKey& key) const
+    {
+        return key.value % 4;
+    }
+};
+
+} // namespace
+
+//Open addressing engines, which move elements on insertion and rehashing
+using FragileMapTypes = boost::mpl::list<aisdi::RobinHoodHashMap<FragileKey, std::string, CollidingHash>,
+                                         aisdi::SwissHashMap<FragileKey, std::string, CollidingHash>>;
+
+using std::begin;
+using std::end;
+
+BOOST_AUTO_TEST_SUITE(HashMapStorageTests)
+
+template <typename M>
+void thenMapContainsItems(const M& map,
+                          const std::map<typename M::key_type, std::string>& expected)
+{
+    BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+
+    std::size_t iterated = 0;
+    for (auto it = map.begin(); it != map.end(); ++it)
+        ++iterated;
+    BOOST_CHECK_EQUAL(iterated, expected.size());
+
+    for (const auto& item : expected)
+    {
+        const auto it = map.find(item.first);
+        BOOST_REQUIRE_MESSAGE(it != end(map), "Missing required item with key: " << item.first);
+        BOOST_CHECK_MESSAGE(it->second == item.second,
+                            "Wrong value in map for key: " << item.first
+                            << " (expected: \"" << item.second
+                            << "\" got: \"" << it->second << "\")");
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenGettingIterators_ThenBeginEqualsEnd, M, TestedMapTypes)
+{
+    M map;
+
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(begin(map) == end(map));
+    BOOST_CHECK(map.find(1) == map.end());
+    BOOST_CHECK_THROW(map.valueOf(1), std::out_of_range);
+    BOOST_CHECK_THROW(map.remove(1), std::out_of_range);
+    BOOST_CHECK_THROW(++(map.end()), std::out_of_range);
+    BOOST_CHECK_THROW(--(map.begin()), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenChangingItems_ThenNewValuesAreInMap, M, TestedMapTypes)
+{
+    M map = { { 42, "Chuck" }, { 27, "Bob" } };
+
+    map[42] = "Alice";
+    map.valueOf(27) = "Bobby";
+    map.find(27)->second += "!";
+
+    thenMapContainsItems(map, { { 42, "Alice" }, { 27, "Bobby!" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMapWithItems_WhenIteratingBackwards_ThenAllItemsAreVisited, M, TestedMapTypes)
+{
+    M map = { { 1, "a" }, { 2, "b" }, { 3, "c" } };
+
+    std::size_t visited = 0;
+    auto it = map.end();
+    while(it != map.begin())
+    {
+        --it;
+        ++visited;
+    }
+
+    BOOST_CHECK_EQUAL(visited, 3);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenCollidingKeys_WhenRemovingFromProbeSequence_ThenOthersStayReachable, M, TestedMapTypes)
+{
+    using K = typename M::key_type;
+    M map;
+    std::map<K, std::string> expected;
+    for(int i = 0; i < 12; ++i)
+    {
+        map[i * 1024] = std::to_string(i);
+        expected[i * 1024] = std::to_string(i);
+    }
+
+    for(int i = 0; i < 12; i += 3)
+    {
+        map.remove(i * 1024);
+        expected.erase(i * 1024);
+    }
+
+    thenMapContainsItems(map, expected);
+}
+
+//Add *key*, breaking the insertion at every key copy it makes once, and check that the map stays
+// as it was after each failure
+template <typename M>
+void whenAddingFragileKey(M& map, std::map<int, std::string>& expected, int key)
+{
+    for(FragileKey::failAt = 0; ; ++FragileKey::failAt)
+    {
+        FragileKey::copies = 0;
+        try
+        {
+            map[FragileKey(key)] = std::to_string(key);
+            break;
+        }
+        catch(const std::bad_alloc&)
+        {
+            BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+            std::size_t iterated = 0;
+            for(auto it = map.begin(); it != map.end(); ++it)
+                ++iterated;
+            BOOST_REQUIRE_EQUAL(iterated, expected.size());
+            for(const auto& item : expected)
+                BOOST_REQUIRE_EQUAL(map.valueOf(FragileKey(item.first)), item.second);
+        }
+    }
+    FragileKey::failAt = -1;
+    expected[key] = std::to_string(key);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenKeyCopyThrowing_WhenInsertingCollidingKeys_ThenMapStaysAsItWas, M, FragileMapTypes)
+{
+    M map;
+    std::map<int, std::string> expected;
+    //Enough to rehash a few times
+    for(int key = 0; key < 60; ++key)
+        whenAddingFragileKey(map, expected, key);
+
+    //New keys take the slots of removed ones
+    for(int key = 0; key < 60; key += 3)
+    {
+        map.remove(FragileKey(key));
+        expected.erase(key);
+    }
+    for(int key = 60; key < 80; ++key)
+        whenAddingFragileKey(map, expected, key);
+
+    BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+    for(const auto& item : expected)
+        BOOST_REQUIRE_EQUAL(map.valueOf(FragileKey(item.first)), item.second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenRandomOperations_WhenComparedWithStdMap_ThenContentsMatch, M, TestedMapTypes)
+{
+    using K = typename M::key_type;
+    M map;
+    std::map<K, std::string> expected;
+    std::srand(2017);
+
+    for(int i = 0; i < 20000; ++i)
+    {
+        K key = std::rand() % 3000;
+        if(std::rand() % 3 == 0)
+        {
+            if(expected.erase(key)) map.remove(key);
+            else BOOST_REQUIRE_THROW(map.remove(key), std::out_of_range);
+        }
+        else
+        {
+            map[key] = std::to_string(i);
+            expected[key] = std::to_string(i);
+        }
+    }
+
+    thenMapContainsItems(map, expected);
+    BOOST_CHECK(map.load_factor() <= map.max_load_factor());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenCopyingAndMoving_ThenItemsFollow, M, TestedMapTypes)
+{
+    M map = { { 753, "Rome" }, { 1789, "Paris" } };
+    M copy{map};
+    M moved{std::move(map)};
+
+    copy[1410] = "Grunwald";
+
+    thenMapContainsItems(copy, { { 1410, "Grunwald" }, { 753, "Rome" }, { 1789, "Paris" } });
+    thenMapContainsItems(moved, { { 753, "Rome" }, { 1789, "Paris" } });
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(copy != moved);
+
+    moved = copy;
+    BOOST_CHECK(copy == moved);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMaps_WhenSwapping_ThenItemsAreExchanged, M, TestedMapTypes)
+{
+    M empty;
+    M map = { { 753, "Rome" }, { 1789, "Paris" } };
+    BOOST_CHECK_EQUAL(empty.bucket_count(), 0);
+
+    empty.swap(map);
+    thenMapContainsItems(empty, { { 753, "Rome" }, { 1789, "Paris" } });
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.find(753) == map.end());
+
+    map[1410] = "Grunwald";
+    map = std::move(empty);
+    thenMapContainsItems(map, { { 753, "Rome" }, { 1789, "Paris" } });
+    BOOST_CHECK_EQUAL(empty.bucket_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenReserving_ThenInsertsDontRehash, M, TestedMapTypes)
+{
+    M map;
+    map.reserve(5000);
+    const auto reservedSlots = map.bucket_count();
+
+    for(int i = 0; i < 5000; ++i)
+        map[i] = "x";
+
+    BOOST_CHECK_EQUAL(map.bucket_count(), reservedSlots);
+    BOOST_CHECK_THROW(map.max_load_factor(1.0f), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
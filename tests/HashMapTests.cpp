@@ -1,8 +1,10 @@
 #include <HashMap.h>
 
+#include <cctype>
 #include <cstdint>
 #include <string>
 #include <map>
+#include <type_traits>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp>
@@ -656,6 +658,309 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(Remove_MegaTest, K, TestedKeyTypes)
     BOOST_CHECK(map.getSize() == 10);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenManyItems_WhenAdding_ThenTableGrowsWithinLoadFactor, K, TestedKeyTypes)
+{
+    Map<K> map;
+    const auto initialBuckets = map.bucket_count();
+
+    for(int i = 0; i < 10000; ++i)
+        map[i] = std::to_string(i);
+
+    BOOST_CHECK(map.bucket_count() > initialBuckets);
+    BOOST_CHECK(map.load_factor() <= map.max_load_factor());
+    BOOST_CHECK_EQUAL(map.getSize(), 10000);
+    for(int i = 0; i < 10000; ++i)
+        BOOST_REQUIRE_EQUAL(map.valueOf(i), std::to_string(i));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenRemovingMostItems_ThenTableShrinks, K, TestedKeyTypes)
+{
+    Map<K> map;
+    for(int i = 0; i < 10000; ++i)
+        map[i] = std::to_string(i);
+    const auto grownBuckets = map.bucket_count();
+
+    for(int i = 10; i < 10000; ++i)
+        map.remove(i);
+
+    BOOST_CHECK(map.bucket_count() < grownBuckets);
+    thenMapContainsItems(map, { { 0, "0" }, { 1, "1" }, { 2, "2" }, { 3, "3" }, { 4, "4" },
+        { 5, "5" }, { 6, "6" }, { 7, "7" }, { 8, "8" }, { 9, "9" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenReserving_ThenInsertsDontRehash, K, TestedKeyTypes)
+{
+    Map<K> map;
+    map.reserve(5000);
+    const auto reservedBuckets = map.bucket_count();
+
+    for(int i = 0; i < 5000; ++i)
+        map[i] = "x";
+
+    BOOST_CHECK(reservedBuckets * map.max_load_factor() >= 5000);
+    BOOST_CHECK_EQUAL(map.bucket_count(), reservedBuckets);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenNonEmptyMap_WhenRehashing_ThenItemsAreKept, K, TestedKeyTypes)
+{
+    Map<K> map = { { 42, "Alice" }, { 27, "Bob" }, { 13, "Chuck" } };
+
+    map.rehash(1000);
+    BOOST_CHECK(map.bucket_count() >= 1000);
+    thenMapContainsItems(map, { { 42, "Alice" }, { 27, "Bob" }, { 13, "Chuck" } });
+
+    map.max_load_factor(4.0f);
+    map.rehash(0);
+    BOOST_CHECK(map.bucket_count() < 1000);
+    thenMapContainsItems(map, { { 42, "Alice" }, { 27, "Bob" }, { 13, "Chuck" } });
+
+    BOOST_CHECK_THROW(map.max_load_factor(0.0f), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenIncrementalRehash_WhenMigrationIsInProgress_ThenAllItemsAreReachable, K, TestedKeyTypes)
+{
+    Map<K> map;
+    map.setIncrementalRehash(true);
+
+    bool sawMigration = false;
+    for(int i = 0; i < 5000; ++i)
+    {
+        map[i] = std::to_string(i);
+        if(!map.isRehashing()) continue;
+        sawMigration = true;
+
+        std::size_t iterated = 0;
+        for(auto it = map.cbegin(); it != map.cend(); ++it)
+            ++iterated;
+        BOOST_REQUIRE_EQUAL(iterated, map.getSize());
+
+        const Map<K>& constMap = map;
+        for(int j = 0; j <= i; j += 97)
+            BOOST_REQUIRE(constMap.find(j) != constMap.end());
+    }
+    BOOST_CHECK(sawMigration);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenIncrementalRehash_WhenLookingUpWhileIterating_ThenEveryItemIsVisited, K, TestedKeyTypes)
+{
+    Map<K> map;
+    map.setIncrementalRehash(true);
+    for(int i = 0; i < 1025; ++i)
+        map[i] = "x";
+    BOOST_REQUIRE(map.isRehashing());
+
+    std::size_t visited = 0;
+    for(auto it = map.begin(); it != map.end(); ++it)
+    {
+        BOOST_REQUIRE(map.find(it->first) == it);
+        map.valueOf(it->first) = "y";
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, 1025);
+    BOOST_CHECK(map.isRehashing());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenIncrementalRehash_WhenRemovingDuringMigration_ThenItemsAreRemoved, K, TestedKeyTypes)
+{
+    Map<K> map;
+    map.setIncrementalRehash(true);
+    for(int i = 0; i < 2049; ++i)
+        map[i] = "x";
+    BOOST_REQUIRE(map.isRehashing());
+
+    for(int i = 0; i < 2049; i += 2)
+        map.remove(i);
+
+    BOOST_CHECK_EQUAL(map.getSize(), 1024);
+    for(int i = 0; i < 2049; ++i)
+        BOOST_REQUIRE_EQUAL(map.find(i) != map.end(), i % 2 == 1);
+
+    auto it = map.end();
+    std::size_t visited = 0;
+    while(it != map.begin())
+    {
+        --it;
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, 1024);
+
+    map.setIncrementalRehash(false);
+    BOOST_CHECK(!map.isRehashing());
+}
+
+struct CaseInsensitiveHash
+{
+    std::size_t operator()(const std::string& key) const
+    {
+        std::string lower(key);
+        for(char& c : lower)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return aisdi::FastHash<std::string>()(lower);
+    }
+};
+
+struct CaseInsensitiveEqual
+{
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+        if(a.size() != b.size()) return false;
+        for(std::size_t i = 0; i < a.size(); ++i)
+            if(std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+                return false;
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(GivenCustomHashAndEquality_WhenLookingUpEquivalentKey_ThenItIsFound)
+{
+    aisdi::HashMap<std::string, int, aisdi::ChainedStorage, CaseInsensitiveHash, CaseInsensitiveEqual> map;
+    map["Alice"] = 1;
+    map["BOB"] = 2;
+
+    map["alice"] += 10;
+
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+    BOOST_CHECK_EQUAL(map.valueOf("ALICE"), 11);
+    BOOST_CHECK(map.find("bob") != map.end());
+    BOOST_CHECK(map.find("carol") == map.end());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenFastHashMap_WhenAddingStridedKeys_ThenAllItemsAreInMap, K, TestedKeyTypes)
+{
+    aisdi::HashMap<K, std::string, aisdi::ChainedStorage, aisdi::FastHash<K>> map;
+
+    for(int i = 0; i < 4096; ++i)
+        map[static_cast<K>(i) << 16] = std::to_string(i);
+
+    BOOST_CHECK_EQUAL(map.getSize(), 4096);
+    for(int i = 0; i < 4096; ++i)
+        BOOST_REQUIRE_EQUAL(map.valueOf(static_cast<K>(i) << 16), std::to_string(i));
+    map.remove(static_cast<K>(7) << 16);
+    BOOST_CHECK(map.find(static_cast<K>(7) << 16) == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(GivenFastHash_WhenHashingKeys_ThenResultsAreStableAndSpread)
+{
+    aisdi::FastHash<std::uint64_t> intHash;
+    aisdi::FastHash<std::string> stringHash;
+
+    BOOST_CHECK_EQUAL(intHash(12345), intHash(12345));
+    BOOST_CHECK_EQUAL(stringHash("some key"), stringHash(std::string("some key")));
+    BOOST_CHECK(stringHash("") != stringHash("a"));
+    BOOST_CHECK(stringHash("0123456789abcdefX") != stringHash("0123456789abcdefY"));
+
+    //Strided keys must not pile up in a few low-bit buckets
+    std::map<std::size_t, int> lowBits;
+    for(std::uint64_t i = 0; i < 1024; ++i)
+        ++lowBits[intHash(i << 20) & 63];
+    BOOST_CHECK_EQUAL(lowBits.size(), 64);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenCreated_ThenNoTableIsAllocatedUntilFirstInsert, K, TestedKeyTypes)
+{
+    Map<K> map;
+    BOOST_CHECK_EQUAL(map.bucket_count(), 0);
+    BOOST_CHECK_EQUAL(map.load_factor(), 0.0f);
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(42) == map.end());
+    BOOST_CHECK(sizeof(map) <= 8 * sizeof(void*));
+
+    Map<K> copy{map};
+    BOOST_CHECK_EQUAL(copy.bucket_count(), 0);
+
+    map[42] = "Alice";
+    BOOST_CHECK(map.bucket_count() > 0);
+    BOOST_CHECK_EQUAL(map.valueOf(42), "Alice");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMaps_WhenSwappingAndMoving_ThenTablesChangeOwners, K, TestedKeyTypes)
+{
+    static_assert(std::is_nothrow_move_constructible<Map<K>>::value, "HashMap move must not throw");
+    static_assert(std::is_nothrow_move_assignable<Map<K>>::value, "HashMap move must not throw");
+
+    Map<K> first = { { 42, "Alice" }, { 27, "Bob" } };
+    Map<K> second = { { 13, "Chuck" } };
+
+    first.swap(second);
+    thenMapContainsItems(first, { { 13, "Chuck" } });
+    thenMapContainsItems(second, { { 42, "Alice" }, { 27, "Bob" } });
+
+    swap(first, second);
+    thenMapContainsItems(first, { { 42, "Alice" }, { 27, "Bob" } });
+
+    second = std::move(first);
+    thenMapContainsItems(second, { { 42, "Alice" }, { 27, "Bob" } });
+    BOOST_CHECK(first.isEmpty());
+    BOOST_CHECK_EQUAL(first.bucket_count(), 0);
+
+    first[7] = "Dave";
+    thenMapContainsItems(first, { { 7, "Dave" } });
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSparseTable_WhenIteratingAndRemovingEnds_ThenAllItemsAreVisited, K, TestedKeyTypes)
+{
+    Map<K> map;
+    map.reserve(100000);
+    std::map<K, std::string> expected;
+    for(int i = 0; i < 300; i += 7)
+        map[i] = expected[i] = std::to_string(i);
+
+    std::size_t forward = 0, backward = 0;
+    for(auto it = map.begin(); it != map.end(); ++it)
+        ++forward;
+    for(auto it = map.end(); it != map.begin(); --it)
+        ++backward;
+    BOOST_CHECK_EQUAL(forward, expected.size());
+    BOOST_CHECK_EQUAL(backward, expected.size());
+
+    while(!map.isEmpty())
+    {
+        auto first = map.begin();
+        expected.erase(first->first);
+        map.remove(first);
+        if(map.isEmpty()) break;
+        auto last = --map.end();
+        expected.erase(last->first);
+        map.remove(last);
+        thenMapContainsItems(map, expected);
+    }
+    BOOST_CHECK(expected.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+//Counts its calls; distinct keys that are equal modulo 4 collide completely
+struct CountingHash
+{
+    static int calls;
+
+    std::size_t operator()(int key) const
+    {
+        ++calls;
+        return static_cast<std::size_t>(key % 4);
+    }
+};
+
+int CountingHash::calls = 0;
+
+BOOST_AUTO_TEST_CASE(GivenCollidingHashes_WhenTableGrows_ThenKeysAreNotRehashed)
+{
+    aisdi::HashMap<int, std::string, aisdi::ChainedStorage, CountingHash> map;
+    CountingHash::calls = 0;
+
+    for(int i = 0; i < 200; ++i)
+        map[i] = std::to_string(i);
+    BOOST_CHECK_EQUAL(CountingHash::calls, 200);
+
+    map.rehash(1024);
+    auto copy = map;
+    BOOST_CHECK_EQUAL(CountingHash::calls, 200);
+    BOOST_CHECK(copy == map);
+
+    for(int i = 0; i < 200; ++i)
+        BOOST_REQUIRE_EQUAL(map.valueOf(i), std::to_string(i));
+    BOOST_CHECK(map.find(200) == map.end());
+}
+
 // ConstIterator is tested via Iterator methods.
 // If Iterator methods are to be changed, then new ConstIterator tests are required.
 
@@ -0,0 +1,191 @@
+#include <PersistentTreeMap.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include "Counted.h"
+
+namespace
+{
+
+template <typename Map>
+std::map<typename Map::key_type, typename Map::mapped_type> contentsOf(const Map& map)
+{
+    return std::map<typename Map::key_type, typename Map::mapped_type>(map.begin(), map.end());
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(PersistentTreeMapTests)
+
+BOOST_AUTO_TEST_CASE(GivenEmptyMap_WhenAddingAndRemovingItems_ThenTheyAreFoundOrNot)
+{
+    aisdi::PersistentTreeMap<std::int32_t, std::string> map;
+    BOOST_CHECK(map.isEmpty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_THROW(--map.end(), std::out_of_range);
+
+    map[42] = "Alice";
+    map[27] = "Bob";
+    map[42] = "Chuck";
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+    BOOST_CHECK_EQUAL(map.valueOf(42), "Chuck");
+    BOOST_CHECK_EQUAL(map.find(27)->second, "Bob");
+    BOOST_CHECK(map.find(13) == map.end());
+    BOOST_CHECK_THROW(map.valueOf(13), std::out_of_range);
+    BOOST_CHECK_THROW(map.remove(13), std::out_of_range);
+    BOOST_CHECK_THROW(map.remove(map.end()), std::out_of_range);
+
+    map.remove(42);
+    BOOST_CHECK_EQUAL(map.getSize(), 1);
+    map.remove(map.begin());
+    BOOST_CHECK(map.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyItems_WhenIterating_ThenKeysComeInOrderBothWays)
+{
+    aisdi::PersistentTreeMap<int, int> map = { { 5, 50 }, { 1, 10 } };
+    std::map<int, int> expected = { { 5, 50 }, { 1, 10 } };
+    for(int i = 0; i < 5000; ++i)
+    {
+        int key = i * 7919 % 10007;
+        if(i % 5 == 4)
+        {
+            if(expected.erase(key) != 0) map.remove(key);
+            else BOOST_REQUIRE_THROW(map.remove(key), std::out_of_range);
+            continue;
+        }
+        map[key] = i;
+        expected[key] = i;
+    }
+    BOOST_CHECK_EQUAL(map.getSize(), expected.size());
+    BOOST_CHECK(contentsOf(map) == expected);
+    BOOST_CHECK_LE(map.getHeight(), 17);
+
+    auto it = map.end();
+    for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+    {
+        --it;
+        BOOST_REQUIRE_EQUAL(it->first, item->first);
+    }
+    BOOST_CHECK(it == map.begin());
+    BOOST_CHECK_THROW(--it, std::out_of_range);
+
+    for(int key : { -1, 0, 1, 2, 5000, 10006, 10007 })
+    {
+        auto lower = map.lowerBound(key);
+        auto expectedLower = expected.lower_bound(key);
+        BOOST_REQUIRE_EQUAL(lower == map.end(), expectedLower == expected.end());
+        if(lower != map.end()) BOOST_CHECK_EQUAL(lower->first, expectedLower->first);
+        auto upper = map.upperBound(key);
+        auto expectedUpper = expected.upper_bound(key);
+        BOOST_REQUIRE_EQUAL(upper == map.end(), expectedUpper == expected.end());
+        if(upper != map.end()) BOOST_CHECK_EQUAL(upper->first, expectedUpper->first);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GivenSnapshots_WhenMapKeepsChanging_ThenEachSnapshotKeepsItsVersion)
+{
+    aisdi::PersistentTreeMap<int, int> map;
+    std::map<int, int> current;
+    std::vector<aisdi::PersistentTreeMap<int, int>> snapshots;
+    std::vector<std::map<int, int>> expected;
+    for(int round = 0; round < 40; ++round)
+    {
+        snapshots.push_back(map.snapshot());
+        expected.push_back(current);
+        for(int i = 0; i < 200; ++i)
+        {
+            int key = (round * 200 + i) * 7919 % 1009;
+            if(i % 3 == 2 && current.erase(key) != 0) map.remove(key);
+            else
+            {
+                map[key] = round;
+                current[key] = round;
+            }
+        }
+        //Changing a snapshot leaves the map, and the other snapshots, alone too
+        if(round % 4 == 3)
+        {
+            snapshots[round / 2][-round] = round;
+            expected[round / 2][-round] = round;
+        }
+    }
+
+    BOOST_CHECK(contentsOf(map) == current);
+    for(std::size_t i = 0; i < snapshots.size(); ++i)
+    {
+        BOOST_REQUIRE(contentsOf(snapshots[i]) == expected[i]);
+        BOOST_REQUIRE_EQUAL(snapshots[i].getSize(), expected[i].size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GivenSnapshot_WhenChangingOneKey_ThenOnlyItsPathIsCopied)
+{
+    Counted::alive = 0;
+    {
+        aisdi::PersistentTreeMap<int, Counted> map;
+        for(int key = 0; key < 4096; ++key)
+            map[key] = Counted(key);
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 4096);
+
+        aisdi::PersistentTreeMap<int, Counted> snapshot = map.snapshot();
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 4096);
+        BOOST_CHECK(snapshot == map);
+
+        map[1000] = Counted(-1);
+        int copied = Counted::alive.load() - 4096;
+        BOOST_CHECK_GT(copied, 0);
+        BOOST_CHECK_LE(copied, map.getHeight());
+        //The path is this map's own now
+        map[1000] = Counted(-2);
+        BOOST_CHECK_EQUAL(Counted::alive.load() - 4096, copied);
+
+        map.remove(2000);
+        map[5000] = Counted(5000);
+        BOOST_CHECK_LE(Counted::alive.load() - 4096, copied + 2 * map.getHeight() + 4);
+        BOOST_CHECK_EQUAL(snapshot.valueOf(1000).value, 1000);
+        BOOST_CHECK_EQUAL(snapshot.valueOf(2000).value, 2000);
+        BOOST_CHECK(snapshot.find(5000) == snapshot.end());
+        BOOST_CHECK(snapshot != map);
+
+        //Dropping the snapshot frees what only it used
+        snapshot = aisdi::PersistentTreeMap<int, Counted>();
+        BOOST_CHECK_EQUAL(Counted::alive.load(), 4096);
+    }
+    BOOST_CHECK_EQUAL(Counted::alive.load(), 0);
+}
+
+//Snapshots read and dropped on other threads while the map keeps changing
+BOOST_AUTO_TEST_CASE(GivenSnapshotsOnOtherThreads_WhenMapKeepsChanging_ThenReadersSeeTheirVersions)
+{
+    aisdi::PersistentTreeMap<int, long long> map;
+    for(int key = 0; key < 1000; ++key)
+        map[key] = 0;
+
+    std::atomic<int> bad(0);
+    std::vector<std::thread> readers;
+    for(int round = 1; round <= 8; ++round)
+    {
+        readers.emplace_back([round, &bad](const aisdi::PersistentTreeMap<int, long long>& snapshot)
+        {
+            long long sum = 0;
+            for(const auto& item : snapshot)
+                sum += item.second;
+            if(snapshot.getSize() != 1000 || sum != 1000LL * (round - 1)) ++bad;
+        }, map.snapshot());
+        for(int key = 0; key < 1000; ++key)
+            map[key] = round;
+    }
+    for(std::thread& reader : readers)
+        reader.join();
+    BOOST_CHECK_EQUAL(bad.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
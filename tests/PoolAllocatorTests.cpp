@@ -0,0 +1,156 @@
+#include <PoolAllocator.h>
+#include <HashMap.h>
+#include <TreeMap.h>
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <utility>
+
+#include <boost/test/unit_test.hpp>
+
+template <typename K, typename V>
+using PoolFor = aisdi::PoolAllocator<std::pair<const K, V>>;
+
+BOOST_AUTO_TEST_SUITE(PoolAllocatorTests)
+
+BOOST_AUTO_TEST_CASE(GivenPool_WhenFreeingBlock_ThenItIsReusedBySameSizeClass)
+{
+    aisdi::NodePool pool;
+    void* a = pool.allocate(40);
+    void* b = pool.allocate(40);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(a) % aisdi::NodePool::ALIGNMENT, 0);
+
+    pool.deallocate(a, 40);
+    BOOST_CHECK_EQUAL(pool.allocate(33), a);
+    BOOST_CHECK(pool.allocate(40) != a);
+}
+
+BOOST_AUTO_TEST_CASE(GivenPool_WhenAllocatingBlocksOfAllSizes_ThenTheyDontOverlap)
+{
+    aisdi::NodePool pool;
+    std::map<char*, std::size_t> blocks;
+    for(std::size_t i = 1; i < 3000; ++i)
+    {
+        std::size_t bytes = (i * 37) % 1500 + 1;
+        char* p = static_cast<char*>(pool.allocate(bytes));
+        for(std::size_t j = 0; j < bytes; ++j)
+            p[j] = static_cast<char>(i);
+        blocks[p] = bytes;
+    }
+
+    char* previousEnd = nullptr;
+    for(const auto& block : blocks)
+    {
+        BOOST_REQUIRE(previousEnd <= block.first);
+        previousEnd = block.first + block.second;
+    }
+
+    for(const auto& block : blocks)
+        pool.deallocate(block.first, block.second);
+}
+
+BOOST_AUTO_TEST_CASE(GivenPool_WhenReleasingAll_ThenItCanBeUsedAgain)
+{
+    aisdi::NodePool pool(true);
+    for(int i = 0; i < 100000; ++i)
+        *static_cast<int*>(pool.allocate(sizeof(int))) = i;
+    pool.allocate(3 * aisdi::NodePool::HUGE_PAGE_SIZE);
+
+    pool.releaseAll();
+    int* p = static_cast<int*>(pool.allocate(sizeof(int)));
+    *p = 42;
+    BOOST_CHECK_EQUAL(*p, 42);
+}
+
+BOOST_AUTO_TEST_CASE(GivenSharedPool_WhenReleasingAll_ThenItIsRefused)
+{
+    PoolFor<int, int> alloc;
+    alloc.deallocate(alloc.allocate(1), 1);
+    {
+        aisdi::PoolAllocator<long> copy(alloc);
+        BOOST_CHECK(copy == alloc);
+        BOOST_CHECK(!alloc.releaseAll());
+    }
+    BOOST_CHECK(alloc.releaseAll());
+    BOOST_CHECK(alloc != (PoolFor<int, int>()));
+}
+
+BOOST_AUTO_TEST_CASE(GivenDefaultAllocator_WhenCopiedBeforeAllocating_ThenCopiesShareItsPool)
+{
+    PoolFor<int, int> alloc;
+    aisdi::PoolAllocator<long> rebound(alloc);
+    PoolFor<int, int> copy(alloc);
+    BOOST_CHECK(rebound == alloc);
+    BOOST_CHECK(copy == alloc);
+
+    auto* p = alloc.allocate(3);
+    BOOST_CHECK(copy == alloc);
+    BOOST_CHECK(rebound == alloc);
+    copy.deallocate(p, 3);
+    BOOST_CHECK_EQUAL(copy.allocate(3), p);
+
+    //A moved allocator is copied, so both can still allocate
+    PoolFor<int, int> moved(std::move(copy));
+    BOOST_CHECK(moved == copy);
+    copy.deallocate(moved.allocate(1), 1);
+    BOOST_CHECK(alloc != (PoolFor<int, int>()));
+}
+
+BOOST_AUTO_TEST_CASE(GivenPooledTreeMapsFromOneAllocator_WhenJoining_ThenNodesAreTakenOver)
+{
+    using Map = aisdi::TreeMap<int, int, PoolFor<int, int>>;
+    PoolFor<int, int> alloc;
+    Map less(alloc), greater(alloc);
+    for(int i = 0; i < 1000; ++i)
+    {
+        less[i] = i;
+        greater[i + 1000] = i + 1000;
+    }
+    BOOST_CHECK(less.get_allocator() == greater.get_allocator());
+    const int* moved = &greater.valueOf(1500);
+
+    Map joined = Map::join(std::move(less), std::move(greater));
+    BOOST_CHECK_EQUAL(joined.getSize(), 2000);
+    BOOST_CHECK_EQUAL(&joined.valueOf(1500), moved);
+}
+
+BOOST_AUTO_TEST_CASE(GivenPooledHashMap_WhenAddingRemovingAndCopying_ThenItemsAreKept)
+{
+    using Map = aisdi::HashMap<int, std::string, aisdi::ChainedStorage, std::hash<int>, std::equal_to<int>,
+                               PoolFor<int, std::string>>;
+    Map map;
+    for(int i = 0; i < 5000; ++i)
+        map[i] = std::to_string(i);
+    for(int i = 0; i < 5000; i += 2)
+        map.remove(i);
+
+    Map copy(map);
+    BOOST_CHECK(copy.get_allocator() != map.get_allocator());
+    Map moved(std::move(map));
+    BOOST_CHECK(copy == moved);
+    for(int i = 1; i < 5000; i += 2)
+        BOOST_REQUIRE_EQUAL(moved.valueOf(i), std::to_string(i));
+    BOOST_CHECK(moved.find(2) == moved.end());
+}
+
+BOOST_AUTO_TEST_CASE(GivenPooledMaps_WhenDestroyed_ThenNodesAreReleasedInBulk)
+{
+    aisdi::HashMap<int, int, aisdi::ChainedStorage, std::hash<int>, std::equal_to<int>, PoolFor<int, int>> hash;
+    aisdi::SwissHashMap<int, int, std::hash<int>, std::equal_to<int>, PoolFor<int, int>> swiss;
+    aisdi::TreeMap<int, int, aisdi::PoolAllocator<std::pair<const int, int>, true>> tree;
+    for(int i = 0; i < 10000; ++i)
+        hash[i] = swiss[i] = tree[(i * 7919) % 10007] = i;
+
+    BOOST_CHECK_EQUAL(hash.getSize(), 10000);
+    BOOST_CHECK_EQUAL(swiss.getSize(), 10000);
+    BOOST_CHECK_EQUAL(tree.getSize(), 10000);
+
+    hash = decltype(hash)();
+    BOOST_CHECK(hash.isEmpty());
+    hash[1] = 1;
+    BOOST_CHECK_EQUAL(hash.valueOf(1), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+#include <ShardedMap.h>
+#include <HashMap.h>
+#include <TreeMap.h>
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+using TestedMapTypes = boost::mpl::list<aisdi::ShardedMap<aisdi::HashMap<std::int32_t, std::string>>,
+                                        aisdi::ShardedMap<aisdi::TreeMap<std::int32_t, std::string>, 4>,
+                                        aisdi::ShardedMap<aisdi::SwissHashMap<std::int32_t, std::string>, 1>>;
+
+//Splay trees rotate on const lookups, so shared locks can't protect them
+static_assert(aisdi::LookupsChangeMap<aisdi::TreeMap<int, int, std::allocator<std::pair<const int, int>>, aisdi::SplayBalance>>::value,
+              "Splay tree lookups change it");
+static_assert(!aisdi::LookupsChangeMap<aisdi::TreeMap<int, int>>::value && !aisdi::LookupsChangeMap<aisdi::HashMap<int, int>>::value,
+              "AVL tree and hash map lookups don't change them");
+
+BOOST_AUTO_TEST_SUITE(ShardedMapTests)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyMap_WhenAddingAndRemovingItems_ThenTheyAreFoundOrNot, M, TestedMapTypes)
+{
+    M map;
+    BOOST_CHECK(map.isEmpty());
+
+    map.insert(42, "Alice");
+    map.insert(27, "Bob");
+    map.insert(42, "Chuck");
+
+    std::string value;
+    BOOST_CHECK(map.find(42, value));
+    BOOST_CHECK_EQUAL(value, "Chuck");
+    BOOST_CHECK_EQUAL(map.valueOf(27), "Bob");
+    BOOST_CHECK(!map.contains(13));
+    BOOST_CHECK_THROW(map.valueOf(13), std::out_of_range);
+    BOOST_CHECK_EQUAL(map.getSize(), 2);
+
+    BOOST_CHECK(map.remove(42));
+    BOOST_CHECK(!map.remove(42));
+    BOOST_CHECK(!map.find(42, value));
+    BOOST_CHECK_EQUAL(map.getSize(), 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenUsingBatches_ThenEveryShardIsUpdated, M, TestedMapTypes)
+{
+    M map = { { 1, "a" }, { 2, "b" } };
+    std::vector<std::pair<std::int32_t, std::string>> items;
+    for(int i = 0; i < 1000; ++i)
+        items.emplace_back(i, std::to_string(i));
+
+    map.insertBatch(items.begin(), items.end());
+    BOOST_CHECK_EQUAL(map.getSize(), 1000);
+    BOOST_CHECK_EQUAL(map.valueOf(2), "2");
+
+    std::vector<std::int32_t> keys = { 1, 3, 5, 2000 };
+    BOOST_CHECK_EQUAL(map.removeBatch(keys.begin(), keys.end()), 3);
+    BOOST_CHECK_EQUAL(map.getSize(), 997);
+
+    std::size_t total = 0;
+    for(std::size_t i = 0; i < M::shardCount(); ++i)
+        map.withShard(i, [&total](const typename M::map_type& shard) { total += shard.getSize(); });
+    BOOST_CHECK_EQUAL(total, 997);
+    BOOST_CHECK_THROW(map.withShard(M::shardCount(), [](typename M::map_type&) {}), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenIterating_ThenAllItemsAreVisited, M, TestedMapTypes)
+{
+    M map;
+    std::map<std::int32_t, std::string> expected;
+    for(int i = 0; i < 500; ++i)
+    {
+        map.insert(i * 3, std::to_string(i));
+        expected[i * 3] = std::to_string(i);
+    }
+
+    std::map<std::int32_t, std::string> visited;
+    map.forEach([&visited](const typename M::value_type& item) { visited[item.first] = item.second; });
+    BOOST_CHECK(visited == expected);
+
+    auto snapshot = map.snapshot();
+    std::map<std::int32_t, std::string> copied(snapshot.begin(), snapshot.end());
+    BOOST_CHECK_EQUAL(snapshot.size(), expected.size());
+    BOOST_CHECK(copied == expected);
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyThreads_WhenUpdatingConcurrently_ThenNoUpdateIsLost)
+{
+    aisdi::ShardedMap<aisdi::HashMap<int, int>, 8> map;
+    const int THREADS = 8, KEYS = 200, ROUNDS = 50;
+
+    std::vector<std::thread> threads;
+    for(int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&map, t]()
+        {
+            for(int round = 0; round < ROUNDS; ++round)
+            {
+                for(int key = 0; key < KEYS; ++key)
+                {
+                    map.update(key, [](int& value) { ++value; });
+                    int value;
+                    map.find((key + t) % KEYS, value);
+                }
+                map.insert(KEYS + t, round);
+                map.remove(KEYS + t);
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+
+    BOOST_CHECK_EQUAL(map.getSize(), KEYS);
+    for(int key = 0; key < KEYS; ++key)
+        BOOST_REQUIRE_EQUAL(map.valueOf(key), THREADS * ROUNDS);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,8 +1,14 @@
 #include <TreeMap.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <functional>
+#include <iterator>
 #include <string>
 #include <map>
+#include <new>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/mpl/list.hpp>
@@ -658,6 +664,631 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(Remove_MegaTest, K, TestedKeyTypes)
     BOOST_CHECK(map.getSize() == 10);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSortedOrReversedKeys_WhenAdding_ThenTreeStaysBalanced, K, TestedKeyTypes)
+{
+    const int COUNT = 1 << 14;
+    Map<K> ascending, descending;
+    for(int i = 0; i < COUNT; ++i)
+    {
+        ascending[i] = "a";
+        descending[COUNT - i] = "d";
+    }
+
+    //An AVL tree of n nodes is less than 1.44 log2(n + 2) high
+    BOOST_CHECK_LE(ascending.getHeight(), 20);
+    BOOST_CHECK_LE(descending.getHeight(), 20);
+    BOOST_CHECK_EQUAL(ascending.getSize(), COUNT);
+    BOOST_CHECK_EQUAL(descending.valueOf(1), "d");
+
+    K expected = 0;
+    for(auto it = ascending.begin(); it != ascending.end(); ++it)
+        BOOST_REQUIRE_EQUAL(it->first, expected++);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenBalancedTree_WhenRemovingManyItems_ThenItStaysBalancedAndOrdered, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    unsigned state = 12345;
+    for(int i = 0; i < 4000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = (state >> 8) % 3000;
+        if(i % 3 == 2 && map.find(key) != map.end())
+        {
+            map.remove(key);
+            expected.erase(key);
+        }
+        else map[key] = expected[key] = std::to_string(i);
+    }
+    //Remove a whole prefix, which keeps taking nodes from the same side
+    for(K key = 0; key < 1500; ++key)
+    {
+        if(expected.erase(key) != 0) map.remove(key);
+    }
+
+    thenMapContainsItems(map, expected);
+    BOOST_CHECK_LE(map.getHeight(), 16);
+    auto it = map.begin();
+    for(const auto& item : expected)
+        BOOST_REQUIRE_EQUAL((it++)->first, item.first);
+    BOOST_CHECK(it == map.end());
+    BOOST_CHECK_EQUAL((--map.end())->first, expected.rbegin()->first);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenLargeMap_WhenCopying_ThenShapeAndItemsAreCopied, K, TestedKeyTypes)
+{
+    Map<K> map;
+    for(int i = 0; i < 100000; ++i)
+        map[(i * 7919) % 100003] = std::to_string(i);
+
+    const Map<K> copy = map;
+    BOOST_CHECK_EQUAL(copy.getSize(), 100000);
+    BOOST_CHECK_EQUAL(copy.getHeight(), map.getHeight());
+    BOOST_CHECK(copy == map);
+    BOOST_CHECK_EQUAL((--copy.end())->first, (--map.end())->first);
+
+    Map<K> assigned = { { 1, "x" } };
+    assigned = copy;
+    assigned[100004] = "last";
+    BOOST_CHECK_EQUAL(assigned.getSize(), 100001);
+    BOOST_CHECK_EQUAL((--assigned.end())->second, "last");
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenRandomInsertionsAndRemovals_WhenAskingForRanks_ThenTheyMatchKeyOrder, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    unsigned state = 777;
+    for(int i = 0; i < 6000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = (state >> 8) % 2000 * 2; //even keys only, so odd ones are missing
+        if(i % 3 == 2 && map.find(key) != map.end())
+        {
+            map.remove(key);
+            expected.erase(key);
+        }
+        else map[key] = expected[key] = std::to_string(i);
+        BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+    }
+
+    std::size_t index = 0;
+    for(const auto& item : expected)
+    {
+        BOOST_REQUIRE_EQUAL(map.rank(item.first), index);
+        BOOST_REQUIRE_EQUAL(map.rank(item.first + 1), index + 1);
+        BOOST_REQUIRE_EQUAL(map.select(index)->first, item.first);
+        ++index;
+    }
+    BOOST_CHECK_EQUAL(map.rank(0), 0);
+    BOOST_CHECK_EQUAL(map.rank(5000), expected.size());
+    BOOST_CHECK_THROW(map.select(expected.size()), std::out_of_range);
+
+    const Map<K>& constMap = map;
+    auto it = constMap.select(0);
+    BOOST_CHECK(it == constMap.begin());
+    BOOST_CHECK_EQUAL(map.countRange(100, 1001),
+        static_cast<std::size_t>(std::distance(expected.lower_bound(100), expected.lower_bound(1001))));
+    BOOST_CHECK_EQUAL(map.countRange(0, 5000), expected.size());
+    BOOST_CHECK_EQUAL(map.countRange(1001, 100), 0);
+
+    map.select(1)->second = "second";
+    BOOST_CHECK_EQUAL(map.valueOf(std::next(expected.begin())->first), "second");
+
+    const Map<K> copy = map;
+    BOOST_CHECK_EQUAL(copy.rank(1000), map.rank(1000));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenSearchingForBounds_ThenNeighbouringKeysAreFound, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    for(int i = 1; i <= 500; ++i)
+        map[i * 10] = expected[i * 10] = std::to_string(i);
+
+    for(K key = 0; key <= 5010; key += 5)
+    {
+        auto lower = map.lowerBound(key), upper = map.upperBound(key);
+        BOOST_REQUIRE(lower == map.ceiling(key));
+        BOOST_REQUIRE(lower == (expected.lower_bound(key) == expected.end() ? map.end() : map.find(expected.lower_bound(key)->first)));
+        BOOST_REQUIRE(upper == (expected.upper_bound(key) == expected.end() ? map.end() : map.find(expected.upper_bound(key)->first)));
+
+        auto floor = map.floor(key);
+        if(key < 10) BOOST_REQUIRE(floor == map.end());
+        else BOOST_REQUIRE_EQUAL(floor->first, key / 10 * 10 > 5000 ? 5000 : key / 10 * 10);
+
+        auto range = map.equalRange(key);
+        BOOST_REQUIRE(range.first == lower);
+        BOOST_REQUIRE(range.second == upper);
+        BOOST_REQUIRE_EQUAL(range.first != range.second, expected.count(key) == 1);
+    }
+
+    map.lowerBound(15)->second = "changed";
+    BOOST_CHECK_EQUAL(map.valueOf(20), "changed");
+    const Map<K> empty;
+    BOOST_CHECK(empty.floor(1) == empty.end());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenIteratingOverRange_ThenOnlyKeysWithinAreVisited, K, TestedKeyTypes)
+{
+    Map<K> map;
+    for(int i = 0; i < 1000; ++i)
+        map[(i * 37) % 1000] = std::to_string(i);
+
+    std::size_t visited = 0;
+    K previous = 99;
+    for(const auto& item : map.rangeOf(100, 250))
+    {
+        BOOST_REQUIRE_EQUAL(item.first, previous + 1);
+        previous = item.first;
+        ++visited;
+    }
+    BOOST_CHECK_EQUAL(visited, 150);
+    BOOST_CHECK_EQUAL(previous, 249);
+    BOOST_CHECK_EQUAL(visited, map.countRange(100, 250));
+
+    BOOST_CHECK(map.rangeOf(250, 100).isEmpty());
+    BOOST_CHECK(map.rangeOf(5000, 6000).isEmpty());
+    BOOST_CHECK(map.rangeOf(990, 5000).end() == map.end());
+
+    for(auto& item : map.rangeOf(0, 3))
+        item.second = "low";
+    const Map<K>& constMap = map;
+    auto low = constMap.rangeOf(0, 3);
+    BOOST_CHECK_EQUAL(std::distance(low.begin(), low.end()), 3);
+    for(const auto& item : low)
+        BOOST_CHECK_EQUAL(item.second, "low");
+    BOOST_CHECK_EQUAL(map.valueOf(3), "919"); //37 * 919 % 1000 == 3
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSortedItems_WhenBulkLoading_ThenTreeIsBalancedAndComplete, K, TestedKeyTypes)
+{
+    std::vector<std::pair<K, std::string>> items;
+    for(int i = 0; i < 100000; ++i)
+        items.emplace_back(i * 3, std::to_string(i));
+
+    Map<K> map = Map<K>::fromSorted(items.begin(), items.end());
+    BOOST_CHECK_EQUAL(map.getSize(), items.size());
+    BOOST_CHECK_EQUAL(map.getHeight(), 17); //the smallest possible height for 100000 nodes
+    for(std::size_t i = 0; i < items.size(); i += 97)
+    {
+        BOOST_REQUIRE_EQUAL(map.valueOf(items[i].first), items[i].second);
+        BOOST_REQUIRE_EQUAL(map.rank(items[i].first), i);
+    }
+    BOOST_CHECK_EQUAL(map.begin()->first, 0);
+    BOOST_CHECK_EQUAL((--map.end())->first, 299997);
+
+    //The loaded tree is an ordinary AVL tree that keeps working as one
+    for(int i = 0; i < 100000; i += 2)
+        map.remove(i * 3);
+    map[1] = "one";
+    BOOST_CHECK_EQUAL(map.getSize(), 50001);
+    BOOST_CHECK_LE(map.getHeight(), 18);
+    BOOST_CHECK_EQUAL(map.select(1)->first, 3);
+
+    std::map<K, std::string> empty;
+    BOOST_CHECK(Map<K>::fromSorted(empty.begin(), empty.end()).isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenDuplicatedOrUnsortedKeys_WhenBulkLoading_ThenLastValueWinsOrLoadFails, K, TestedKeyTypes)
+{
+    std::vector<std::pair<K, std::string>> items = { { 1, "a" }, { 2, "b" }, { 2, "c" }, { 5, "d" } };
+    thenMapContainsItems(Map<K>::fromSorted(items.begin(), items.end()), { { 1, "a" }, { 2, "c" }, { 5, "d" } });
+
+    items.emplace_back(3, "e");
+    BOOST_CHECK_THROW(Map<K>::fromSorted(items.begin(), items.end()), std::invalid_argument);
+
+    thenMapContainsItems(Map<K>::fromUnsorted(items.begin(), items.end()),
+        { { 1, "a" }, { 2, "c" }, { 3, "e" }, { 5, "d" } });
+}
+
+BOOST_AUTO_TEST_CASE(GivenManyShuffledItems_WhenBulkLoadingUnsorted_ThenMapMatchesOneLoadedItemByItem)
+{
+    std::vector<std::pair<int, int>> items;
+    unsigned state = 99;
+    for(int i = 0; i < 200000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        items.emplace_back((state >> 8) % 150000, i); //with duplicates
+    }
+
+    aisdi::TreeMap<int, int> expected;
+    for(const auto& item : items)
+        expected[item.first] = item.second;
+
+    const auto loaded = aisdi::TreeMap<int, int>::fromUnsorted(items.begin(), items.end());
+    BOOST_CHECK(loaded == expected);
+
+    std::vector<std::pair<int, int>> sorted = items;
+    aisdi::parallelStableSort(sorted.begin(), sorted.end(), std::less<std::pair<int, int>>(), 4);
+    BOOST_CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenChangingMap_WhenIteratingBothWays_ThenKeyOrderIsKept, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    auto thenBothWaysMatch = [&expected](const Map<K>& tested)
+    {
+        auto it = tested.begin();
+        for(const auto& item : expected)
+            BOOST_REQUIRE_EQUAL((it++)->first, item.first);
+        BOOST_REQUIRE(it == tested.end());
+        for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+            BOOST_REQUIRE_EQUAL((--it)->first, item->first);
+        BOOST_REQUIRE(it == tested.begin());
+    };
+
+    unsigned state = 4242;
+    for(int i = 0; i < 3000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = (state >> 8) % 1000;
+        if(i % 2 == 1 && map.find(key) != map.end())
+        {
+            map.remove(key);
+            expected.erase(key);
+        }
+        else map[key] = expected[key] = "x";
+        if(i % 100 == 0) thenBothWaysMatch(map);
+    }
+    thenBothWaysMatch(map);
+
+    const Map<K> copy = map;
+    Map<K> assigned = { { 5000, "y" } };
+    assigned = copy;
+    Map<K> moved = std::move(map);
+    thenBothWaysMatch(copy);
+    thenBothWaysMatch(assigned);
+    thenBothWaysMatch(moved);
+
+    //The moved-from map is left empty and usable
+    BOOST_CHECK(map.begin() == map.end());
+    map[1] = "a";
+    map[0] = "b";
+    BOOST_CHECK_EQUAL(map.begin()->first, 0);
+    BOOST_CHECK_EQUAL((--map.end())->first, 1);
+}
+
+template <typename K>
+using SplayMap = aisdi::TreeMap<K, std::string, std::allocator<std::pair<const K, std::string>>, aisdi::SplayBalance>;
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSplayMap_WhenChangingAndSearchingRandomly_ThenItBehavesLikeAMap, K, TestedKeyTypes)
+{
+    SplayMap<K> map;
+    std::map<K, std::string> expected;
+    unsigned state = 2718;
+    for(int i = 0; i < 6000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = (state >> 8) % 1500;
+        switch((state >> 4) % 4)
+        {
+        case 0:
+            if(map.find(key) != map.end())
+            {
+                map.remove(key);
+                expected.erase(key);
+            }
+            break;
+        case 1:
+            BOOST_REQUIRE_EQUAL(map.find(key) != map.end(), expected.count(key) == 1);
+            break;
+        default:
+            map[key] = expected[key] = std::to_string(i);
+        }
+        BOOST_REQUIRE_EQUAL(map.getSize(), expected.size());
+    }
+
+    std::size_t index = 0;
+    auto it = map.begin();
+    for(const auto& item : expected)
+    {
+        BOOST_REQUIRE_EQUAL(it->first, item.first);
+        BOOST_REQUIRE_EQUAL(map.valueOf(item.first), item.second);
+        BOOST_REQUIRE_EQUAL(map.rank(item.first), index);
+        BOOST_REQUIRE_EQUAL(map.select(index++)->first, item.first);
+        ++it;
+    }
+    BOOST_CHECK(it == map.end());
+    for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+        BOOST_REQUIRE_EQUAL((--it)->first, item->first);
+
+    const SplayMap<K> copy = map;
+    BOOST_CHECK(copy == map);
+    BOOST_CHECK(copy.find(5000) == copy.end());
+    BOOST_CHECK_EQUAL(copy.valueOf(expected.begin()->first), expected.begin()->second);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenSplayMapBuiltInOrder_WhenSearching_ThenTheTreeGetsShallower, K, TestedKeyTypes)
+{
+    const int COUNT = 1000;
+    SplayMap<K> map;
+    for(int i = 0; i < COUNT; ++i)
+        map[i] = "x";
+    //Every new key became the root, with all the others in a chain on its left
+    BOOST_CHECK_EQUAL(map.getHeight(), COUNT);
+
+    auto it = map.find(0);
+    BOOST_CHECK_EQUAL(it->first, 0);
+    BOOST_CHECK_LE(map.getHeight(), COUNT / 2 + 2);
+    for(int i = 0; i < COUNT; i += 7)
+        map.valueOf(i);
+    BOOST_CHECK_LT(map.getHeight(), COUNT / 4);
+
+    //Iterators taken before splaying still walk the whole map
+    int expected = 0;
+    for(; it != map.end(); ++it)
+        BOOST_REQUIRE_EQUAL(it->first, expected++);
+    BOOST_CHECK_EQUAL(expected, COUNT);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenChurnedMap_WhenCompacting_ThenItemsStayAndTreeIsPerfectlyBalanced, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    unsigned state = 4242;
+    for(int i = 0; i < 20000; ++i)
+    {
+        state = state * 1103515245u + 12345u;
+        K key = (state >> 8) % 5000;
+        if(i % 2 == 1 && map.find(key) != map.end())
+        {
+            map.remove(key);
+            expected.erase(key);
+        }
+        else map[key] = expected[key] = std::to_string(i);
+    }
+    const auto end = map.end();
+
+    map.compact();
+    thenMapContainsItems(map, expected);
+    BOOST_CHECK(map.end() == end);
+    int height = 0;
+    for(std::size_t size = expected.size(); size != 0; size /= 2)
+        ++height;
+    BOOST_CHECK_EQUAL(map.getHeight(), height);
+    auto it = map.begin();
+    for(const auto& item : expected)
+        BOOST_REQUIRE_EQUAL((it++)->first, item.first);
+    BOOST_CHECK(it == end);
+    for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+        BOOST_REQUIRE_EQUAL((--it)->first, item->first);
+    BOOST_CHECK_EQUAL(map.select(1000)->first, std::next(expected.begin(), 1000)->first);
+
+    //The root, the middle key, gets the lowest address
+    const auto* root = &*map.select(expected.size() / 2);
+    for(const auto& item : map)
+        BOOST_REQUIRE(!(&item < root));
+
+    //The map keeps working as usual
+    for(K key = 0; key < 5000; key += 3)
+    {
+        if(expected.erase(key) != 0) map.remove(key);
+        else map[key] = expected[key] = "new";
+    }
+    thenMapContainsItems(map, expected);
+    BOOST_CHECK_LE(map.getHeight(), height + 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenEmptyOrSplayMap_WhenCompacting_ThenItStaysTheSame, K, TestedKeyTypes)
+{
+    Map<K> empty;
+    empty.compact();
+    BOOST_CHECK(empty.isEmpty());
+    BOOST_CHECK(empty.begin() == empty.end());
+    empty[1] = "one";
+    BOOST_CHECK_EQUAL(empty.valueOf(1), "one");
+
+    SplayMap<K> map;
+    for(int i = 0; i < 1000; ++i)
+        map[i] = std::to_string(i);
+    map.compact();
+    BOOST_CHECK_EQUAL(map.getHeight(), 10);
+    BOOST_CHECK_EQUAL(map.getSize(), 1000);
+    for(int i = 999; i >= 0; i -= 5)
+        BOOST_REQUIRE_EQUAL(map.valueOf(i), std::to_string(i));
+    BOOST_CHECK_EQUAL((--map.end())->first, 999);
+}
+
+//Key whose copy number *failAt* throws
+struct FragileKey
+{
+    static int copies;
+    static int failAt;
+    int value;
+
+    FragileKey(int v = 0): value(v) {}
+
+    FragileKey(const FragileKey& other): value(other.value)
+    {
+        if(copies++ == failAt) throw std::bad_alloc();
+    }
+
+    bool operator<(const FragileKey& other) const
+    {
+        return value < other.value;
+    }
+
+    bool operator==(const FragileKey& other) const
+    {
+        return value == other.value;
+    }
+};
+
+int FragileKey::copies = 0;
+int FragileKey::failAt = -1;
+
+BOOST_AUTO_TEST_CASE(GivenKeyCopyThrowing_WhenCompacting_ThenEveryValueStaysInMap)
+{
+    aisdi::TreeMap<FragileKey, std::string> map;
+    for(int i = 0; i < 100; ++i)
+        map[FragileKey(i)] = std::string(40, 'a' + i % 26);
+
+    FragileKey::copies = 0;
+    FragileKey::failAt = 50;
+    BOOST_CHECK_THROW(map.compact(), std::bad_alloc);
+    FragileKey::failAt = -1;
+
+    BOOST_CHECK_EQUAL(map.getSize(), 100);
+    int key = 0;
+    for(const auto& item : map)
+    {
+        BOOST_REQUIRE_EQUAL(item.first.value, key);
+        BOOST_REQUIRE_EQUAL(item.second, std::string(40, 'a' + key % 26));
+        ++key;
+    }
+    map.compact();
+    BOOST_CHECK_EQUAL(map.valueOf(FragileKey(99)), std::string(40, 'a' + 99 % 26));
+}
+
+BOOST_AUTO_TEST_CASE(GivenNestedTasks_WhenRunningOnThreadPool_ThenAllOfThemRun)
+{
+    aisdi::ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.getThreadCount(), 4);
+    std::function<long long(int, int)> sum = [&](int first, int last)
+    {
+        if(last - first < 100)
+        {
+            long long result = 0;
+            for(int i = first; i < last; ++i)
+                result += i;
+            return result;
+        }
+        int middle = first + (last - first) / 2;
+        long long left = 0, right = 0;
+        pool.parallel([&]() { left = sum(first, middle); }, [&]() { right = sum(middle, last); });
+        return left + right;
+    };
+    BOOST_CHECK_EQUAL(sum(0, 100000), 100000LL * 99999 / 2);
+}
+
+namespace
+{
+
+//Two maps of random keys below *range* and what they have to become together
+template <typename K>
+void givenRandomMaps(Map<K>& a, Map<K>& b, std::map<K, std::string>& expectedA, std::map<K, std::string>& expectedB,
+    int count, int range, unsigned seed)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        K key = (seed >> 8) % range;
+        a[key] = expectedA[key] = "a" + std::to_string(key);
+        seed = seed * 1103515245u + 12345u;
+        key = (seed >> 8) % range;
+        b[key] = expectedB[key] = "b" + std::to_string(key);
+    }
+}
+
+//Contents, both directions of iteration, ranks and balance
+template <typename K>
+void thenMapIsBalancedAndContains(const Map<K>& map, const std::map<K, std::string>& expected)
+{
+    thenMapContainsItems(map, expected);
+    auto it = map.begin();
+    std::size_t index = 0;
+    for(const auto& item : expected)
+    {
+        BOOST_REQUIRE_EQUAL(it->first, item.first);
+        BOOST_REQUIRE(map.select(index++) == it);
+        ++it;
+    }
+    BOOST_REQUIRE(it == map.end());
+    for(auto item = expected.rbegin(); item != expected.rend(); ++item)
+        BOOST_REQUIRE_EQUAL((--it)->first, item->first);
+    BOOST_CHECK_LE(map.getHeight(), 1.45 * std::log2(expected.size() + 2));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMaps_WhenUniting_ThenItemsOfBothAreKeptAndConflictsResolved, K, TestedKeyTypes)
+{
+    aisdi::ThreadPool pool(4);
+    for(int count : { 0, 1, 100, 30000 })
+    {
+        Map<K> a, b;
+        std::map<K, std::string> expected, other;
+        givenRandomMaps(a, b, expected, other, count, 3 * count + 1, count);
+        for(const auto& item : other)
+        {
+            auto found = expected.find(item.first);
+            if(found == expected.end()) expected.insert(item);
+            else found->second += item.second;
+        }
+
+        a.unionWith(std::move(b), [](const std::string& mine, const std::string& theirs) { return mine + theirs; }, pool);
+        thenMapIsBalancedAndContains(a, expected);
+        BOOST_CHECK(b.isEmpty());
+    }
+
+    //A map much smaller than the other, on either side
+    Map<K> small = { { 5, "small" } }, large;
+    for(int i = 0; i < 10000; ++i)
+        large[i * 2] = "large";
+    Map<K> copy = large;
+    small.unionWith(copy, [](const std::string& mine, const std::string&) { return mine; }, pool);
+    BOOST_CHECK_EQUAL(small.getSize(), 10001);
+    BOOST_CHECK_EQUAL(small.valueOf(5), "small");
+    BOOST_CHECK_EQUAL(copy.getSize(), 10000);
+    large.unionWith({ { 5, "small" }, { 6, "small" } }, [](const std::string&, const std::string& theirs) { return theirs; });
+    BOOST_CHECK_EQUAL(large.getSize(), 10001);
+    BOOST_CHECK_EQUAL(large.valueOf(6), "small");
+    BOOST_CHECK_EQUAL((--large.end())->first, 19998);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenTwoMaps_WhenIntersectingOrSubtracting_ThenOnlyRightKeysAreKept, K, TestedKeyTypes)
+{
+    aisdi::ThreadPool pool(4);
+    for(int count : { 0, 1, 100, 30000 })
+    {
+        Map<K> a, b;
+        std::map<K, std::string> first, second;
+        givenRandomMaps(a, b, first, second, count, 2 * count + 1, count + 7);
+        std::map<K, std::string> common, rest;
+        for(const auto& item : first)
+        {
+            auto found = second.find(item.first);
+            if(found != second.end()) common[item.first] = found->second;
+            else rest.insert(item);
+        }
+
+        Map<K> intersection = a;
+        intersection.intersectWith(b, [](const std::string&, const std::string& theirs) { return theirs; }, pool);
+        thenMapIsBalancedAndContains(intersection, common);
+        a.difference(std::move(b), pool);
+        thenMapIsBalancedAndContains(a, rest);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(GivenMap_WhenSplittingAndJoiningBack_ThenItemsAreDividedByKey, K, TestedKeyTypes)
+{
+    Map<K> map;
+    std::map<K, std::string> expected;
+    for(int i = 0; i < 5000; ++i)
+        map[i * 3] = expected[i * 3] = std::to_string(i);
+
+    for(K key : { K(0), K(1), K(3000), K(3001), K(14997), K(20000) })
+    {
+        Map<K> greater = map.split(key);
+        auto bound = expected.lower_bound(key);
+        thenMapIsBalancedAndContains(map, std::map<K, std::string>(expected.begin(), bound));
+        thenMapIsBalancedAndContains(greater, std::map<K, std::string>(bound, expected.end()));
+        map = Map<K>::join(std::move(map), std::move(greater));
+        thenMapIsBalancedAndContains(map, expected);
+    }
+
+    //Pieces of very different heights
+    Map<K> last = map.split(14997);
+    BOOST_CHECK_THROW(Map<K>::join(last, map), std::invalid_argument);
+    BOOST_CHECK_THROW(Map<K>::join(map, map), std::invalid_argument);
+    BOOST_CHECK_EQUAL(last.getSize(), 1);
+    map = Map<K>::join(std::move(map), std::move(last));
+    thenMapIsBalancedAndContains(map, expected);
+}
+
 // ConstIterator is tested via Iterator methods.
 // If Iterator methods are to be changed, then new ConstIterator tests are required.
 